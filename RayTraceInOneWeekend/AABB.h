@@ -0,0 +1,110 @@
+// -----------------------------------------------------------------------------
+#ifndef AABB_H_
+#define AABB_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+
+#include <utility>
+
+// -----------------------------------------------------------------------------
+
+class AABB
+{
+public:
+	// ---- constructors
+	AABB()
+		: mMin(gInfinity, gInfinity, gInfinity)
+		, mMax(-gInfinity, -gInfinity, -gInfinity)
+	{}
+	AABB(const point3& pMin, const point3& pMax)
+		: mMin(pMin)
+		, mMax(pMax)
+	{}
+
+	// ---- methods
+	point3 min() const { return mMin; }
+	point3 max() const { return mMax; }
+	point3 centroid() const { return 0.5 * (mMin + mMax); }
+	bool isEmpty() const { return mMin.x() > mMax.x() || mMin.y() > mMax.y() || mMin.z() > mMax.z(); }
+
+	Real surfaceArea() const
+	{
+		if (isEmpty())
+			return 0.0;
+
+		vec3 d = mMax - mMin;
+		return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	}
+
+	int longestAxis() const
+	{
+		vec3 d = mMax - mMin;
+		if (d.x() > d.y() && d.x() > d.z())
+			return 0;
+		return d.y() > d.z() ? 1 : 2;
+	}
+
+	void grow(const point3& pPoint)
+	{
+		mMin = point3(fmin(mMin.x(), pPoint.x()), fmin(mMin.y(), pPoint.y()), fmin(mMin.z(), pPoint.z()));
+		mMax = point3(fmax(mMax.x(), pPoint.x()), fmax(mMax.y(), pPoint.y()), fmax(mMax.z(), pPoint.z()));
+	}
+
+	void grow(const AABB& pBox)
+	{
+		if (pBox.isEmpty())
+			return;
+		grow(pBox.mMin);
+		grow(pBox.mMax);
+	}
+
+	bool hit(const Ray& pRay, Real pMinT, Real pMaxT) const
+	{
+		const vec3 invDir(1.0 / pRay.mDir.x(), 1.0 / pRay.mDir.y(), 1.0 / pRay.mDir.z());
+		Real tEnter;
+		return hit(pRay.mOrig, invDir, pMinT, pMaxT, tEnter);
+	}
+
+	// slab test with the reciprocal direction precomputed by the caller, so a
+	// traversal only pays for the divides once per ray. pEnter is the distance
+	// at which the ray enters the box, used to visit the nearest child first
+	bool hit(const point3& pOrigin, const vec3& pInvDir, Real pMinT, Real pMaxT, Real& pEnter) const
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			Real t0 = (mMin[a] - pOrigin[a]) * pInvDir[a];
+			Real t1 = (mMax[a] - pOrigin[a]) * pInvDir[a];
+			if (pInvDir[a] < 0.0)
+				std::swap(t0, t1);
+
+			// written so a NaN from 0 * inf leaves the interval untouched
+			pMinT = t0 > pMinT ? t0 : pMinT;
+			pMaxT = t1 < pMaxT ? t1 : pMaxT;
+			if (pMaxT < pMinT)
+				return false;
+		}
+
+		pEnter = pMinT;
+		return true;
+	}
+
+	// ---- members
+	point3 mMin;
+	point3 mMax;
+};
+
+// -----------------------------------------------------------------------------
+
+inline AABB surroundingBox(const AABB& pBox0, const AABB& pBox1)
+{
+	AABB box = pBox0;
+	box.grow(pBox1);
+	return box;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !AABB_H_
\ No newline at end of file
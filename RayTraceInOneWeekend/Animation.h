@@ -0,0 +1,386 @@
+// -----------------------------------------------------------------------------
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "CompiledScene.h"
+#include "Material.h"
+#include "MultiThreadFunctions.h"
+#include "RenderSettings.h"
+#include "rtweekend.h"
+#include "SceneFile.h"
+#include "Span.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// an animation is a text file of keyframes played over a scene, one image per
+// frame. anything between two keys is a straight line between them, and before
+// the first key or after the last it holds still:
+//
+//	frames 48
+//	camera 0 lookfrom 13 2 3 lookat 0 0 0
+//	camera 47 lookfrom 3 2 13 fov 30
+//	sphere 481 0 4 1 0
+//	sphere 481 47 4 3 0
+//
+// a camera key sets any of lookfrom, lookat, up, fov, aperture and focus and
+// keeps the rest from the key before it, the first from the scene's camera.
+// spheres are keyed by their place in the scene (the file's order, or
+// randomScene()'s) and a new centre, the radius and material stay. keys for
+// the same thing have to come in frame order
+
+// -----------------------------------------------------------------------------
+
+struct CameraKey
+{
+	int mFrame;
+	SceneCamera mCamera;
+};
+
+struct SphereKey
+{
+	int mFrame;
+	point3 mCenter;
+};
+
+struct SphereTrack
+{
+	uint32_t mIndex;
+	vector<SphereKey> mvKeys;
+};
+
+// -----------------------------------------------------------------------------
+
+// how far between two keys pFrame is, 0 at or before pA and 1 at or after pB
+inline Real keyBlend(int pFrame, int pA, int pB)
+{
+	if (pB <= pA)
+		return 1.0;
+	return fmin(fmax(static_cast<Real>(pFrame - pA) / (pB - pA), Real(0.0)), Real(1.0));
+}
+
+// -----------------------------------------------------------------------------
+
+struct Animation
+{
+	// ---- methods
+	SceneCamera cameraAt(int pFrame) const
+	{
+		if (mvCameraKeys.empty())
+			return mCamera;
+
+		size_t next = 0;
+		while (next < mvCameraKeys.size() && mvCameraKeys[next].mFrame < pFrame)
+			++next;
+		if (next == 0)
+			return mvCameraKeys.front().mCamera;
+		if (next == mvCameraKeys.size())
+			return mvCameraKeys.back().mCamera;
+
+		const CameraKey& a = mvCameraKeys[next - 1];
+		const CameraKey& b = mvCameraKeys[next];
+		const Real t = keyBlend(pFrame, a.mFrame, b.mFrame);
+		SceneCamera camera;
+		camera.mLookFrom = (1 - t) * a.mCamera.mLookFrom + t * b.mCamera.mLookFrom;
+		camera.mLookAt = (1 - t) * a.mCamera.mLookAt + t * b.mCamera.mLookAt;
+		camera.mUp = (1 - t) * a.mCamera.mUp + t * b.mCamera.mUp;
+		camera.mVerticalFov = (1 - t) * a.mCamera.mVerticalFov + t * b.mCamera.mVerticalFov;
+		camera.mAperture = (1 - t) * a.mCamera.mAperture + t * b.mCamera.mAperture;
+		camera.mFocusDistance = (1 - t) * a.mCamera.mFocusDistance + t * b.mCamera.mFocusDistance;
+		return camera;
+	}
+
+	static point3 centerAt(const SphereTrack& pTrack, int pFrame)
+	{
+		const vector<SphereKey>& keys = pTrack.mvKeys;
+		size_t next = 0;
+		while (next < keys.size() && keys[next].mFrame < pFrame)
+			++next;
+		if (next == 0)
+			return keys.front().mCenter;
+		if (next == keys.size())
+			return keys.back().mCenter;
+
+		const Real t = keyBlend(pFrame, keys[next - 1].mFrame, keys[next].mFrame);
+		return (1 - t) * keys[next - 1].mCenter + t * keys[next].mCenter;
+	}
+
+	// ---- members
+	int mFrames = 1;
+	SceneCamera mCamera;
+	vector<CameraKey> mvCameraKeys;
+	vector<SphereTrack> mvSphereTracks;
+};
+
+// -----------------------------------------------------------------------------
+
+// pCamera is the scene's camera, what the first camera key starts from
+bool parseAnimationText(const string& pText, const SceneCamera& pCamera, Animation& pAnimation, string& pError)
+{
+	SceneTextReader reader(pText.c_str());
+	string keyword, name;
+	pAnimation.mCamera = pCamera;
+
+	auto fail = [&](const string& pWhat)
+	{
+		pError = "line " + to_string(reader.line()) + ": " + pWhat;
+		return false;
+	};
+
+	auto frame = [&](int& pFrame)
+	{
+		Real value;
+		if (!reader.number(value) || value < 0 || value != floor(value))
+			return false;
+		pFrame = static_cast<int>(value);
+		return true;
+	};
+
+	do
+	{
+		if (!reader.token(keyword))
+			continue;
+
+		if (keyword == "frames")
+		{
+			if (!frame(pAnimation.mFrames) || pAnimation.mFrames < 1)
+				return fail("expected frames <count>");
+		}
+		else if (keyword == "camera")
+		{
+			CameraKey key;
+			key.mCamera = pAnimation.mvCameraKeys.empty() ? pCamera : pAnimation.mvCameraKeys.back().mCamera;
+			if (!frame(key.mFrame))
+				return fail("expected camera <frame> [lookfrom|lookat|up|fov|aperture|focus <value>]...");
+			if (!pAnimation.mvCameraKeys.empty() && key.mFrame <= pAnimation.mvCameraKeys.back().mFrame)
+				return fail("camera keys have to be in frame order");
+
+			while (reader.token(name))
+			{
+				bool read = false;
+				if (name == "lookfrom")
+					read = reader.point(key.mCamera.mLookFrom);
+				else if (name == "lookat")
+					read = reader.point(key.mCamera.mLookAt);
+				else if (name == "up")
+					read = reader.point(key.mCamera.mUp);
+				else if (name == "fov")
+					read = reader.number(key.mCamera.mVerticalFov);
+				else if (name == "aperture")
+					read = reader.number(key.mCamera.mAperture);
+				else if (name == "focus")
+					read = reader.number(key.mCamera.mFocusDistance);
+				else
+					return fail("unknown camera setting " + name);
+				if (!read)
+					return fail("bad value for " + name);
+			}
+			pAnimation.mvCameraKeys.push_back(key);
+		}
+		else if (keyword == "sphere")
+		{
+			Real index;
+			SphereKey key;
+			if (!reader.number(index) || index < 0 || index != floor(index) || !frame(key.mFrame)
+				|| !reader.point(key.mCenter))
+				return fail("expected sphere <index> <frame> <x> <y> <z>");
+
+			vector<SphereTrack>& tracks = pAnimation.mvSphereTracks;
+			auto track = find_if(tracks.begin(), tracks.end(),
+				[&](const SphereTrack& pTrack) { return pTrack.mIndex == static_cast<uint32_t>(index); });
+			if (track == tracks.end())
+			{
+				tracks.push_back({ static_cast<uint32_t>(index), {} });
+				track = tracks.end() - 1;
+			}
+			else if (key.mFrame <= track->mvKeys.back().mFrame)
+				return fail("keys for sphere " + to_string(track->mIndex) + " have to be in frame order");
+			track->mvKeys.push_back(key);
+		}
+		else
+			return fail("unknown keyword " + keyword);
+
+		if (reader.moreOnLine())
+			return fail("unexpected text after " + keyword);
+	} while (reader.nextLine());
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool loadAnimation(const string& pPath, const SceneCamera& pCamera, Animation& pAnimation, string& pError)
+{
+	ifstream file(pPath, ios::binary);
+	if (!file)
+	{
+		pError = "couldn't open " + pPath;
+		return false;
+	}
+	stringstream text;
+	text << file.rdbuf();
+	if (!parseAnimationText(text.str(), pCamera, pAnimation, pError))
+	{
+		pError = pPath + ", " + pError;
+		return false;
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// output.ppm becomes output_0000.ppm, output_0001.ppm and so on
+string framePath(const string& pPath, int pFrame)
+{
+	char number[16];
+	snprintf(number, sizeof(number), "_%04d", pFrame);
+	const size_t dot = pPath.find_last_of('.');
+	const size_t slash = pPath.find_last_of("/\\");
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+		return pPath + number;
+	return pPath.substr(0, dot) + number + pPath.substr(dot);
+}
+
+// -----------------------------------------------------------------------------
+
+// a refit tree is rebuilt once its boxes add up to this much more surface than
+// the builder made them, or when more than this share of the spheres moved in
+// one frame, since then a refit is close to a build anyway and a worse tree
+const double kMaxRefitGrowth = 1.5;
+const double kMaxRefitFraction = 0.25;
+
+// -----------------------------------------------------------------------------
+
+// renders every frame of pAnimation over pScene. the scene is copied once into
+// one this owns and stays resident, each frame only moves the spheres whose
+// keys say they moved and refits the boxes above them (or rebuilds with
+// mRebuildEveryFrame, to compare). every frame's setup is reported against
+// what the last full build took
+bool renderAnimation(
+	const RenderSettings& pSettings,
+	const Animation& pAnimation,
+	const CompiledScene& pScene,
+	Real pAspectRatio)
+{
+	typedef chrono::steady_clock Clock;
+	auto secondsSince = [](Clock::time_point pStart) { return chrono::duration<double>(Clock::now() - pStart).count(); };
+
+	// back in the order the keys number them
+	vector<CompiledSphere> spheres(pScene.mSpheres.size());
+	for (uint32_t i = 0; i < spheres.size(); ++i)
+		spheres[i] = pScene.mSpheres[pScene.slotOf(i)];
+	const Span<const Material> materials = pScene.materials();
+	const Span<const CompiledSphere> sphereSpan(spheres.data(), spheres.size());
+
+	for (const SphereTrack& track : pAnimation.mvSphereTracks)
+	{
+		if (track.mIndex >= spheres.size())
+		{
+			cerr << "the animation moves sphere " << track.mIndex << " but the scene only has " << spheres.size() << '\n';
+			return false;
+		}
+	}
+	if (!pScene.mOthers.mvObjects.empty())
+		cerr << "only spheres are animated, the " << pScene.mOthers.mvObjects.size() << " other objects are left out\n";
+
+	// one image per frame, none of them can carry on from another's checkpoint
+	RenderSettings frameSettings = pSettings;
+	if (!pSettings.mCheckpointPath.empty() || !pSettings.mResumePath.empty())
+	{
+		cerr << "checkpoints don't work per frame, leaving them out\n";
+		frameSettings.mCheckpointPath.clear();
+		frameSettings.mResumePath.clear();
+	}
+
+	auto start = Clock::now();
+	unique_ptr<CompiledScene> scene(new CompiledScene(sphereSpan, materials));
+	double buildSeconds = secondsSince(start);
+	cerr << fixed << setprecision(3) << "animating " << pAnimation.mFrames << " frames, "
+		<< pAnimation.mvSphereTracks.size() << " of " << spheres.size() << " spheres keyed, first build "
+		<< buildSeconds * 1000.0 << "ms\n";
+
+	double setupTotal = 0.0, rebuildTotal = 0.0, renderTotal = 0.0;
+	int refits = 0, rebuilds = 0;
+	vector<uint32_t> moved;
+
+	for (int frame = 0; frame < pAnimation.mFrames; ++frame)
+	{
+		start = Clock::now();
+		moved.clear();
+		for (const SphereTrack& track : pAnimation.mvSphereTracks)
+		{
+			const point3 center = Animation::centerAt(track, frame);
+			CompiledSphere& sphere = spheres[track.mIndex];
+			if (center.x() != sphere.mCenter.x() || center.y() != sphere.mCenter.y() || center.z() != sphere.mCenter.z())
+			{
+				sphere.mCenter = center;
+				moved.push_back(track.mIndex);
+			}
+		}
+
+		const bool rebuild = !moved.empty() && (pSettings.mRebuildEveryFrame
+			|| scene->refitGrowth() > kMaxRefitGrowth || moved.size() > kMaxRefitFraction * spheres.size());
+		size_t boxes = 0;
+		if (rebuild)
+			scene.reset(new CompiledScene(sphereSpan, materials));
+		else if (!moved.empty())
+		{
+			for (uint32_t index : moved)
+				scene->moveSphere(index, spheres[index].mCenter);
+			boxes = scene->refit();
+		}
+		const double setupSeconds = secondsSince(start);
+		setupTotal += setupSeconds;
+
+		// a frame where nothing moved needs no setup either way. setups are short
+		// enough to want milliseconds
+		cerr << fixed << setprecision(3) << "frame " << frame << ": ";
+		if (moved.empty())
+			cerr << "nothing moved";
+		else
+		{
+			if (rebuild)
+			{
+				buildSeconds = setupSeconds;
+				++rebuilds;
+			}
+			else
+				++refits;
+			rebuildTotal += buildSeconds;
+			cerr << moved.size() << " moved, " << (rebuild ? "rebuilt" : "refit " + to_string(boxes) + " boxes") << " in "
+				<< setupSeconds * 1000.0 << "ms against a full build's " << buildSeconds * 1000.0 << "ms, tree at "
+				<< scene->refitGrowth() << "x its built area";
+		}
+		cerr << '\n';
+
+		start = Clock::now();
+		const Camera camera = pAnimation.cameraAt(frame).makeCamera(pAspectRatio);
+		frameSettings.mOutputPath = framePath(pSettings.mOutputPath, frame);
+		if (!multithreadRender(frameSettings, camera, *scene, scene->materials()))
+			return false;
+		renderTotal += secondsSince(start);
+	}
+
+	cerr << fixed << setprecision(3) << "\n" << pAnimation.mFrames << " frames, " << refits << " refit and " << rebuilds
+		<< " rebuilt: setup " << setupTotal * 1000.0 << "ms against " << rebuildTotal * 1000.0
+		<< "ms rebuilding every frame, rendering " << renderTotal << "s\n";
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !ANIMATION_H_
\ No newline at end of file
@@ -0,0 +1,1443 @@
+// -----------------------------------------------------------------------------
+#ifndef BENCHMARKS_H_
+#define BENCHMARKS_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "Bvh.h"
+#include "Camera.h"
+#include "CompiledScene.h"
+#include "Framebuffer.h"
+#include "HittableList.h"
+#include "ImageWriter.h"
+#include "JsonWriter.h"
+#include "Material.h"
+#include "MultiThreadFunctions.h"
+#include "rtweekend.h"
+#include "Sphere.h"
+#include "SphereSet.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// small timing helper, everything here reports in seconds
+class Stopwatch
+{
+public:
+	// ---- constructors
+	Stopwatch() : mStart(chrono::steady_clock::now()) {}
+
+	// ---- methods
+	void restart() { mStart = chrono::steady_clock::now(); }
+	double elapsed() const
+	{
+		return chrono::duration<double>(chrono::steady_clock::now() - mStart).count();
+	}
+
+	// ---- members
+	chrono::steady_clock::time_point mStart;
+};
+
+// -----------------------------------------------------------------------------
+
+// a cube of randomly placed small spheres with roughly constant density, so
+// the number of objects a ray passes near grows with the sphere count
+HittableList randomSphereField(int pCount)
+{
+	// only ever intersected, never shaded, so the material id is never looked up
+	HittableList world;
+	const MaterialId material = 0;
+	const double halfSize = 2.0 * cbrt(static_cast<double>(pCount));
+
+	for (int i = 0; i < pCount; ++i)
+	{
+		point3 center = vec3::random(-halfSize, halfSize);
+		world.add(make_shared<Sphere>(center, randomDouble(0.1, 0.5), material));
+	}
+
+	return world;
+}
+
+// -----------------------------------------------------------------------------
+
+// rays starting inside the scene bounds in uniformly random directions
+vector<Ray> randomBenchmarkRays(const Hittable& pWorld, int pCount)
+{
+	AABB bounds;
+	pWorld.boundingBox(bounds);
+
+	vector<Ray> rays;
+	rays.reserve(pCount);
+	for (int i = 0; i < pCount; ++i)
+	{
+		point3 origin(randomDouble(bounds.mMin.x(), bounds.mMax.x()),
+			randomDouble(bounds.mMin.y(), bounds.mMax.y()),
+			randomDouble(bounds.mMin.z(), bounds.mMax.z()));
+		rays.push_back(Ray(origin, randomUnitVector()));
+	}
+
+	return rays;
+}
+
+// -----------------------------------------------------------------------------
+
+// traces the rays over and over until at least pMinSeconds have passed. with
+// pAnyHit they're shadow rays, occluded() instead of hit()
+double raysPerSecond(const Hittable& pWorld, const vector<Ray>& pRays, double pMinSeconds, bool pAnyHit = false)
+{
+	HitRecord rec;
+	long long traced = 0;
+	long long hits = 0;
+	Stopwatch timer;
+
+	do
+	{
+		for (const Ray& r : pRays)
+		{
+			if (pAnyHit ? pWorld.occluded(r, kMinRayT, gInfinity) : pWorld.hit(r, kMinRayT, gInfinity, rec))
+				++hits;
+		}
+		traced += pRays.size();
+	} while (timer.elapsed() < pMinSeconds);
+
+	// keeps the loop from being optimised away
+	if (hits < 0)
+		cerr << hits;
+
+	return traced / timer.elapsed();
+}
+
+// -----------------------------------------------------------------------------
+
+// closest-hit throughput of the linear HittableList against the Bvh as the
+// number of spheres grows
+void benchmarkBvh(ostream& pOut)
+{
+	const int counts[] = { 16, 64, 256, 1024, 4096, 16384, 65536 };
+	const int numRays = 4096;
+	const double minSeconds = 0.25;
+
+	pOut << "spheres   build(ms)   list(rays/s)    bvh(rays/s)   speedup\n";
+
+	for (int count : counts)
+	{
+		HittableList world = randomSphereField(count);
+		vector<Ray> rays = randomBenchmarkRays(world, numRays);
+
+		Stopwatch buildTimer;
+		Bvh bvh(world);
+		const double buildMs = buildTimer.elapsed() * 1000.0;
+
+		const double listRate = raysPerSecond(world, rays, minSeconds);
+		const double bvhRate = raysPerSecond(bvh, rays, minSeconds);
+
+		pOut << setw(7) << count
+			<< setw(12) << fixed << setprecision(2) << buildMs
+			<< setw(15) << setprecision(0) << listRate
+			<< setw(15) << bvhRate
+			<< setw(10) << setprecision(1) << bvhRate / listRate << "x\n";
+	}
+
+	// and the scene we actually render, through the same camera as main
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+	vector<Ray> rays;
+	Sampler sampler;
+	Rng& rng = sampler.rng();
+	for (int i = 0; i < numRays; ++i)
+	{
+		const double u = randomDouble(rng);
+		rays.push_back(camera.getRay(u, randomDouble(rng), sampler));
+	}
+	Bvh bvh(world);
+	const double listRate = raysPerSecond(world, rays, minSeconds);
+	const double bvhRate = raysPerSecond(bvh, rays, minSeconds);
+
+	pOut << "randomScene (" << world.mvObjects.size() << " spheres): list "
+		<< setprecision(0) << listRate << " rays/s, bvh " << bvhRate << " rays/s, "
+		<< setprecision(1) << bvhRate / listRate << "x\n";
+}
+
+// primary camera rays into randomScene(), the rays the renderer starts with
+vector<Ray> randomSceneCameraRays(int pCount)
+{
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+	vector<Ray> rays;
+	Sampler sampler;
+	Rng& rng = sampler.rng();
+	for (int i = 0; i < pCount; ++i)
+	{
+		const double u = randomDouble(rng);
+		rays.push_back(camera.getRay(u, randomDouble(rng), sampler));
+	}
+	return rays;
+}
+
+// -----------------------------------------------------------------------------
+
+// the simd SphereSet against a HittableList of Spheres on randomScene(), both
+// flat and as the leaves of a Bvh
+void benchmarkSphereSet(ostream& pOut)
+{
+	const double minSeconds = 0.5;
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	SphereSet sphereSet(world);
+	Bvh bvh(world);
+	Bvh clusteredBvh(SphereSet::clusters(world));
+
+	vector<Ray> cameraRays = randomSceneCameraRays(4096);
+	vector<Ray> randomRays = randomBenchmarkRays(world, 4096);
+
+	pOut << "SphereSet kernel: " << simdName() << ", " << kSimdWidth << " spheres per test\n";
+	pOut << "structure                 camera(rays/s)   random(rays/s)\n";
+
+	auto row = [&](const char* pName, const Hittable& pWorld)
+	{
+		const double cameraRate = raysPerSecond(pWorld, cameraRays, minSeconds);
+		const double randomRate = raysPerSecond(pWorld, randomRays, minSeconds);
+		pOut << left << setw(26) << pName << right
+			<< setw(16) << fixed << setprecision(0) << cameraRate
+			<< setw(17) << randomRate << '\n';
+		return cameraRate;
+	};
+
+	const double listRate = row("HittableList<Sphere>", world);
+	const double setRate = row("SphereSet", sphereSet);
+	row("Bvh<Sphere>", bvh);
+	row("Bvh<SphereSet>", clusteredBvh);
+
+	pOut << "SphereSet vs HittableList: " << setprecision(1) << setRate / listRate << "x\n";
+}
+
+// true when every component of every pixel is bit for bit the same
+bool identicalImages(const Framebuffer& pA, const Framebuffer& pB)
+{
+	if (pA.width() != pB.width() || pA.height() != pB.height())
+		return false;
+
+	for (int j = 0; j < pA.height(); ++j)
+	{
+		for (int i = 0; i < pA.width(); ++i)
+		{
+			const FramePixel& a = pA.at(i, j);
+			const FramePixel& b = pB.at(i, j);
+			if (a.r != b.r || a.g != b.g || a.b != b.b)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// single rays against packets for low-bounce preview renders of randomScene().
+// both paths use the same sample seeds, so the images have to match exactly
+void benchmarkPackets(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Bvh clusteredBvh(SphereSet::clusters(world));
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 640;
+	settings.mImageHeight = 360;
+	settings.mSamplesPerPixel = 2;
+
+	pOut << "structure        depth   single(ms)   packet(ms)   speedup   identical\n";
+
+	auto row = [&](const char* pName, const Hittable& pWorld, int pMaxDepth)
+	{
+		settings.mMaxDepth = pMaxDepth;
+
+		settings.mUsePackets = false;
+		Stopwatch timer;
+		Framebuffer single = renderFrame(settings, camera, pWorld, materials);
+		const double singleMs = timer.elapsed() * 1000.0;
+
+		settings.mUsePackets = true;
+		timer.restart();
+		Framebuffer packet = renderFrame(settings, camera, pWorld, materials);
+		const double packetMs = timer.elapsed() * 1000.0;
+
+		pOut << left << setw(17) << pName << right
+			<< setw(5) << pMaxDepth
+			<< setw(13) << fixed << setprecision(1) << singleMs
+			<< setw(13) << packetMs
+			<< setw(9) << setprecision(2) << singleMs / packetMs << "x"
+			<< setw(12) << (identicalImages(single, packet) ? "yes" : "no") << '\n';
+	};
+
+	row("Bvh<Sphere>", bvh, 1);
+	row("Bvh<Sphere>", bvh, 3);
+	row("Bvh<SphereSet>", clusteredBvh, 1);
+	row("Bvh<SphereSet>", clusteredBvh, 3);
+}
+
+// -----------------------------------------------------------------------------
+
+// the largest difference in any channel of the per pixel averages
+double maxPixelDifference(const Framebuffer& pA, const Framebuffer& pB, int pSamplesPerPixel)
+{
+	double worst = 0.0;
+	for (int j = 0; j < pA.height(); ++j)
+	{
+		for (int i = 0; i < pA.width(); ++i)
+		{
+			const colour a = pA.get(i, j);
+			const colour b = pB.get(i, j);
+			for (int k = 0; k < 3; ++k)
+				worst = fmax(worst, fabs(a[k] - b[k]) / pSamplesPerPixel);
+		}
+	}
+	return worst;
+}
+
+// -----------------------------------------------------------------------------
+
+double meanPixelValue(const Framebuffer& pPixels, int pSamplesPerPixel)
+{
+	double sum = 0.0;
+	size_t count = 0;
+	for (int j = 0; j < pPixels.height(); ++j)
+	{
+		for (int i = 0; i < pPixels.width(); ++i)
+		{
+			const FramePixel& pixel = pPixels.at(i, j);
+			sum += (double(pixel.r) + pixel.g + pixel.b) / (3.0 * pSamplesPerPixel);
+			++count;
+		}
+	}
+	return count > 0 ? sum / count : 0.0;
+}
+
+// -----------------------------------------------------------------------------
+
+// the tiled recursive renderer against the wavefront one on randomScene(). both
+// draw the same random numbers for each sample so the images should only differ
+// by floating point rounding, the mean and the worst pixel show if they don't
+void benchmarkWavefront(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 400;
+	settings.mImageHeight = 225;
+	settings.mSamplesPerPixel = 8;
+	settings.mMaxDepth = 50;
+
+	settings.mMode = RenderMode::Tiled;
+	Stopwatch timer;
+	Framebuffer tiled = renderFrame(settings, camera, bvh, materials);
+	const double tiledMs = timer.elapsed() * 1000.0;
+
+	settings.mMode = RenderMode::Wavefront;
+	WavefrontStats stats;
+	timer.restart();
+	Framebuffer wavefront = renderWavefront(settings, camera, bvh, materials, &stats);
+	const double wavefrontMs = timer.elapsed() * 1000.0;
+
+	pOut << "renderer      time(ms)   mean value\n";
+	pOut << left << setw(12) << "tiled" << right << setw(10) << fixed << setprecision(1) << tiledMs
+		<< setw(13) << setprecision(5) << meanPixelValue(tiled, settings.mSamplesPerPixel) << '\n';
+	pOut << left << setw(12) << "wavefront" << right << setw(10) << setprecision(1) << wavefrontMs
+		<< setw(13) << setprecision(5) << meanPixelValue(wavefront, settings.mSamplesPerPixel) << '\n';
+	pOut << "max pixel difference " << scientific << setprecision(2)
+		<< maxPixelDifference(tiled, wavefront, settings.mSamplesPerPixel) << fixed << "\n\n";
+
+	stats.printReport(pOut);
+}
+
+// -----------------------------------------------------------------------------
+
+// root mean square difference of the per pixel averages. with pDisplaySpace
+// the writer's gamma is applied first, which is closer to what you'd see
+double rmsePixels(const Framebuffer& pImage, int pImageSamples,
+	const Framebuffer& pReference, int pReferenceSamples, bool pDisplaySpace = false)
+{
+	double sum = 0.0;
+	size_t count = 0;
+	for (int j = 0; j < pImage.height(); ++j)
+	{
+		for (int i = 0; i < pImage.width(); ++i)
+		{
+			colour image = pImage.get(i, j) / pImageSamples;
+			colour reference = pReference.get(i, j) / pReferenceSamples;
+			if (pDisplaySpace)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					image[k] = sqrt(fmax(image[k], 0.0));
+					reference[k] = sqrt(fmax(reference[k], 0.0));
+				}
+			}
+			const colour diff = image - reference;
+			sum += diff.lengthSquared();
+			count += 3;
+		}
+	}
+	return count > 0 ? sqrt(sum / count) : 0.0;
+}
+
+// -----------------------------------------------------------------------------
+
+// recursion depth and russian roulette on randomScene(). noise is the rmse
+// against a reference rendered without roulette at many more samples. since
+// variance falls with 1/spp, time * (rmse / baseline rmse)^2 is how long each
+// setting would take to get as clean as the baseline
+void benchmarkRoulette(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 200;
+	settings.mImageHeight = 112;
+	settings.mMaxDepth = 50;
+
+	settings.mSamplesPerPixel = 128;
+	settings.mSeed = 1;
+	const Framebuffer reference = renderFrame(settings, camera, bvh, materials);
+	const int referenceSamples = settings.mSamplesPerPixel;
+
+	settings.mSamplesPerPixel = 16;
+	settings.mSeed = 0;
+
+	pOut << "roulette   threshold   path length   time(ms)       rmse   equal noise(ms)\n";
+
+	double baselineRmse = 0.0;
+	auto row = [&](bool pRoulette, double pThreshold)
+	{
+		settings.mRussianRoulette = pRoulette;
+		settings.mRouletteThreshold = pThreshold;
+
+		PathStats pathStats;
+		Stopwatch timer;
+		Framebuffer image = renderFrame(settings, camera, bvh, materials, nullptr, &pathStats);
+		const double ms = timer.elapsed() * 1000.0;
+
+		const double rmse = rmsePixels(image, settings.mSamplesPerPixel, reference, referenceSamples);
+		if (!pRoulette)
+			baselineRmse = rmse;
+		const double relative = rmse / baselineRmse;
+
+		pOut << setw(8) << (pRoulette ? "on" : "off")
+			<< setw(12) << fixed << setprecision(2) << pThreshold
+			<< setw(14) << setprecision(3) << pathStats.averageLength()
+			<< setw(11) << setprecision(1) << ms
+			<< setw(11) << setprecision(5) << rmse
+			<< setw(18) << setprecision(1) << ms * relative * relative << '\n';
+	};
+
+	row(false, 0.0);
+	row(true, 0.05);
+	row(true, 0.1);
+	row(true, 0.25);
+	row(true, 0.5);
+}
+
+// -----------------------------------------------------------------------------
+
+// the output stage on its own for a 4k frame. the pixels are a gradient with
+// some noise on top, roughly what a render looks like to an encoder
+void benchmarkImageOutput(ostream& pOut)
+{
+	const int width = 3840;
+	const int height = 2160;
+	const int samplesPerPixel = 16;
+
+	Rng rng(7);
+	Framebuffer pixels(width, height);
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const colour base(double(i) / width, double(j) / height, 0.5);
+			pixels.set(i, j, samplesPerPixel * (base + 0.05 * vec3::random(rng)), samplesPerPixel);
+		}
+	}
+
+	pOut << "format     time(ms)   size(MB)   speedup\n";
+
+	double p3Ms = 0.0;
+	const ImageFormat formats[] = { ImageFormat::P3, ImageFormat::P6, ImageFormat::Pfm, ImageFormat::Qoi };
+	for (ImageFormat format : formats)
+	{
+		const string path = string("benchmark_output") + imageFormatExtension(format);
+
+		Stopwatch timer;
+		writeImage(path, format, pixels, samplesPerPixel);
+		const double ms = timer.elapsed() * 1000.0;
+		if (format == ImageFormat::P3)
+			p3Ms = ms;
+
+		ifstream written(path, ios::binary | ios::ate);
+		const double megabytes = written ? static_cast<double>(written.tellg()) / (1024.0 * 1024.0) : 0.0;
+		written.close();
+		remove(path.c_str());
+
+		pOut << left << setw(8) << imageFormatName(format) << right
+			<< setw(11) << fixed << setprecision(1) << ms
+			<< setw(11) << setprecision(2) << megabytes
+			<< setw(9) << setprecision(1) << p3Ms / ms << "x\n";
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// a 4k frame as the rows of colours the renderers used to write into against
+// the Framebuffer: what each takes, how long adding one pass into another takes
+// (the progressive loop), and how long every thread filling its own tiles
+// takes, tiles dealt round robin like the scheduler does when nothing steals
+void benchmarkFramebuffer(ostream& pOut)
+{
+	const int width = 3840;
+	const int height = 2160;
+	const int tileSize = kFramebufferTileSize;
+	const int rounds = 8;
+	const unsigned int numThreads = thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 4;
+
+	Rng rng(11);
+	vector<vector<colour>> rowsA(height, vector<colour>(width)), rowsB(height, vector<colour>(width));
+	Framebuffer frameA(width, height, tileSize), frameB(width, height, tileSize);
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const colour c = vec3::random(rng);
+			rowsB[j][i] = c;
+			frameB.set(i, j, c, 1);
+		}
+	}
+
+	const double rowsMB = static_cast<double>(height) * (sizeof(vector<colour>) + width * sizeof(colour)) / (1024.0 * 1024.0);
+	const double frameMB = static_cast<double>(frameA.bytes()) / (1024.0 * 1024.0);
+
+	Stopwatch timer;
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int j = 0; j < height; ++j)
+		{
+			for (int i = 0; i < width; ++i)
+				rowsA[j][i] += rowsB[j][i];
+		}
+	}
+	const double rowsAddMs = timer.elapsed() * 1000.0 / rounds;
+
+	timer.restart();
+	for (int r = 0; r < rounds; ++r)
+		frameA.accumulate(frameB);
+	const double frameAddMs = timer.elapsed() * 1000.0 / rounds;
+
+	const vector<Tile> tiles = makeTiles(width, height, tileSize, TileOrder::Scanline);
+	auto fillTiles = [&](function<void(const Tile&, const colour&)> pWrite)
+	{
+		Stopwatch fillTimer;
+		vector<thread> threads;
+		for (unsigned int t = 0; t < numThreads; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for (int r = 0; r < rounds; ++r)
+				{
+					for (size_t n = t; n < tiles.size(); n += numThreads)
+						pWrite(tiles[n], colour(r, t, n));
+				}
+			});
+		}
+		for (thread& worker : threads)
+			worker.join();
+		return fillTimer.elapsed() * 1000.0 / rounds;
+	};
+
+	const double rowsFillMs = fillTiles([&](const Tile& pTile, const colour& pValue)
+	{
+		for (int j = pTile.mY0; j < pTile.mY1; ++j)
+		{
+			for (int i = pTile.mX0; i < pTile.mX1; ++i)
+				rowsA[j][i] = pValue;
+		}
+	});
+	const double frameFillMs = fillTiles([&](const Tile& pTile, const colour& pValue)
+	{
+		const FramePixel pixel = { float(pValue.x()), float(pValue.y()), float(pValue.z()), 1.0f };
+		for (int j = pTile.mY0; j < pTile.mY1; ++j)
+		{
+			FramePixel* row = &frameA.at(pTile.mX0, j);
+			for (int i = 0; i < pTile.width(); ++i)
+				row[i] = pixel;
+		}
+	});
+
+	pOut << "layout        size(MB)   accumulate(ms)   tile writes(ms), " << numThreads << " threads\n";
+	pOut << left << setw(12) << "rows" << right << fixed << setprecision(1)
+		<< setw(10) << rowsMB << setw(17) << setprecision(2) << rowsAddMs << setw(18) << rowsFillMs << '\n';
+	pOut << left << setw(12) << "framebuffer" << right << fixed << setprecision(1)
+		<< setw(10) << frameMB << setw(17) << setprecision(2) << frameAddMs << setw(18) << frameFillMs << '\n';
+}
+
+// -----------------------------------------------------------------------------
+
+// fixed sample counts against adaptive sampling on randomScene(), scored by
+// rmse against a high sample reference after gamma. the aim is for an adaptive
+// row to match a fixed row's rmse with fewer samples
+void benchmarkAdaptive(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 160;
+	settings.mImageHeight = 90;
+	settings.mMaxDepth = 50;
+
+	settings.mSamplesPerPixel = 512;
+	settings.mSeed = 1;
+	const Framebuffer reference = renderFrame(settings, camera, bvh, materials);
+	const int referenceSamples = settings.mSamplesPerPixel;
+	settings.mSeed = 0;
+
+	pOut << "sampling    min    max   threshold   avg spp    Mrays   time(ms)       rmse\n";
+
+	auto row = [&](bool pAdaptive, int pMinSamples, int pMaxSamples, double pThreshold)
+	{
+		settings.mAdaptive = pAdaptive;
+		settings.mMinSamples = pMinSamples;
+		settings.mSamplesPerPixel = pMaxSamples;
+		settings.mAdaptiveThreshold = pThreshold;
+
+		PathStats pathStats;
+		Stopwatch timer;
+		Framebuffer image = renderFrame(settings, camera, bvh, materials, nullptr, &pathStats);
+		const double ms = timer.elapsed() * 1000.0;
+
+		pOut << setw(8) << (pAdaptive ? "adaptive" : "fixed")
+			<< setw(7) << (pAdaptive ? pMinSamples : pMaxSamples)
+			<< setw(7) << pMaxSamples
+			<< setw(12) << fixed << setprecision(3) << (pAdaptive ? pThreshold : 0.0)
+			<< setw(10) << setprecision(1) << static_cast<double>(pathStats.mPaths) / (settings.mImageWidth * settings.mImageHeight)
+			<< setw(9) << setprecision(2) << pathStats.mSegments / 1e6
+			<< setw(11) << setprecision(1) << ms
+			<< setw(11) << setprecision(5) << rmsePixels(image, pMaxSamples, reference, referenceSamples, true) << '\n';
+	};
+
+	row(false, 0, 16, 0.0);
+	row(false, 0, 32, 0.0);
+	row(false, 0, 64, 0.0);
+	row(true, 16, 64, 0.03);
+	row(true, 16, 64, 0.02);
+	row(true, 16, 128, 0.015);
+}
+
+// -----------------------------------------------------------------------------
+
+// the denoiser against plain sampling on randomScene(). the rmse is against a
+// reference with many more samples, in display space. a denoised row is as good
+// as the plain row with the same rmse, so the spp it takes to get there is the
+// saving
+void benchmarkDenoise(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 400;
+	settings.mImageHeight = 225;
+	settings.mMaxDepth = 50;
+
+	settings.mSamplesPerPixel = 512;
+	settings.mSeed = 1;
+	const Framebuffer reference = renderFrame(settings, camera, bvh, materials);
+	const int referenceSamples = settings.mSamplesPerPixel;
+	settings.mSeed = 0;
+
+	ThreadPool pool;
+	pOut << "sampling     spp   render(ms)  denoise(ms)       rmse\n";
+
+	auto row = [&](bool pDenoise, int pSamples)
+	{
+		settings.mSamplesPerPixel = pSamples;
+
+		AovBuffers aovs;
+		Stopwatch timer;
+		Framebuffer image = renderFrame(settings, camera, bvh, materials, nullptr, nullptr, nullptr,
+			pDenoise ? &aovs : nullptr);
+		const double renderMs = timer.elapsed() * 1000.0;
+
+		Stopwatch denoiseTimer;
+		if (pDenoise)
+			image = denoise(image, pSamples, aovs, DenoiseSettings(), pool);
+		const double denoiseMs = denoiseTimer.elapsed() * 1000.0;
+
+		pOut << setw(8) << (pDenoise ? "denoised" : "plain")
+			<< setw(8) << pSamples
+			<< setw(13) << fixed << setprecision(1) << renderMs
+			<< setw(13) << (pDenoise ? denoiseMs : 0.0)
+			<< setw(11) << setprecision(5) << rmsePixels(image, pSamples, reference, referenceSamples, true) << '\n';
+	};
+
+	for (int samples : { 8, 16, 32, 64, 128 })
+		row(false, samples);
+	for (int samples : { 8, 16 })
+		row(true, samples);
+}
+
+// -----------------------------------------------------------------------------
+
+// the samplers on randomScene() against a reference of many independent
+// samples with another seed. each sampler renders a ladder of spp, and the
+// equal time columns read its rmse off that ladder (log-log, between rungs) at
+// the time independent sampling took for its most samples, and how many spp it
+// needs to get as clean as that
+void benchmarkSamplers(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 200;
+	settings.mImageHeight = 112;
+	settings.mMaxDepth = 50;
+
+	settings.mSamplesPerPixel = 1024;
+	settings.mSeed = 1;
+	const Framebuffer reference = renderFrame(settings, camera, bvh, materials);
+	const int referenceSamples = settings.mSamplesPerPixel;
+	settings.mSeed = 0;
+
+	const vector<int> ladder = { 4, 8, 16, 32, 64 };
+	const SamplerType samplers[] = { SamplerType::Independent, SamplerType::Stratified, SamplerType::Sobol,
+		SamplerType::Halton };
+
+	struct Rung
+	{
+		double mMs;
+		double mRmse;
+	};
+
+	pOut << "sampler         spp   time(ms)       rmse\n";
+	vector<vector<Rung>> rungs;
+	for (SamplerType sampler : samplers)
+	{
+		settings.mSampler = sampler;
+		rungs.push_back({});
+		for (int samples : ladder)
+		{
+			settings.mSamplesPerPixel = samples;
+			Stopwatch timer;
+			const Framebuffer image = renderFrame(settings, camera, bvh, materials);
+			const Rung rung = { timer.elapsed() * 1000.0, rmsePixels(image, samples, reference, referenceSamples) };
+			rungs.back().push_back(rung);
+
+			pOut << left << setw(12) << samplerName(sampler) << right
+				<< setw(7) << samples
+				<< setw(11) << fixed << setprecision(1) << rung.mMs
+				<< setw(11) << setprecision(5) << rung.mRmse << '\n';
+		}
+	}
+
+	// straight lines between the rungs in log-log, carried on past the ends
+	auto between = [](double pX, double pX0, double pY0, double pX1, double pY1)
+	{
+		const double t = (log(pX) - log(pX0)) / (log(pX1) - log(pX0));
+		return exp(log(pY0) + t * (log(pY1) - log(pY0)));
+	};
+	auto rmseAt = [&](const vector<Rung>& pRungs, double pMs)
+	{
+		size_t n = 1;
+		while (n + 1 < pRungs.size() && pRungs[n].mMs < pMs)
+			++n;
+		return between(pMs, pRungs[n - 1].mMs, pRungs[n - 1].mRmse, pRungs[n].mMs, pRungs[n].mRmse);
+	};
+	auto samplesFor = [&](const vector<Rung>& pRungs, double pRmse)
+	{
+		size_t n = 1;
+		while (n + 1 < pRungs.size() && pRungs[n].mRmse > pRmse)
+			++n;
+		return between(pRmse, pRungs[n - 1].mRmse, ladder[n - 1], pRungs[n].mRmse, ladder[n]);
+	};
+
+	const double budgetMs = rungs[0].back().mMs;
+	const double targetRmse = rungs[0].back().mRmse;
+	pOut << "\nat " << setprecision(1) << budgetMs << "ms   rmse   spp for rmse " << setprecision(5) << targetRmse << '\n';
+	for (size_t k = 0; k < rungs.size(); ++k)
+	{
+		pOut << left << setw(12) << samplerName(samplers[k]) << right
+			<< setw(11) << setprecision(5) << rmseAt(rungs[k], budgetMs)
+			<< setw(18) << setprecision(1) << samplesFor(rungs[k], targetRmse) << '\n';
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// a closed room lit by one small sphere, smallpt's box with spheres for walls.
+// nothing gets out, so all the light there is comes off the lamp
+HittableList litRoom(MaterialTable& pMaterials)
+{
+	const MaterialId white = pMaterials.add(Lambertian(colour(0.75, 0.75, 0.75)));
+	const MaterialId red = pMaterials.add(Lambertian(colour(0.75, 0.25, 0.25)));
+	const MaterialId green = pMaterials.add(Lambertian(colour(0.25, 0.75, 0.25)));
+	const MaterialId mirror = pMaterials.add(Metal(colour(0.9, 0.9, 0.9), 0.0));
+	const MaterialId glass = pMaterials.add(Dielectric(1.5));
+	const MaterialId lamp = pMaterials.add(DiffuseLight(colour(12, 12, 12)));
+
+	HittableList world;
+	world.add(make_shared<Sphere>(point3(-1002, 2, 0), 1000, red));
+	world.add(make_shared<Sphere>(point3(1002, 2, 0), 1000, green));
+	world.add(make_shared<Sphere>(point3(0, -1000, 0), 1000, white));
+	world.add(make_shared<Sphere>(point3(0, 1004, 0), 1000, white));
+	world.add(make_shared<Sphere>(point3(0, 2, -1002), 1000, white));
+	world.add(make_shared<Sphere>(point3(0, 2, 1006), 1000, white));
+	world.add(make_shared<Sphere>(point3(-0.9, 0.7, -0.8), 0.7, mirror));
+	world.add(make_shared<Sphere>(point3(0.9, 0.7, 0.3), 0.7, glass));
+	world.add(make_shared<Sphere>(point3(0, 3.5, 0), 0.3, lamp));
+	return world;
+}
+
+// next event estimation against the bounces finding the lamp on their own, in
+// litRoom(). no path ever escapes the room, so roulette is on to end them.
+// the rmse is against a reference of many samples with both, and
+// equal noise is how long the row would take to get as clean as the bounces
+// alone at the same spp (time * (rmse / their rmse)^2). the mean is there to
+// show both ways add up to the same light. after that, the shadow ray's early
+// exit on randomScene(): any hit against closest hit over the same rays
+void benchmarkLights(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = litRoom(materials);
+	CompiledScene scene(world, materials);
+	Camera camera(point3(0, 2, 5), point3(0, 2, 0), vec3(0, 1, 0), 50, 16.0 / 9.0, 0.0, 5.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 160;
+	settings.mImageHeight = 90;
+	settings.mMaxDepth = 50;
+	settings.mRussianRoulette = true;
+
+	settings.mSamplesPerPixel = 512;
+	settings.mSeed = 1;
+	const Framebuffer reference = renderFrame(settings, camera, scene, scene.materials());
+	const int referenceSamples = settings.mSamplesPerPixel;
+	settings.mSeed = 0;
+
+	pOut << "light sampling    spp   time(ms)       mean       rmse   equal noise(ms)\n";
+	for (int samples : { 4, 16, 64 })
+	{
+		settings.mSamplesPerPixel = samples;
+		double bsdfRmse = 0.0;
+		for (bool lightSampling : { false, true })
+		{
+			settings.mLightSampling = lightSampling;
+			Stopwatch timer;
+			const Framebuffer image = renderFrame(settings, camera, scene, scene.materials());
+			const double ms = timer.elapsed() * 1000.0;
+
+			const double rmse = rmsePixels(image, samples, reference, referenceSamples);
+			if (!lightSampling)
+				bsdfRmse = rmse;
+			const double relative = rmse / bsdfRmse;
+
+			pOut << setw(14) << (lightSampling ? "nee + mis" : "off")
+				<< setw(7) << samples
+				<< setw(11) << fixed << setprecision(1) << ms
+				<< setw(11) << setprecision(5) << meanPixelValue(image, samples)
+				<< setw(11) << rmse
+				<< setw(18) << setprecision(1) << ms * relative * relative << '\n';
+		}
+	}
+
+	MaterialTable randomMaterials;
+	HittableList randomWorld = randomScene(randomMaterials);
+	CompiledScene randomCompiled(randomWorld, randomMaterials);
+	const vector<Ray> rays = randomBenchmarkRays(randomCompiled, 4096);
+	pOut << setprecision(0) << "\nrandom rays in randomScene(), closest hit "
+		<< raysPerSecond(randomCompiled, rays, 0.5) << " rays/s, any hit "
+		<< raysPerSecond(randomCompiled, rays, 0.5, true) << " rays/s\n";
+}
+
+// -----------------------------------------------------------------------------
+
+// Real is picked at build time, so this is run once from each build. it times
+// randomScene() at this precision and saves the frame as a pfm. if the other
+// build has already left its pfm behind, the two are compared
+void benchmarkPrecision(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Bvh bvh(world);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 400;
+	settings.mImageHeight = 225;
+	settings.mSamplesPerPixel = 32;
+	settings.mMaxDepth = 50;
+
+	PathStats pathStats;
+	Stopwatch timer;
+	Framebuffer image = renderFrame(settings, camera, bvh, materials, nullptr, &pathStats);
+	const double ms = timer.elapsed() * 1000.0;
+
+	const string otherName = string(kPrecisionName) == "float" ? "double" : "float";
+	const string path = string("precision_") + kPrecisionName + ".pfm";
+	const string otherPath = "precision_" + otherName + ".pfm";
+	writeImage(path, ImageFormat::Pfm, image, settings.mSamplesPerPixel);
+
+	pOut << "precision " << kPrecisionName << " (" << simdName() << ", " << kSimdWidth << " lanes)\n"
+		<< "frame time " << fixed << setprecision(1) << ms << "ms, average path length "
+		<< setprecision(3) << pathStats.averageLength() << ", mean " << setprecision(5)
+		<< meanPixelValue(image, settings.mSamplesPerPixel) << '\n';
+
+	// read the other build's pfm back, rows bottom up like ours
+	ifstream other(otherPath, ios::binary);
+	string magic;
+	int width = 0, height = 0;
+	double scale = 0.0;
+	if (!(other >> magic >> width >> height >> scale) || magic != "PF"
+		|| width != settings.mImageWidth || height != settings.mImageHeight)
+	{
+		pOut << "run the " << otherName << " build to compare against it\n";
+		return;
+	}
+	other.get();
+
+	vector<float> values(static_cast<size_t>(width) * height * 3);
+	other.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float));
+
+	double sum = 0.0;
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				const double diff = image.get(i, j)[k] / settings.mSamplesPerPixel - values[(static_cast<size_t>(j) * width + i) * 3 + k];
+				sum += diff * diff;
+			}
+		}
+	}
+	pOut << "rmse against " << otherName << ' ' << scientific << setprecision(3)
+		<< sqrt(sum / values.size()) << fixed << '\n';
+}
+
+// -----------------------------------------------------------------------------
+
+// rays per second through the whole renderer on randomScene(), every ray of
+// every path counted, for a range of thread counts. the scene is shared by all
+// the threads, so this is where contention on it shows up
+void benchmarkRayThroughput(ostream& pOut)
+{
+	MaterialTable materials;
+	const HittableList world = randomScene(materials);
+	CompiledScene scene(world, materials);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	RenderSettings settings;
+	settings.mImageWidth = 400;
+	settings.mImageHeight = 225;
+	settings.mSamplesPerPixel = 8;
+	settings.mMaxDepth = 50;
+
+	// closest hit on its own, no shading, one thread
+	vector<Ray> cameraRays = randomSceneCameraRays(4096);
+	pOut << "closest hit on camera rays " << fixed << setprecision(0)
+		<< raysPerSecond(scene, cameraRays, 0.5) << " rays/s\n";
+
+	pOut << "threads  frame ms        rays/s\n";
+	for (unsigned int threads : { 1u, 2u, 4u, 8u, 16u, 32u })
+	{
+		settings.mThreads = threads;
+		PathStats pathStats;
+		Stopwatch timer;
+		renderFrame(settings, camera, scene, scene.materials(), nullptr, &pathStats);
+		const double seconds = timer.elapsed();
+
+		pOut << setw(7) << threads
+			<< setw(10) << setprecision(1) << seconds * 1000.0
+			<< setw(14) << setprecision(0) << pathStats.mSegments / seconds << '\n';
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// the Bvh over a HittableList against the same scene compiled into one block,
+// for how long they take to set up, how much memory they spread over and how
+// fast they trace. both build the same tree so the images match exactly
+void benchmarkCompiledScene(ostream& pOut)
+{
+	MaterialTable materials;
+	HittableList world = randomScene(materials);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	Stopwatch bvhTimer;
+	Bvh bvh(world);
+	const double bvhMs = bvhTimer.elapsed() * 1000.0;
+
+	Stopwatch compileTimer;
+	CompiledScene scene(world, materials);
+	const double compileMs = compileTimer.elapsed() * 1000.0;
+
+	// the list is a shared_ptr and a separately allocated sphere per object,
+	// the bvh adds its nodes, leaf references and sphere copies on top
+	const size_t objects = world.mvObjects.size();
+	const size_t listBytes = objects * (sizeof(shared_ptr<Hittable>) + sizeof(Sphere) + 2 * sizeof(long))
+		+ materials.size() * sizeof(Material);
+	const size_t bvhBytes = bvh.mvNodes.size() * sizeof(BvhNode) + bvh.mvPrimitives.size() * sizeof(BvhPrimitive)
+		+ bvh.mvSpheres.size() * sizeof(Sphere);
+
+	pOut << fixed << setprecision(2)
+		<< "list + bvh      setup " << bvhMs << "ms, " << (listBytes + bvhBytes) / 1024.0 << "KB in "
+		<< objects + 4 << " allocations\n"
+		<< "compiled scene  setup " << compileMs << "ms, " << scene.sizeInBytes() / 1024.0 << "KB in 1 allocation\n";
+
+	vector<Ray> cameraRays = randomSceneCameraRays(4096);
+	pOut << setprecision(0) << "closest hit on camera rays, bvh " << raysPerSecond(bvh, cameraRays, 0.5)
+		<< " rays/s, compiled " << raysPerSecond(scene, cameraRays, 0.5) << " rays/s\n";
+
+	RenderSettings settings;
+	settings.mImageWidth = 400;
+	settings.mImageHeight = 225;
+	settings.mSamplesPerPixel = 8;
+	settings.mMaxDepth = 50;
+
+	auto row = [&](const char* pName, const Hittable& pWorld, Span<const Material> pMaterials,
+		Framebuffer& pImage)
+	{
+		PathStats pathStats;
+		Stopwatch timer;
+		pImage = renderFrame(settings, camera, pWorld, pMaterials, nullptr, &pathStats);
+		const double seconds = timer.elapsed();
+		pOut << pName << " frame " << setprecision(1) << seconds * 1000.0 << "ms, "
+			<< setprecision(0) << pathStats.mSegments / seconds << " rays/s\n";
+	};
+
+	Framebuffer bvhImage, compiledImage;
+	row("bvh     ", bvh, materials, bvhImage);
+	row("compiled", scene, scene.materials(), compiledImage);
+	pOut << "max pixel difference " << scientific << setprecision(2)
+		<< maxPixelDifference(bvhImage, compiledImage, settings.mSamplesPerPixel) << fixed << '\n';
+}
+
+// -----------------------------------------------------------------------------
+
+// everything below is the suite rtbench runs. results are kept as numbers so
+// they can be printed as a table and written out as json to compare builds
+
+// randomScene() draws from the calling thread's rng, so it's restarted first
+// to get the same scene no matter what ran before
+HittableList benchmarkScene(MaterialTable& pMaterials)
+{
+	threadRng() = Rng();
+	return randomScene(pMaterials);
+}
+
+struct MicroResult
+{
+	string mName;
+	double mNsPerOp;
+	uint64_t mOps;
+};
+
+// calls pOp(i) for i = 0, 1, 2... in batches of pBatch until pMinSeconds have
+// passed. whatever pOp returns is added up and printed to nowhere, so the
+// compiler can't throw the work away
+template<typename TOp>
+MicroResult runMicro(const string& pName, size_t pBatch, double pMinSeconds, TOp&& pOp)
+{
+	// a short warm up so the first batch isn't paying for cold caches
+	double sink = 0.0;
+	for (size_t i = 0; i < pBatch; ++i)
+		sink += pOp(i);
+
+	uint64_t ops = 0;
+	Stopwatch timer;
+	do
+	{
+		for (size_t i = 0; i < pBatch; ++i)
+			sink += pOp(ops + i);
+		ops += pBatch;
+	} while (timer.elapsed() < pMinSeconds);
+	const double seconds = timer.elapsed();
+
+	if (sink == -1.0)
+		cerr << sink;
+
+	return { pName, seconds * 1e9 / ops, ops };
+}
+
+// -----------------------------------------------------------------------------
+
+// the innermost functions of the renderer on their own, each one fed inputs
+// from a small pregenerated pool so the timings are of the function and not
+// of making up its arguments
+vector<MicroResult> runMicroBenchmarks(double pMinSeconds)
+{
+	const size_t kPool = 1024;
+	const size_t kMask = kPool - 1;
+	const size_t batch = 4096;
+	vector<MicroResult> results;
+
+	MaterialTable materials;
+	HittableList world = benchmarkScene(materials);
+	Bvh bvh(world);
+	CompiledScene scene(world, materials);
+	vector<Ray> cameraRays = randomSceneCameraRays(static_cast<int>(kPool));
+
+	// rays from a shell around a unit sphere aimed near it, about half of them hit
+	Sphere sphere(point3(0, 0, 0), 1.0, 0);
+	vector<Ray> sphereRays;
+	Rng rng(1);
+	for (size_t i = 0; i < kPool; ++i)
+	{
+		const point3 origin = 4.0 * randomUnitVector(rng);
+		sphereRays.push_back(Ray(origin, point3(0, 0, 0) + 1.4 * randomInUnitSphere(rng) - origin));
+	}
+
+	results.push_back(runMicro("Sphere::hit", batch, pMinSeconds, [&](size_t i)
+	{
+		HitRecord rec;
+		return sphere.Sphere::hit(sphereRays[i & kMask], kMinRayT, gInfinity, rec) ? 1.0 : 0.0;
+	}));
+
+	auto closestHit = [&](const char* pName, const Hittable& pWorld)
+	{
+		results.push_back(runMicro(pName, batch, pMinSeconds, [&](size_t i)
+		{
+			HitRecord rec;
+			return pWorld.hit(cameraRays[i & kMask], kMinRayT, gInfinity, rec) ? rec.mTrace : 0.0;
+		}));
+	};
+	closestHit("HittableList::hit randomScene", world);
+	closestHit("Bvh::hit randomScene", bvh);
+	closestHit("CompiledScene::hit randomScene", scene);
+
+	// every scatter starts from a hit on the top of a unit sphere, with the
+	// incoming directions spread over the upper hemisphere
+	vector<Ray> incoming;
+	for (size_t i = 0; i < kPool; ++i)
+	{
+		const vec3 from = randomInHemisphere(vec3(0, 1, 0), rng);
+		incoming.push_back(Ray(point3(0, 1, 0) + from, -from));
+	}
+	HitRecord surface;
+	surface.mPoint = point3(0, 1, 0);
+	surface.mTrace = 1.0;
+	surface.mMaterialId = 0;
+
+	auto scatter = [&](const char* pName, const Material& pMaterial)
+	{
+		Sampler scatterSampler;
+		scatterSampler.rng().seed(2);
+		results.push_back(runMicro(pName, batch, pMinSeconds, [&](size_t i)
+		{
+			const Ray& ray = incoming[i & kMask];
+			HitRecord rec = surface;
+			rec.setFaceNormal(ray, vec3(0, 1, 0));
+			Ray scattered;
+			colour attenuation;
+			pMaterial.scatter(ray, rec, attenuation, scattered, scatterSampler);
+			return scattered.mDir.x() + attenuation.x();
+		}));
+	};
+	scatter("Material::scatter lambertian", Lambertian(colour(0.5, 0.5, 0.5)));
+	scatter("Material::scatter metal", Metal(colour(0.7, 0.6, 0.5), 0.3));
+	scatter("Material::scatter dielectric", Dielectric(1.5));
+
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+	Sampler cameraSampler;
+	cameraSampler.rng() = rng;
+	results.push_back(runMicro("Camera::getRay", batch, pMinSeconds, [&](size_t i)
+	{
+		const Real u = static_cast<Real>(i & kMask) / kPool;
+		const Real v = static_cast<Real>((i >> 10) & kMask) / kPool;
+		return camera.getRay(u, v, cameraSampler).mDir.x();
+	}));
+
+	results.push_back(runMicro("randomInUnitSphere", batch, pMinSeconds, [&](size_t)
+	{
+		return randomInUnitSphere(rng).x();
+	}));
+	results.push_back(runMicro("randomInUnitDisk", batch, pMinSeconds, [&](size_t)
+	{
+		return randomInUnitDisk(rng).x();
+	}));
+
+	return results;
+}
+
+// -----------------------------------------------------------------------------
+
+// the rejection loops vec3.h used to draw its disk and ball points with, kept
+// here as the distributions the warps in Warps.h have to match
+vec3 rejectionInUnitBall(Rng& pRng)
+{
+	while (true)
+	{
+		const vec3 p = vec3::random(pRng, -1, 1);
+		if (p.lengthSquared() < 1)
+			return p;
+	}
+}
+
+vec3 rejectionInUnitDisk(Rng& pRng)
+{
+	while (true)
+	{
+		const Real x = randomDouble(pRng, -1, 1);
+		const vec3 p(x, randomDouble(pRng, -1, 1), 0);
+		if (p.lengthSquared() < 1)
+			return p;
+	}
+}
+
+// which of pCount equal turns around z a point is in
+int sectorOf(const vec3& pPoint, int pCount)
+{
+	const double turn = (atan2(pPoint.y(), pPoint.x()) + kPi) / (2 * kPi);
+	return min(static_cast<int>(turn * pCount), pCount - 1);
+}
+
+// 64 cells of equal area or volume for each shape, so every cell expects the
+// same count: rings of equal area by sectors for the disk, bands of equal
+// height by sectors for the sphere, and shells of equal volume by bands by
+// sectors for the ball
+int diskCell(const vec3& pPoint)
+{
+	return min(static_cast<int>(pPoint.lengthSquared() * 8), 7) * 8 + sectorOf(pPoint, 8);
+}
+
+int sphereCell(const vec3& pPoint)
+{
+	return min(static_cast<int>((pPoint.z() + 1) * 4), 7) * 8 + sectorOf(pPoint, 8);
+}
+
+int ballCell(const vec3& pPoint)
+{
+	const Real r = pPoint.length();
+	const int shell = min(static_cast<int>(r * r * r * 4), 3);
+	const int band = r > 0 ? min(static_cast<int>((pPoint.z() / r + 1) * 2), 3) : 0;
+	return (shell * 4 + band) * 4 + sectorOf(pPoint, 4);
+}
+
+// pearson's two sample chi-square over histograms of equally many points. for
+// two samples of one distribution it averages the number of cells less one,
+// give or take the square root of twice that
+double chiSquare(const vector<uint64_t>& pA, const vector<uint64_t>& pB)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < pA.size(); ++i)
+	{
+		const double a = static_cast<double>(pA[i]);
+		const double b = static_cast<double>(pB[i]);
+		if (a + b > 0)
+			sum += (a - b) * (a - b) / (a + b);
+	}
+	return sum;
+}
+
+// -----------------------------------------------------------------------------
+
+// the closed form warps against the rejection loops they replaced. first that
+// they draw the same shapes: the chi-square between a million points of each
+// over 64 equal cells, which is about 63 give or take 11 when they agree, and
+// a second moment (r^2 is 1/2 over the disk and 3/5 over the ball, z^2 is 1/3
+// on the sphere). then that the batched warps give the same bits as the scalar
+// ones, and last how many points each way makes per nanosecond, random numbers
+// included. the batched warps draw their numbers into arrays first
+void benchmarkWarps(ostream& pOut)
+{
+	const int kPoints = 1000000;
+	const int kCells = 64;
+	const size_t kBatch = 1024;
+
+	struct Shape
+	{
+		const char* mName;
+		vec3 (*mRejection)(Rng&);
+		vec3 (*mWarp)(Rng&);
+		int (*mCell)(const vec3&);
+		Real (*mMoment)(const vec3&);
+	};
+	const Shape shapes[] = {
+		{ "disk", rejectionInUnitDisk, randomInUnitDisk, diskCell,
+			[](const vec3& p) { return p.lengthSquared(); } },
+		{ "sphere", [](Rng& pRng) { return unitVector(rejectionInUnitBall(pRng)); }, randomUnitVector, sphereCell,
+			[](const vec3& p) { return p.z() * p.z(); } },
+		{ "ball", rejectionInUnitBall, randomInUnitSphere, ballCell,
+			[](const vec3& p) { return p.lengthSquared(); } },
+	};
+
+	pOut << "shape     chi-square   moment(rejection)   moment(warp)\n";
+	for (const Shape& shape : shapes)
+	{
+		Rng rejectionRng(1), warpRng(2);
+		vector<uint64_t> rejection(kCells, 0), warp(kCells, 0);
+		double rejectionMoment = 0.0, warpMoment = 0.0;
+		for (int i = 0; i < kPoints; ++i)
+		{
+			const vec3 a = shape.mRejection(rejectionRng);
+			const vec3 b = shape.mWarp(warpRng);
+			rejection[shape.mCell(a)]++;
+			warp[shape.mCell(b)]++;
+			rejectionMoment += shape.mMoment(a);
+			warpMoment += shape.mMoment(b);
+		}
+		pOut << left << setw(10) << shape.mName << right
+			<< setw(10) << fixed << setprecision(1) << chiSquare(rejection, warp)
+			<< setw(20) << setprecision(5) << rejectionMoment / kPoints
+			<< setw(15) << warpMoment / kPoints << '\n';
+	}
+
+	// every lane of a batch against the same numbers one at a time
+	Rng rng(3);
+	vector<Real> u(kBatch), v(kBatch), w(kBatch), x(kBatch), y(kBatch), z(kBatch);
+	auto fill = [&](vector<Real>& pValues)
+	{
+		for (Real& value : pValues)
+			value = static_cast<Real>(randomDouble(rng));
+	};
+	auto differs = [](const vec3& pA, Real pX, Real pY, Real pZ)
+	{
+		return pA.x() != pX || pA.y() != pY || pA.z() != pZ;
+	};
+
+	size_t mismatches = 0;
+	for (int round = 0; round < kPoints / static_cast<int>(kBatch); ++round)
+	{
+		fill(u);
+		fill(v);
+		fill(w);
+		warpUnitDisks(u.data(), v.data(), x.data(), y.data(), kBatch);
+		for (size_t i = 0; i < kBatch; ++i)
+			mismatches += differs(squareToUnitDisk(u[i], v[i]), x[i], y[i], 0);
+		warpUnitSpheres(u.data(), v.data(), x.data(), y.data(), z.data(), kBatch);
+		for (size_t i = 0; i < kBatch; ++i)
+			mismatches += differs(squareToUnitSphere(u[i], v[i]), x[i], y[i], z[i]);
+		warpUnitBalls(u.data(), v.data(), w.data(), x.data(), y.data(), z.data(), kBatch);
+		for (size_t i = 0; i < kBatch; ++i)
+			mismatches += differs(cubeToUnitBall(u[i], v[i], w[i]), x[i], y[i], z[i]);
+	}
+	pOut << "\nbatched points that differ from one at a time: " << mismatches << " (" << simdName() << ")\n";
+
+	// a whole batch is one op to runMicro, its time is split over the points
+	const double kMinSeconds = 0.5;
+	auto batched = [&](const Shape& pShape)
+	{
+		return runMicro(pShape.mName, 1, kMinSeconds, [&](size_t)
+		{
+			fill(u);
+			fill(v);
+			if (pShape.mCell == diskCell)
+				warpUnitDisks(u.data(), v.data(), x.data(), y.data(), kBatch);
+			else if (pShape.mCell == sphereCell)
+				warpUnitSpheres(u.data(), v.data(), x.data(), y.data(), z.data(), kBatch);
+			else
+			{
+				fill(w);
+				warpUnitBalls(u.data(), v.data(), w.data(), x.data(), y.data(), z.data(), kBatch);
+			}
+			return x[0];
+		});
+	};
+
+	pOut << "\npoints per ns  rejection  closed form    batched\n";
+	for (const Shape& shape : shapes)
+	{
+		const MicroResult rejection = runMicro(shape.mName, kBatch, kMinSeconds, [&](size_t)
+		{
+			return shape.mRejection(rng).x();
+		});
+		const MicroResult warp = runMicro(shape.mName, kBatch, kMinSeconds, [&](size_t)
+		{
+			return shape.mWarp(rng).x();
+		});
+		const MicroResult batch = batched(shape);
+
+		pOut << left << setw(12) << shape.mName << right << fixed << setprecision(4)
+			<< setw(12) << 1.0 / rejection.mNsPerOp
+			<< setw(13) << 1.0 / warp.mNsPerOp
+			<< setw(11) << kBatch / batch.mNsPerOp << '\n';
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+struct FrameResult
+{
+	unsigned int mThreads;
+	double mSeconds;
+	uint64_t mRays;
+	uint64_t mSamples;
+};
+
+// the thread counts the frame benchmark steps through, doubling from one and
+// always finishing on pMaxThreads
+vector<unsigned int> benchmarkThreadCounts(unsigned int pMaxThreads)
+{
+	vector<unsigned int> counts;
+	for (unsigned int n = 1; n < pMaxThreads; n *= 2)
+		counts.push_back(n);
+	counts.push_back(pMaxThreads);
+	return counts;
+}
+
+// a whole frame of randomScene() through renderFrame for each thread count.
+// every ray of every path is counted, so mRays over mSeconds is the rate the
+// renderer really traces at with shading and scheduling included. pOnRun (if
+// set) hears about each run as soon as it's done
+vector<FrameResult> runFrameBenchmark(const RenderSettings& pSettings, const vector<unsigned int>& pThreadCounts,
+	const function<void(const FrameResult&)>& pOnRun = nullptr)
+{
+	MaterialTable materials;
+	const HittableList world = benchmarkScene(materials);
+	CompiledScene scene(world, materials);
+	Camera camera(point3(13, 2, 3), point3(0, 0, 0), vec3(0, 1, 0), 20, 16.0 / 9.0, 0.1, 10.0);
+
+	vector<FrameResult> results;
+	RenderSettings settings = pSettings;
+	for (unsigned int threads : pThreadCounts)
+	{
+		settings.mThreads = threads;
+		PathStats pathStats;
+		Stopwatch timer;
+		renderFrame(settings, camera, scene, scene.materials(), nullptr, &pathStats);
+		results.push_back({ threads, timer.elapsed(), pathStats.mSegments.load(), pathStats.mPaths.load() });
+		if (pOnRun)
+			pOnRun(results.back());
+	}
+	return results;
+}
+
+// -----------------------------------------------------------------------------
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !BENCHMARKS_H_
\ No newline at end of file
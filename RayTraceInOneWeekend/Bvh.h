@@ -0,0 +1,574 @@
+// -----------------------------------------------------------------------------
+#ifndef BVH_H_
+#define BVH_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "AABB.h"
+#include "Hittable.h"
+#include "HittableList.h"
+#include "Sphere.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a node of a flattened bvh. leaves have a non-zero mCount and cover the
+// primitives [mLeftOrFirst, mLeftOrFirst + mCount). interior nodes store the
+// index of their left child, and the right child always sits right after it.
+// children are always allocated after their parent so walking the array
+// backwards visits every child before its parent
+struct BvhNode
+{
+	// ---- methods
+	bool isLeaf() const { return mCount > 0; }
+
+	// ---- members
+	AABB mBox;
+	uint32_t mLeftOrFirst = 0;
+	uint32_t mCount = 0;
+};
+
+// deep enough for any tree the builder makes, it stops splitting long before
+const int kBvhStackSize = 64;
+
+// -----------------------------------------------------------------------------
+
+// builds a bvh over a set of primitive bounds using a binned surface area
+// heuristic. it only knows about boxes, so anything that can produce an AABB
+// per primitive can share it. pIndices comes back as the order the leaves
+// refer to, callers reorder their primitives to match
+class BvhBuilder
+{
+public:
+	// ---- constructors
+	BvhBuilder(const vector<AABB>& pBoxes, uint32_t pMaxLeafSize = 4, Real pIntersectCost = 1.0)
+		: mBoxes(pBoxes)
+		, mMaxLeafSize(pMaxLeafSize)
+		, mIntersectCost(pIntersectCost)
+	{}
+
+	// ---- methods
+	void build(vector<BvhNode>& pNodes, vector<uint32_t>& pIndices)
+	{
+		const uint32_t count = static_cast<uint32_t>(mBoxes.size());
+
+		pIndices.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+			pIndices[i] = i;
+
+		mCentroids.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+			mCentroids[i] = mBoxes[i].centroid();
+
+		pNodes.clear();
+		if (count == 0)
+			return;
+
+		pNodes.reserve(2 * count - 1);
+		pNodes.push_back(BvhNode());
+		pNodes[0].mLeftOrFirst = 0;
+		pNodes[0].mCount = count;
+		subdivide(pNodes, pIndices, 0, 0);
+	}
+
+	// ---- members
+	static const int kNumBins = 16;
+	static const int kMaxDepth = 48;
+
+private:
+	struct Bin
+	{
+		AABB mBox;
+		uint32_t mCount = 0;
+	};
+
+	void subdivide(vector<BvhNode>& pNodes, vector<uint32_t>& pIndices, uint32_t pNode, int pDepth)
+	{
+		const uint32_t first = pNodes[pNode].mLeftOrFirst;
+		const uint32_t count = pNodes[pNode].mCount;
+
+		AABB bounds, centroidBounds;
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			bounds.grow(mBoxes[pIndices[i]]);
+			centroidBounds.grow(mCentroids[pIndices[i]]);
+		}
+		pNodes[pNode].mBox = bounds;
+
+		if (count <= 1 || pDepth >= kMaxDepth)
+			return;
+
+		// find the cheapest split plane over all three axes
+		int bestAxis = -1;
+		int bestSplit = 0;
+		Real bestCost = gInfinity;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const Real lo = centroidBounds.mMin[axis];
+			const Real hi = centroidBounds.mMax[axis];
+			if (hi <= lo)
+				continue;
+
+			Bin bins[kNumBins];
+			const Real scale = kNumBins / (hi - lo);
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				const int b = binIndex(mCentroids[pIndices[i]][axis], lo, scale);
+				bins[b].mCount++;
+				bins[b].mBox.grow(mBoxes[pIndices[i]]);
+			}
+
+			// sweep from both ends so each plane is costed in O(1)
+			Real leftArea[kNumBins - 1], rightArea[kNumBins - 1];
+			uint32_t leftCount[kNumBins - 1], rightCount[kNumBins - 1];
+			AABB leftBox, rightBox;
+			uint32_t leftSum = 0, rightSum = 0;
+			for (int i = 0; i < kNumBins - 1; ++i)
+			{
+				leftSum += bins[i].mCount;
+				leftBox.grow(bins[i].mBox);
+				leftCount[i] = leftSum;
+				leftArea[i] = leftBox.surfaceArea();
+
+				rightSum += bins[kNumBins - 1 - i].mCount;
+				rightBox.grow(bins[kNumBins - 1 - i].mBox);
+				rightCount[kNumBins - 2 - i] = rightSum;
+				rightArea[kNumBins - 2 - i] = rightBox.surfaceArea();
+			}
+
+			for (int i = 0; i < kNumBins - 1; ++i)
+			{
+				if (leftCount[i] == 0 || rightCount[i] == 0)
+					continue;
+
+				const Real cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+				}
+			}
+		}
+
+		// all centroids coincide, nothing left to separate
+		if (bestAxis < 0)
+			return;
+
+		// stop when intersecting everything here is cheaper than splitting.
+		// costs are relative to one traversal step
+		const Real parentArea = bounds.surfaceArea();
+		const Real splitCost = 1.0 + mIntersectCost * bestCost / parentArea;
+		if (count <= mMaxLeafSize && splitCost >= mIntersectCost * count)
+			return;
+
+		// partition the indices in place around the chosen plane
+		const Real lo = centroidBounds.mMin[bestAxis];
+		const Real scale = kNumBins / (centroidBounds.mMax[bestAxis] - lo);
+		auto begin = pIndices.begin() + first;
+		auto middle = std::partition(begin, begin + count, [&](uint32_t pIndex)
+		{
+			return binIndex(mCentroids[pIndex][bestAxis], lo, scale) <= bestSplit;
+		});
+		const uint32_t i = first + static_cast<uint32_t>(middle - begin);
+
+		const uint32_t leftCount = i - first;
+		if (leftCount == 0 || leftCount == count)
+			return;
+
+		const uint32_t left = static_cast<uint32_t>(pNodes.size());
+		pNodes.push_back(BvhNode());
+		pNodes.push_back(BvhNode());
+		pNodes[left].mLeftOrFirst = first;
+		pNodes[left].mCount = leftCount;
+		pNodes[left + 1].mLeftOrFirst = i;
+		pNodes[left + 1].mCount = count - leftCount;
+		pNodes[pNode].mLeftOrFirst = left;
+		pNodes[pNode].mCount = 0;
+
+		subdivide(pNodes, pIndices, left, pDepth + 1);
+		subdivide(pNodes, pIndices, left + 1, pDepth + 1);
+	}
+
+	static int binIndex(Real pValue, Real pLo, Real pScale)
+	{
+		const int b = static_cast<int>((pValue - pLo) * pScale);
+		return b < 0 ? 0 : (b >= kNumBins ? kNumBins - 1 : b);
+	}
+
+	// ---- members
+	const vector<AABB>& mBoxes;
+	vector<point3> mCentroids;
+	uint32_t mMaxLeafSize;
+	Real mIntersectCost;
+};
+
+// -----------------------------------------------------------------------------
+
+// walks a flattened bvh front to back for the closest hit. the tree doesn't
+// know what its primitives are, pLeaf(first, count, closestSoFar) tests the
+// ones in a leaf and returns true if any of them got closer. it has to update
+// closestSoFar itself
+template<typename TLeaf>
+bool traverseBvh(const BvhNode* pNodes, const Ray& pRay, Real pMinT, Real pMaxT, TLeaf&& pLeaf)
+{
+	const vec3 invDir(1.0 / pRay.mDir.x(), 1.0 / pRay.mDir.y(), 1.0 / pRay.mDir.z());
+	Real tEnter;
+	if (!pNodes[0].mBox.hit(pRay.mOrig, invDir, pMinT, pMaxT, tEnter))
+		return false;
+
+	uint32_t stack[kBvhStackSize];
+	int stackSize = 0;
+	uint32_t current = 0;
+
+	bool hitAnything = false;
+	auto closestSoFar = pMaxT;
+
+	while (true)
+	{
+		const BvhNode& node = pNodes[current];
+
+		if (node.isLeaf())
+		{
+			if (pLeaf(node.mLeftOrFirst, node.mCount, closestSoFar))
+				hitAnything = true;
+		}
+		else
+		{
+			// visit the nearer child first so closestSoFar shrinks sooner
+			const uint32_t left = node.mLeftOrFirst;
+			Real tLeft, tRight;
+			const bool hitLeft = pNodes[left].mBox.hit(pRay.mOrig, invDir, pMinT, closestSoFar, tLeft);
+			const bool hitRight = pNodes[left + 1].mBox.hit(pRay.mOrig, invDir, pMinT, closestSoFar, tRight);
+
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = tLeft <= tRight;
+				stack[stackSize++] = leftFirst ? left + 1 : left;
+				current = leftFirst ? left : left + 1;
+				continue;
+			}
+			if (hitLeft || hitRight)
+			{
+				current = hitLeft ? left : left + 1;
+				continue;
+			}
+		}
+
+		// pop the next node that could still hold something closer
+		bool found = false;
+		while (stackSize > 0)
+		{
+			current = stack[--stackSize];
+			if (pNodes[current].mBox.hit(pRay.mOrig, invDir, pMinT, closestSoFar, tEnter))
+			{
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			break;
+	}
+
+	return hitAnything;
+}
+
+// -----------------------------------------------------------------------------
+
+// the shadow ray's walk: is anything in the tree in the way at all. the first
+// leaf that says so ends it, and with no closest hit to shrink there's no
+// point sorting the children either. pLeaf(first, count) returns whether any
+// of the primitives in a leaf block the ray
+template<typename TLeaf>
+bool anyHitBvh(const BvhNode* pNodes, const Ray& pRay, Real pMinT, Real pMaxT, TLeaf&& pLeaf)
+{
+	const vec3 invDir(1.0 / pRay.mDir.x(), 1.0 / pRay.mDir.y(), 1.0 / pRay.mDir.z());
+	uint32_t stack[kBvhStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const BvhNode& node = pNodes[stack[--stackSize]];
+		Real tEnter;
+		if (!node.mBox.hit(pRay.mOrig, invDir, pMinT, pMaxT, tEnter))
+			continue;
+
+		if (node.isLeaf())
+		{
+			if (pLeaf(node.mLeftOrFirst, node.mCount))
+				return true;
+			continue;
+		}
+
+		stack[stackSize++] = node.mLeftOrFirst + 1;
+		stack[stackSize++] = node.mLeftOrFirst;
+	}
+
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+// the whole packet walks the tree together. at every node the lanes that miss
+// its box (or already have something closer) drop out for that subtree, and
+// the subtree is skipped once no lanes are left. pLeaf(first, count, lanes)
+// returns the lanes whose record it wrote
+template<typename TLeaf>
+int traverseBvhPacket(const BvhNode* pNodes, const RayPacket& pPacket, int pActiveMask, Real pMinT,
+	Real* pMaxT, TLeaf&& pLeaf)
+{
+	// each stack entry remembers which lanes were still alive in its parent
+	uint32_t stack[kBvhStackSize];
+	int stackLanes[kBvhStackSize];
+	int stackSize = 0;
+	stack[stackSize] = 0;
+	stackLanes[stackSize++] = pActiveMask;
+	int result = 0;
+
+	while (stackSize > 0)
+	{
+		--stackSize;
+		const BvhNode& node = pNodes[stack[stackSize]];
+		const int lanes = hitBoxPacket(node.mBox, pPacket, stackLanes[stackSize], pMinT, pMaxT);
+		if (lanes == 0)
+			continue;
+
+		if (node.isLeaf())
+		{
+			result |= pLeaf(node.mLeftOrFirst, node.mCount, lanes);
+			continue;
+		}
+
+		// coherent rays agree on direction, so the first live lane decides which
+		// child is nearer along the axis that separates them most
+		int lead = 0;
+		while (!(lanes & (1 << lead)))
+			++lead;
+
+		const uint32_t left = node.mLeftOrFirst;
+		const vec3 gap = pNodes[left + 1].mBox.centroid() - pNodes[left].mBox.centroid();
+		const int axis = (fabs(gap.x()) > fabs(gap.y()))
+			? (fabs(gap.x()) > fabs(gap.z()) ? 0 : 2)
+			: (fabs(gap.y()) > fabs(gap.z()) ? 1 : 2);
+		const Real direction = axis == 0 ? pPacket.mDirX[lead] : (axis == 1 ? pPacket.mDirY[lead] : pPacket.mDirZ[lead]);
+		const bool leftFirst = gap[axis] * direction >= 0.0;
+
+		stack[stackSize] = leftFirst ? left + 1 : left;
+		stackLanes[stackSize++] = lanes;
+		stack[stackSize] = leftFirst ? left : left + 1;
+		stackLanes[stackSize++] = lanes;
+	}
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+
+// what a leaf entry refers to. spheres are copied into the bvh itself and hit
+// without a virtual call, anything else is kept by pointer
+struct BvhPrimitive
+{
+	HittableType mType;
+	uint32_t mIndex;
+};
+
+// -----------------------------------------------------------------------------
+
+class Bvh : public Hittable
+{
+public:
+	// ---- constructors
+	Bvh() {}
+	Bvh(const HittableList& pList) : Bvh(pList.mvObjects) {}
+	Bvh(const vector<shared_ptr<Hittable>>& pObjects) { build(pObjects); }
+
+	// ---- overrides
+	virtual bool hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const override;
+	virtual bool boundingBox(AABB& pOutputBox) const override;
+	virtual int hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+		HitRecord* pRecords) const override;
+	virtual bool occluded(const Ray& pRay, Real pMinT, Real pMaxT) const override;
+
+	// ---- methods
+	void build(const vector<shared_ptr<Hittable>>& pObjects);
+
+	// ---- members
+	vector<BvhNode> mvNodes;
+	vector<BvhPrimitive> mvPrimitives;
+	vector<Sphere> mvSpheres;
+	vector<shared_ptr<Hittable>> mvObjects;
+
+	// objects without bounds, like planes, can't be binned so they stay out
+	// of the tree and every ray tests them
+	HittableList mUnbounded;
+};
+
+// -----------------------------------------------------------------------------
+
+void Bvh::build(const vector<shared_ptr<Hittable>>& pObjects)
+{
+	vector<shared_ptr<Hittable>> bounded;
+	vector<AABB> boxes;
+	mUnbounded.clear();
+	for (const auto& object : pObjects)
+	{
+		AABB box;
+		if (object->boundingBox(box) && !box.isEmpty())
+		{
+			bounded.push_back(object);
+			boxes.push_back(box);
+		}
+		else
+		{
+			mUnbounded.add(object);
+		}
+	}
+
+	vector<uint32_t> indices;
+	BvhBuilder(boxes).build(mvNodes, indices);
+
+	// in leaf order, so the spheres a leaf tests sit next to each other
+	mvPrimitives.clear();
+	mvSpheres.clear();
+	mvObjects.clear();
+	mvPrimitives.reserve(indices.size());
+	for (uint32_t index : indices)
+	{
+		const shared_ptr<Hittable>& object = bounded[index];
+		if (object->mType == HittableType::Sphere)
+		{
+			mvPrimitives.push_back({ HittableType::Sphere, static_cast<uint32_t>(mvSpheres.size()) });
+			mvSpheres.push_back(static_cast<const Sphere&>(*object));
+		}
+		else
+		{
+			mvPrimitives.push_back({ HittableType::Other, static_cast<uint32_t>(mvObjects.size()) });
+			mvObjects.push_back(object);
+		}
+	}
+
+	if (!mUnbounded.mvObjects.empty())
+		cerr << "Bvh: " << mUnbounded.mvObjects.size() << " objects have no bounding box, every ray tests them\n";
+}
+
+// -----------------------------------------------------------------------------
+
+bool Bvh::hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const
+{
+	bool hitAnything = false;
+	Real closest = pMaxT;
+	if (!mUnbounded.mvObjects.empty() && mUnbounded.hit(pRay, pMinT, closest, pRecord))
+	{
+		hitAnything = true;
+		closest = pRecord.mTrace;
+	}
+
+	if (mvNodes.empty())
+		return hitAnything;
+
+	// primitives only write the record when they report a hit
+	if (traverseBvh(mvNodes.data(), pRay, pMinT, closest, [&](uint32_t pFirst, uint32_t pCount, Real& pClosestSoFar)
+	{
+		bool hitLeaf = false;
+		for (uint32_t i = pFirst; i < pFirst + pCount; ++i)
+		{
+			const BvhPrimitive& primitive = mvPrimitives[i];
+			const bool hitPrimitive = primitive.mType == HittableType::Sphere
+				? mvSpheres[primitive.mIndex].Sphere::hit(pRay, pMinT, pClosestSoFar, pRecord)
+				: mvObjects[primitive.mIndex]->hit(pRay, pMinT, pClosestSoFar, pRecord);
+
+			if (hitPrimitive)
+			{
+				hitLeaf = true;
+				pClosestSoFar = pRecord.mTrace;
+			}
+		}
+		return hitLeaf;
+	}))
+		hitAnything = true;
+
+	return hitAnything;
+}
+
+// -----------------------------------------------------------------------------
+
+int Bvh::hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+	HitRecord* pRecords) const
+{
+	if (pActiveMask == 0)
+		return 0;
+
+	// pMaxT shrinks for the lanes the unbounded objects hit, so the tree only
+	// writes the records it beats
+	int result = 0;
+	if (!mUnbounded.mvObjects.empty())
+		result = mUnbounded.hitPacket(pPacket, pActiveMask, pMinT, pMaxT, pRecords);
+
+	if (mvNodes.empty())
+		return result;
+
+	return result | traverseBvhPacket(mvNodes.data(), pPacket, pActiveMask, pMinT, pMaxT, [&](uint32_t pFirst, uint32_t pCount, int pLanes)
+	{
+		int result = 0;
+		for (uint32_t i = pFirst; i < pFirst + pCount; ++i)
+		{
+			const BvhPrimitive& primitive = mvPrimitives[i];
+			result |= primitive.mType == HittableType::Sphere
+				? mvSpheres[primitive.mIndex].Sphere::hitPacket(pPacket, pLanes, pMinT, pMaxT, pRecords)
+				: mvObjects[primitive.mIndex]->hitPacket(pPacket, pLanes, pMinT, pMaxT, pRecords);
+		}
+		return result;
+	});
+}
+
+// -----------------------------------------------------------------------------
+
+bool Bvh::occluded(const Ray& pRay, Real pMinT, Real pMaxT) const
+{
+	if (!mUnbounded.mvObjects.empty() && mUnbounded.occluded(pRay, pMinT, pMaxT))
+		return true;
+
+	if (mvNodes.empty())
+		return false;
+
+	return anyHitBvh(mvNodes.data(), pRay, pMinT, pMaxT, [&](uint32_t pFirst, uint32_t pCount)
+	{
+		for (uint32_t i = pFirst; i < pFirst + pCount; ++i)
+		{
+			const BvhPrimitive& primitive = mvPrimitives[i];
+			const bool blocked = primitive.mType == HittableType::Sphere
+				? mvSpheres[primitive.mIndex].Sphere::occluded(pRay, pMinT, pMaxT)
+				: mvObjects[primitive.mIndex]->occluded(pRay, pMinT, pMaxT);
+
+			if (blocked)
+				return true;
+		}
+		return false;
+	});
+}
+
+// -----------------------------------------------------------------------------
+
+bool Bvh::boundingBox(AABB& pOutputBox) const
+{
+	if (mvNodes.empty() || !mUnbounded.mvObjects.empty())
+		return false;
+
+	pOutputBox = mvNodes[0].mBox;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !BVH_H_
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 //--INCLUDES--//
 #include "rtweekend.h"
+#include "Sampler.h"
 
 // -----------------------------------------------------------------------------
 
@@ -16,10 +17,10 @@ public:
 		point3 pLookFrom, 
 		point3 pLookAt, 
 		vec3 pUp, 
-		double pVerticalFOV, 
-		double pAspectRatio,
-		double pAperture,
-		double pFocusDistance)
+		Real pVerticalFOV, 
+		Real pAspectRatio,
+		Real pAperture,
+		Real pFocusDistance)
 	{
 		auto theta = deg2rad(pVerticalFOV);
 		auto h = tan(theta / 2);
@@ -41,9 +42,9 @@ public:
 	// ---- overrides
 
 	// ---- methods
-	Ray getRay(double pS, double pT) const
+	Ray getRay(Real pS, Real pT, Sampler& pSampler) const
 	{
-		vec3 rd = mLensRadius * randomInUnitDisk();
+		vec3 rd = mLensRadius * pSampler.inUnitDisk();
 		vec3 offset = mU * rd.x() + mV * rd.y();
 
 		return Ray(mOrigin + offset, 
@@ -57,7 +58,7 @@ private:
 	vec3 mHorizontal;
 	vec3 mVertical;
 	vec3 mU, mV, mW;
-	double mLensRadius;
+	Real mLensRadius;
 };
 
 // -----------------------------------------------------------------------------
@@ -0,0 +1,206 @@
+// -----------------------------------------------------------------------------
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "colour.h"
+#include "Framebuffer.h"
+#include "RenderSettings.h"
+#include "rtweekend.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a progressive render between two passes, written as this header and then the
+// summed pixels as FramePixels row by row, bottom up like the render. rows and
+// not the framebuffer's tiles, so a checkpoint doesn't care about --tile-size
+// or --tile-order. there's no random number state to keep: every sample's
+// generator is seeded from the pixel and the sample index, so how many samples
+// are done is all a resumed run needs. the rest is everything that changes
+// what those samples add up to, so a run with different settings can't carry
+// on from it by mistake
+struct CheckpointHeader
+{
+	char mMagic[8];
+	uint32_t mVersion;
+	uint32_t mRealSize;
+	uint32_t mPixelSize;
+	uint32_t mByteOrder;
+	int32_t mWidth;
+	int32_t mHeight;
+	int32_t mFirstSample;
+	int32_t mSamplesDone;
+	int32_t mMaxDepth;
+	int32_t mRoulette;
+	int32_t mRouletteMinBounces;
+	int32_t mAdaptive;
+	int32_t mMinSamples;
+	int32_t mSampler;
+	int32_t mLightSampling;
+	double mRouletteThreshold;
+	double mAdaptiveThreshold;
+	uint64_t mSeed;
+	uint64_t mSceneFingerprint;
+};
+
+const char kCheckpointMagic[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '\0', '\0' };
+const uint32_t kCheckpointVersion = 4;
+const uint32_t kCheckpointByteOrder = 0x01020304;
+
+// -----------------------------------------------------------------------------
+
+CheckpointHeader makeCheckpointHeader(const RenderSettings& pSettings, uint64_t pSceneFingerprint, int pSamplesDone)
+{
+	static_assert(is_trivially_copyable<CheckpointHeader>::value, "CheckpointHeader is written as raw bytes");
+
+	CheckpointHeader header;
+	memset(static_cast<void*>(&header), 0, sizeof(header));
+	memcpy(header.mMagic, kCheckpointMagic, sizeof(kCheckpointMagic));
+	header.mVersion = kCheckpointVersion;
+	header.mRealSize = sizeof(Real);
+	header.mPixelSize = sizeof(FramePixel);
+	header.mByteOrder = kCheckpointByteOrder;
+	header.mWidth = pSettings.mImageWidth;
+	header.mHeight = pSettings.mImageHeight;
+	header.mFirstSample = pSettings.mFirstSample;
+	header.mSamplesDone = pSamplesDone;
+	header.mMaxDepth = pSettings.mMaxDepth;
+	header.mRoulette = pSettings.mRussianRoulette;
+	header.mRouletteMinBounces = pSettings.mRouletteMinBounces;
+	header.mAdaptive = pSettings.mAdaptive;
+	header.mMinSamples = pSettings.mMinSamples;
+	header.mSampler = static_cast<int32_t>(pSettings.mSampler);
+	header.mLightSampling = pSettings.mLightSampling;
+	header.mRouletteThreshold = pSettings.mRouletteThreshold;
+	header.mAdaptiveThreshold = pSettings.mAdaptiveThreshold;
+	header.mSeed = pSettings.mSeed;
+	header.mSceneFingerprint = pSceneFingerprint;
+	return header;
+}
+
+// -----------------------------------------------------------------------------
+
+// the checkpoint goes to a temporary file first and then replaces the old one,
+// so a crash halfway through writing still leaves the last good checkpoint
+bool saveCheckpoint(
+	const string& pPath,
+	const RenderSettings& pSettings,
+	uint64_t pSceneFingerprint,
+	int pSamplesDone,
+	const Framebuffer& pPixels,
+	string& pError)
+{
+	const CheckpointHeader header = makeCheckpointHeader(pSettings, pSceneFingerprint, pSamplesDone);
+	const string temporary = pPath + ".tmp";
+	{
+		ofstream file(temporary, ios::binary);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		vector<FramePixel> row(pPixels.width());
+		for (int j = 0; j < pPixels.height(); ++j)
+		{
+			for (int i = 0; i < pPixels.width(); ++i)
+				row[i] = pPixels.at(i, j);
+			file.write(reinterpret_cast<const char*>(row.data()), static_cast<streamsize>(row.size() * sizeof(FramePixel)));
+		}
+		file.flush();
+		if (!file)
+		{
+			pError = "couldn't write " + temporary;
+			return false;
+		}
+	}
+
+#if defined(_WIN32)
+	const bool replaced = MoveFileExA(temporary.c_str(), pPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	const bool replaced = rename(temporary.c_str(), pPath.c_str()) == 0;
+#endif
+	if (!replaced)
+	{
+		pError = "couldn't replace " + pPath + " with " + temporary;
+		return false;
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// reads a checkpoint back for a run with pSettings. mSamplesPerPixel is the only
+// setting allowed to differ, a finished render can be given more samples
+bool loadCheckpoint(
+	const string& pPath,
+	const RenderSettings& pSettings,
+	uint64_t pSceneFingerprint,
+	int& pSamplesDone,
+	Framebuffer& pPixels,
+	string& pError)
+{
+	ifstream file(pPath, ios::binary);
+	if (!file)
+	{
+		pError = "couldn't open " + pPath;
+		return false;
+	}
+
+	CheckpointHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| memcmp(header.mMagic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0)
+	{
+		pError = pPath + " isn't a checkpoint";
+		return false;
+	}
+
+	const CheckpointHeader expected = makeCheckpointHeader(pSettings, pSceneFingerprint, header.mSamplesDone);
+	if (header.mVersion != kCheckpointVersion || header.mByteOrder != kCheckpointByteOrder)
+		pError = pPath + " was written by a different version or on a different machine";
+	else if (header.mRealSize != expected.mRealSize || header.mPixelSize != expected.mPixelSize)
+		pError = pPath + " was written by a build with a different precision";
+	else if (header.mWidth != expected.mWidth || header.mHeight != expected.mHeight)
+		pError = pPath + " is " + to_string(header.mWidth) + "x" + to_string(header.mHeight) + ", not "
+			+ to_string(expected.mWidth) + "x" + to_string(expected.mHeight);
+	else if (header.mSceneFingerprint != expected.mSceneFingerprint)
+		pError = pPath + " is of a different scene or camera";
+	else if (memcmp(&header, &expected, sizeof(header)) != 0)
+		pError = pPath + " was rendered with a different seed, depth, roulette, adaptive, sampler or light sampling settings";
+	if (!pError.empty())
+		return false;
+
+	pPixels = Framebuffer(header.mWidth, header.mHeight, pSettings.mTileSize);
+	vector<FramePixel> row(header.mWidth);
+	for (int j = 0; j < header.mHeight; ++j)
+	{
+		if (!file.read(reinterpret_cast<char*>(row.data()), static_cast<streamsize>(row.size() * sizeof(FramePixel))))
+		{
+			pError = pPath + " is cut short";
+			return false;
+		}
+		for (int i = 0; i < header.mWidth; ++i)
+			pPixels.at(i, j) = row[i];
+	}
+
+	pSamplesDone = header.mSamplesDone;
+	pPixels.setAllTileSamples(pSamplesDone);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !CHECKPOINT_H_
\ No newline at end of file
@@ -0,0 +1,520 @@
+// -----------------------------------------------------------------------------
+#ifndef COMPILED_SCENE_H_
+#define COMPILED_SCENE_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "AABB.h"
+#include "Bvh.h"
+#include "Hittable.h"
+#include "HittableList.h"
+#include "Lights.h"
+#include "Material.h"
+#include "RenderStats.h"
+#include "Rng.h"
+#include "Span.h"
+#include "Sphere.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a sphere the way the compiled scene keeps it, only what the hit test and
+// the record need
+struct CompiledSphere
+{
+	point3 mCenter;
+	Real mRadius;
+	MaterialId mMaterialId;
+};
+
+inline AABB sphereBox(const CompiledSphere& pSphere)
+{
+	const Real r = fabs(pSphere.mRadius);
+	const vec3 extent(r, r, r);
+	return AABB(pSphere.mCenter - extent, pSphere.mCenter + extent);
+}
+
+// -----------------------------------------------------------------------------
+
+// what the spheres and materials say, hashed field by field so the padding
+// copied in with them never counts. it's worked out once when a scene is
+// compiled and saved with it, see sceneFingerprint()
+inline uint64_t hashSceneContents(Span<const CompiledSphere> pSpheres, Span<const Material> pMaterials)
+{
+	uint64_t hash = 0;
+	auto mix = [&](uint64_t pValue) { hash = mixBits(hash ^ pValue); };
+	auto mixReal = [&](Real pValue)
+	{
+		uint64_t bits = 0;
+		memcpy(&bits, &pValue, sizeof(pValue));
+		mix(bits);
+	};
+	auto mixPoint = [&](const vec3& pPoint)
+	{
+		for (int a = 0; a < 3; ++a)
+			mixReal(pPoint[a]);
+	};
+
+	mix(pSpheres.size());
+	for (const CompiledSphere& sphere : pSpheres)
+	{
+		mixPoint(sphere.mCenter);
+		mixReal(sphere.mRadius);
+		mix(sphere.mMaterialId);
+	}
+
+	mix(pMaterials.size());
+	for (const Material& material : pMaterials)
+	{
+		mix(static_cast<uint64_t>(material.mType));
+		mixPoint(material.mAlbedo);
+		mixReal(material.mFuzz);
+		mixReal(material.mIndexOfRefraction);
+	}
+	return hash;
+}
+
+// -----------------------------------------------------------------------------
+
+// where each section sits in the arena, in bytes from its start. nothing in
+// the arena points anywhere, so the whole block can be written out as it is
+// and mapped back in later
+struct CompiledSceneLayout
+{
+	uint64_t mNodeOffset = 0;
+	uint64_t mNodeCount = 0;
+	uint64_t mSphereOffset = 0;
+	uint64_t mSphereCount = 0;
+	uint64_t mMaterialOffset = 0;
+	uint64_t mMaterialCount = 0;
+	uint64_t mLightOffset = 0;
+	uint64_t mLightCount = 0;
+	uint64_t mSize = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+// a HittableList frozen for rendering. the bvh nodes, the spheres in leaf order,
+// the materials and the spheres that are lights are copied into one cache line
+// aligned block, which never
+// changes while a frame renders. every thread reads the same copy and nothing
+// in it is refcounted, so rendering does no atomic writes to the scene at all.
+// anything in the list that isn't a sphere is kept as it is and tested after
+// the tree. between frames an animation can move spheres and refit the boxes
+// above them instead of building everything again, see moveSphere()
+class CompiledScene : public Hittable
+{
+public:
+	// ---- constructors
+	CompiledScene(const HittableList& pWorld, Span<const Material> pMaterials);
+	CompiledScene(Span<const CompiledSphere> pSpheres, Span<const Material> pMaterials);
+
+	// a block that has already been laid out, like a mapped scene file. it isn't
+	// copied, so it has to stay put for as long as the scene is around.
+	// pContentHash is the hashSceneContents() it was saved with
+	CompiledScene(const CompiledSceneLayout& pLayout, const uint8_t* pArena, uint64_t pContentHash);
+
+	CompiledScene(const CompiledScene&) = delete;
+	CompiledScene& operator=(const CompiledScene&) = delete;
+
+	// ---- overrides
+	virtual bool hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const override;
+	virtual bool boundingBox(AABB& pOutputBox) const override;
+	virtual int hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+		HitRecord* pRecords) const override;
+	virtual bool occluded(const Ray& pRay, Real pMinT, Real pMaxT) const override;
+	virtual const LightList* lights() const override { return &mLights; }
+
+	// ---- methods
+	Span<const Material> materials() const { return mMaterials; }
+	const uint8_t* data() const { return mArena; }
+	size_t sizeInBytes() const { return static_cast<size_t>(mLayout.mSize); }
+
+	// hashSceneContents() of the scene as it was compiled. moving spheres
+	// afterwards doesn't change it
+	uint64_t contentHash() const { return mContentHash; }
+
+	// where a sphere ended up in mSpheres, by its place in the list or span the
+	// scene was made from. a laid out block is already in that order
+	uint32_t slotOf(uint32_t pIndex) const { return mvSlots.empty() ? pIndex : mvSlots[pIndex]; }
+
+	// animation. only a scene that owns its arena can be changed, a mapped one
+	// is read only. moved spheres' leaves are remembered and refit() regrows
+	// the boxes from them up to the root, stopping where a box doesn't change.
+	// it returns how many boxes did
+	bool isMovable() const { return mStorage != nullptr; }
+	void moveSphere(uint32_t pIndex, const point3& pCenter);
+	size_t refit();
+
+	// how much bigger the tree's boxes are than the builder made them, each
+	// box's surface area over its built one averaged over the tree. a refit tree
+	// only gets looser, and rays pay for it roughly in proportion. a plain sum
+	// of areas wouldn't do, the ground's box is so big nothing else would show
+	double refitGrowth() const { return mvBuiltAreas.empty() ? 1.0 : mGrowth / mvBuiltAreas.size(); }
+
+	// ---- members
+	CompiledSceneLayout mLayout;
+	Span<const BvhNode> mNodes;
+	Span<const CompiledSphere> mSpheres;
+	Span<const Material> mMaterials;
+	HittableList mOthers;
+
+	// over the arena's light section, every sphere with a DiffuseLight material
+	LightList mLights;
+
+private:
+	void compile(Span<const CompiledSphere> pSpheres, Span<const Material> pMaterials);
+	void bind(const uint8_t* pArena);
+	void prepareRefit();
+
+	// the arena is ours when mStorage is set, only the spans over it are const
+	uint8_t* ownedArena() { return mStorage.get() + (mArena - mStorage.get()); }
+
+	unique_ptr<uint8_t[]> mStorage;
+	const uint8_t* mArena = nullptr;
+	uint64_t mContentHash = 0;
+	vector<uint32_t> mvSlots;
+
+	// made the first time a sphere moves, a static scene never needs them
+	vector<uint32_t> mvParents;
+	vector<uint32_t> mvLeafOfSlot;
+	vector<uint32_t> mvDirtyLeaves;
+	vector<double> mvBuiltAreas;
+	double mGrowth = 0.0;
+};
+
+// -----------------------------------------------------------------------------
+
+CompiledScene::CompiledScene(const HittableList& pWorld, Span<const Material> pMaterials)
+{
+	vector<CompiledSphere> spheres;
+	for (const auto& object : pWorld.mvObjects)
+	{
+		if (object->mType == HittableType::Sphere)
+		{
+			const Sphere& sphere = static_cast<const Sphere&>(*object);
+			spheres.push_back({ sphere.mCenter, sphere.mRadius, sphere.mMaterialId });
+		}
+		else
+		{
+			mOthers.add(object);
+		}
+	}
+
+	compile(Span<const CompiledSphere>(spheres.data(), spheres.size()), pMaterials);
+}
+
+// -----------------------------------------------------------------------------
+
+CompiledScene::CompiledScene(Span<const CompiledSphere> pSpheres, Span<const Material> pMaterials)
+{
+	compile(pSpheres, pMaterials);
+}
+
+// -----------------------------------------------------------------------------
+
+CompiledScene::CompiledScene(const CompiledSceneLayout& pLayout, const uint8_t* pArena, uint64_t pContentHash)
+	: mLayout(pLayout)
+	, mContentHash(pContentHash)
+{
+	bind(pArena);
+}
+
+// -----------------------------------------------------------------------------
+
+void CompiledScene::compile(Span<const CompiledSphere> pSpheres, Span<const Material> pMaterials)
+{
+	// the sections are copied in as raw bytes
+	static_assert(is_trivially_copyable<BvhNode>::value, "BvhNode must be trivially copyable");
+	static_assert(is_trivially_copyable<CompiledSphere>::value, "CompiledSphere must be trivially copyable");
+	static_assert(is_trivially_copyable<Material>::value, "Material must be trivially copyable");
+	static_assert(is_trivially_copyable<SphereLight>::value, "SphereLight must be trivially copyable");
+
+	vector<BvhNode> nodes;
+	vector<uint32_t> indices;
+	if (!pSpheres.empty())
+	{
+		vector<AABB> boxes;
+		boxes.reserve(pSpheres.size());
+		for (const CompiledSphere& sphere : pSpheres)
+			boxes.push_back(sphereBox(sphere));
+		BvhBuilder(boxes).build(nodes, indices);
+	}
+
+	// found once here, so binding an arena (a mapped one too) never has to
+	// look through the spheres for them
+	vector<SphereLight> lights;
+	for (uint32_t slot = 0; slot < indices.size(); ++slot)
+	{
+		const CompiledSphere& sphere = pSpheres[indices[slot]];
+		if (sphere.mMaterialId < pMaterials.size() && pMaterials[sphere.mMaterialId].mType == MaterialType::DiffuseLight)
+			lights.push_back({ sphere.mCenter, fabs(sphere.mRadius), sphere.mMaterialId, slot });
+	}
+
+	mLayout.mNodeCount = nodes.size();
+	mLayout.mSphereCount = pSpheres.size();
+	mLayout.mMaterialCount = pMaterials.size();
+	mLayout.mLightCount = lights.size();
+	mLayout.mNodeOffset = 0;
+	mLayout.mSphereOffset = alignToCacheLine(mLayout.mNodeOffset + nodes.size() * sizeof(BvhNode));
+	mLayout.mMaterialOffset = alignToCacheLine(mLayout.mSphereOffset + pSpheres.size() * sizeof(CompiledSphere));
+	mLayout.mLightOffset = alignToCacheLine(mLayout.mMaterialOffset + pMaterials.size() * sizeof(Material));
+	mLayout.mSize = alignToCacheLine(mLayout.mLightOffset + lights.size() * sizeof(SphereLight));
+
+	// new[] only promises the alignment of the element type, so ask for an extra
+	// line and start on the first boundary inside it
+	mStorage.reset(new uint8_t[static_cast<size_t>(mLayout.mSize) + kCacheLineSize]);
+	uint8_t* arena = mStorage.get() + (kCacheLineSize - reinterpret_cast<uintptr_t>(mStorage.get()) % kCacheLineSize) % kCacheLineSize;
+	memset(arena, 0, static_cast<size_t>(mLayout.mSize));
+
+	if (!nodes.empty())
+		memcpy(arena + mLayout.mNodeOffset, nodes.data(), nodes.size() * sizeof(BvhNode));
+
+	CompiledSphere* sphereSection = reinterpret_cast<CompiledSphere*>(arena + mLayout.mSphereOffset);
+	mvSlots.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		memcpy(sphereSection + i, &pSpheres[indices[i]], sizeof(CompiledSphere));
+		mvSlots[indices[i]] = static_cast<uint32_t>(i);
+	}
+
+	if (!pMaterials.empty())
+		memcpy(arena + mLayout.mMaterialOffset, pMaterials.data(), pMaterials.size() * sizeof(Material));
+	if (!lights.empty())
+		memcpy(arena + mLayout.mLightOffset, lights.data(), lights.size() * sizeof(SphereLight));
+
+	bind(arena);
+	mContentHash = hashSceneContents(mSpheres, mMaterials);
+}
+
+// -----------------------------------------------------------------------------
+
+void CompiledScene::bind(const uint8_t* pArena)
+{
+	mArena = pArena;
+	mNodes = Span<const BvhNode>(reinterpret_cast<const BvhNode*>(pArena + mLayout.mNodeOffset),
+		static_cast<size_t>(mLayout.mNodeCount));
+	mSpheres = Span<const CompiledSphere>(reinterpret_cast<const CompiledSphere*>(pArena + mLayout.mSphereOffset),
+		static_cast<size_t>(mLayout.mSphereCount));
+	mMaterials = Span<const Material>(reinterpret_cast<const Material*>(pArena + mLayout.mMaterialOffset),
+		static_cast<size_t>(mLayout.mMaterialCount));
+	mLights = LightList(Span<const SphereLight>(reinterpret_cast<const SphereLight*>(pArena + mLayout.mLightOffset),
+		static_cast<size_t>(mLayout.mLightCount)));
+}
+
+// -----------------------------------------------------------------------------
+
+void CompiledScene::prepareRefit()
+{
+	mvParents.assign(mNodes.size(), 0);
+	mvLeafOfSlot.assign(mSpheres.size(), 0);
+	mvBuiltAreas.assign(mNodes.size(), 0.0);
+
+	// children always come after their parent, see BvhBuilder
+	for (uint32_t n = 0; n < mNodes.size(); ++n)
+	{
+		const BvhNode& node = mNodes[n];
+		mvBuiltAreas[n] = fmax(node.mBox.surfaceArea(), 1e-12);
+		if (node.isLeaf())
+		{
+			for (uint32_t i = node.mLeftOrFirst; i < node.mLeftOrFirst + node.mCount; ++i)
+				mvLeafOfSlot[i] = n;
+		}
+		else
+		{
+			mvParents[node.mLeftOrFirst] = n;
+			mvParents[node.mLeftOrFirst + 1] = n;
+		}
+	}
+	mGrowth = static_cast<double>(mNodes.size());
+}
+
+// -----------------------------------------------------------------------------
+
+void CompiledScene::moveSphere(uint32_t pIndex, const point3& pCenter)
+{
+	if (mvParents.size() != mNodes.size())
+		prepareRefit();
+
+	const uint32_t slot = slotOf(pIndex);
+	CompiledSphere* spheres = reinterpret_cast<CompiledSphere*>(ownedArena() + mLayout.mSphereOffset);
+	spheres[slot].mCenter = pCenter;
+
+	// a light goes with its sphere, there are few enough to look through
+	SphereLight* lights = reinterpret_cast<SphereLight*>(ownedArena() + mLayout.mLightOffset);
+	for (uint64_t i = 0; i < mLayout.mLightCount; ++i)
+	{
+		if (lights[i].mSlot == slot)
+			lights[i].mCenter = pCenter;
+	}
+	mvDirtyLeaves.push_back(mvLeafOfSlot[slot]);
+}
+
+// -----------------------------------------------------------------------------
+
+size_t CompiledScene::refit()
+{
+	BvhNode* nodes = reinterpret_cast<BvhNode*>(ownedArena() + mLayout.mNodeOffset);
+	auto sameBox = [](const AABB& pA, const AABB& pB)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			if (pA.mMin[a] != pB.mMin[a] || pA.mMax[a] != pB.mMax[a])
+				return false;
+		}
+		return true;
+	};
+
+	size_t changed = 0;
+	for (uint32_t leaf : mvDirtyLeaves)
+	{
+		AABB box;
+		for (uint32_t i = nodes[leaf].mLeftOrFirst; i < nodes[leaf].mLeftOrFirst + nodes[leaf].mCount; ++i)
+			box.grow(sphereBox(mSpheres[i]));
+
+		// once a box comes out the same, nothing above it can change either
+		uint32_t node = leaf;
+		while (!sameBox(box, nodes[node].mBox))
+		{
+			mGrowth += (box.surfaceArea() - nodes[node].mBox.surfaceArea()) / mvBuiltAreas[node];
+			nodes[node].mBox = box;
+			++changed;
+			if (node == 0)
+				break;
+
+			node = mvParents[node];
+			const uint32_t left = nodes[node].mLeftOrFirst;
+			box = surroundingBox(nodes[left].mBox, nodes[left + 1].mBox);
+		}
+	}
+
+	mvDirtyLeaves.clear();
+	return changed;
+}
+
+// -----------------------------------------------------------------------------
+
+bool CompiledScene::hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const
+{
+	bool hitAnything = false;
+	Real closest = pMaxT;
+
+	if (!mNodes.empty())
+	{
+		hitAnything = traverseBvh(mNodes.data(), pRay, pMinT, pMaxT, [&](uint32_t pFirst, uint32_t pCount, Real& pClosestSoFar)
+		{
+			RT_STAT(threadStats().mSphereTests += pCount);
+			bool hitLeaf = false;
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i)
+			{
+				const CompiledSphere& sphere = mSpheres[i];
+				Real trace;
+				if (intersectSphere(pRay, sphere.mCenter, sphere.mRadius, pMinT, pClosestSoFar, trace))
+				{
+					RT_STAT(threadStats().mSphereHits++);
+					setSphereHitRecord(pRay, trace, sphere.mCenter, sphere.mRadius, sphere.mMaterialId, pRecord);
+					pClosestSoFar = trace;
+					hitLeaf = true;
+				}
+			}
+			return hitLeaf;
+		});
+
+		if (hitAnything)
+			closest = pRecord.mTrace;
+	}
+
+	if (!mOthers.mvObjects.empty() && mOthers.hit(pRay, pMinT, closest, pRecord))
+		hitAnything = true;
+
+	return hitAnything;
+}
+
+// -----------------------------------------------------------------------------
+
+int CompiledScene::hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+	HitRecord* pRecords) const
+{
+	if (pActiveMask == 0)
+		return 0;
+
+	int result = 0;
+	if (!mNodes.empty())
+	{
+		result = traverseBvhPacket(mNodes.data(), pPacket, pActiveMask, pMinT, pMaxT, [&](uint32_t pFirst, uint32_t pCount, int pLanes)
+		{
+			int leafResult = 0;
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i)
+			{
+				const CompiledSphere& sphere = mSpheres[i];
+				const int lanes = hitSpherePacket(sphere.mCenter, sphere.mRadius * sphere.mRadius, pPacket, pLanes, pMinT, pMaxT);
+				RT_STAT(threadStats().mSphereTests += countLanes(pLanes));
+				RT_STAT(threadStats().mSphereHits += countLanes(lanes));
+				for (int lane = 0; lane < RayPacket::kSize; ++lane)
+				{
+					if (lanes & (1 << lane))
+						setSphereHitRecord(pPacket.ray(lane), pMaxT[lane], sphere.mCenter, sphere.mRadius, sphere.mMaterialId, pRecords[lane]);
+				}
+				leafResult |= lanes;
+			}
+			return leafResult;
+		});
+	}
+
+	if (!mOthers.mvObjects.empty())
+		result |= mOthers.hitPacket(pPacket, pActiveMask, pMinT, pMaxT, pRecords);
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+
+bool CompiledScene::occluded(const Ray& pRay, Real pMinT, Real pMaxT) const
+{
+	if (!mNodes.empty())
+	{
+		const bool blocked = anyHitBvh(mNodes.data(), pRay, pMinT, pMaxT, [&](uint32_t pFirst, uint32_t pCount)
+		{
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i)
+			{
+				RT_STAT(threadStats().mSphereTests++);
+				const CompiledSphere& sphere = mSpheres[i];
+				Real trace;
+				if (intersectSphere(pRay, sphere.mCenter, sphere.mRadius, pMinT, pMaxT, trace))
+					return true;
+			}
+			return false;
+		});
+
+		if (blocked)
+			return true;
+	}
+
+	return !mOthers.mvObjects.empty() && mOthers.occluded(pRay, pMinT, pMaxT);
+}
+
+// -----------------------------------------------------------------------------
+
+bool CompiledScene::boundingBox(AABB& pOutputBox) const
+{
+	pOutputBox = mNodes.empty() ? AABB() : mNodes[0].mBox;
+
+	AABB othersBox;
+	if (!mOthers.mvObjects.empty() && mOthers.boundingBox(othersBox))
+		pOutputBox.grow(othersBox);
+
+	return !pOutputBox.isEmpty();
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !COMPILED_SCENE_H_
\ No newline at end of file
@@ -0,0 +1,299 @@
+// -----------------------------------------------------------------------------
+#ifndef DENOISER_H_
+#define DENOISER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "colour.h"
+#include "Framebuffer.h"
+#include "ImageWriter.h"
+#include "Integrator.h"
+#include "rtweekend.h"
+#include "ThreadPool.h"
+#include "vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// the colour divided by the albedo, what's left is the light arriving at the
+// first hit. the denoiser smooths this, not the texture on top of it
+const Real kMinAlbedo = 0.01;
+
+inline colour demodulate(const colour& pColour, const colour& pAlbedo)
+{
+	return colour(pColour.x() / fmax(pAlbedo.x(), kMinAlbedo), pColour.y() / fmax(pAlbedo.y(), kMinAlbedo),
+		pColour.z() / fmax(pAlbedo.z(), kMinAlbedo));
+}
+
+inline Real luminance(const colour& pColour)
+{
+	return Real(0.2126) * pColour.x() + Real(0.7152) * pColour.y() + Real(0.0722) * pColour.z();
+}
+
+// -----------------------------------------------------------------------------
+
+// one pixel's samples added up: their first hits, and the first two moments of
+// their lighting's luminance so the denoiser knows how noisy the pixel is
+struct PixelAovs
+{
+	// ---- methods
+	void add(const FirstHit& pHit, const colour& pSample)
+	{
+		mAlbedo += pHit.mAlbedo;
+		mNormal += pHit.mNormal;
+		mDepth += pHit.mDepth;
+
+		const Real lighting = luminance(demodulate(pSample, pHit.mAlbedo));
+		mLuminance += lighting;
+		mMoment += lighting * lighting;
+	}
+
+	void scale(Real pScale)
+	{
+		mAlbedo *= pScale;
+		mNormal *= pScale;
+		mDepth *= pScale;
+		mLuminance *= pScale;
+		mMoment *= pScale;
+	}
+
+	// ---- members
+	colour mAlbedo;
+	vec3 mNormal;
+	Real mDepth = 0.0;
+	Real mLuminance = 0.0;
+	Real mMoment = 0.0;
+};
+
+// -----------------------------------------------------------------------------
+
+// PixelAovs for every pixel of a frame, each a sum of the pixel's samples like
+// the colours are. the denoiser divides them by the sample count like the writer
+struct AovBuffers
+{
+	// ---- methods
+	void resize(int pWidth, int pHeight)
+	{
+		mAlbedo.assign(pHeight, vector<colour>(pWidth));
+		mNormal.assign(pHeight, vector<vec3>(pWidth));
+		mDepth.assign(pHeight, vector<Real>(pWidth, 0.0));
+		mLuminance.assign(pHeight, vector<Real>(pWidth, 0.0));
+		mMoment.assign(pHeight, vector<Real>(pWidth, 0.0));
+	}
+
+	bool empty() const { return mAlbedo.empty(); }
+
+	void set(int pX, int pY, const PixelAovs& pSum)
+	{
+		mAlbedo[pY][pX] = pSum.mAlbedo;
+		mNormal[pY][pX] = pSum.mNormal;
+		mDepth[pY][pX] = pSum.mDepth;
+		mLuminance[pY][pX] = pSum.mLuminance;
+		mMoment[pY][pX] = pSum.mMoment;
+	}
+
+	// ---- members
+	vector<vector<colour>> mAlbedo;
+	vector<vector<vec3>> mNormal;
+	vector<vector<Real>> mDepth;
+	vector<vector<Real>> mLuminance;
+	vector<vector<Real>> mMoment;
+};
+
+// -----------------------------------------------------------------------------
+
+// albedo, normal and depth as pfms next to each other, pPrefix_albedo.pfm and
+// so on. normals stay in [-1, 1], pfm doesn't mind
+bool writeAovs(const string& pPrefix, const AovBuffers& pAovs, int pSamplesPerPixel)
+{
+	const int height = static_cast<int>(pAovs.mAlbedo.size());
+	const int width = height > 0 ? static_cast<int>(pAovs.mAlbedo[0].size()) : 0;
+	Framebuffer albedo(width, height), normal(width, height), depth(width, height);
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const Real d = pAovs.mDepth[j][i];
+			albedo.set(i, j, pAovs.mAlbedo[j][i], pSamplesPerPixel);
+			normal.set(i, j, pAovs.mNormal[j][i], pSamplesPerPixel);
+			depth.set(i, j, colour(d, d, d), pSamplesPerPixel);
+		}
+	}
+
+	return writeImage(pPrefix + "_albedo.pfm", ImageFormat::Pfm, albedo, pSamplesPerPixel)
+		&& writeImage(pPrefix + "_normal.pfm", ImageFormat::Pfm, normal, pSamplesPerPixel)
+		&& writeImage(pPrefix + "_depth.pfm", ImageFormat::Pfm, depth, pSamplesPerPixel);
+}
+
+// -----------------------------------------------------------------------------
+
+// how hard each guide holds the filter back at an edge. two pixels' lighting
+// is a gaussian of mLuminanceSigma standard errors apart, normals are compared
+// as dot^mNormalPower, and depths and albedos by how far apart they are
+// relative to mDepthSigma and mAlbedoSigma. the defaults are the lowest rmse
+// on randomScene() at 400 wide, see benchmarkDenoise(). more passes look
+// smoother but lose more of the small spheres' edges
+struct DenoiseSettings
+{
+	// ---- members
+	int mPasses = 3;
+	double mLuminanceSigma = 3.0;
+	double mNormalPower = 4.0;
+	double mDepthSigma = 0.1;
+	double mAlbedoSigma = 0.3;
+};
+
+// -----------------------------------------------------------------------------
+
+// an edge avoiding a-trous wavelet filter (dammertz et al. 2010) with the
+// variance guided colour weight of svgf (schied et al. 2017). each pass is a
+// 5x5 b3 spline with its taps spread 1, 2, 4... pixels apart, and every tap is
+// weighted by how alike the two pixels' lighting, normal, depth and albedo are.
+// how different the lighting may be depends on how noisy it is, which each
+// pass cuts down, so the wide late passes only smooth what's left of the noise.
+// the colour is divided by the albedo first and multiplied back at the end so
+// texture and the edges between materials stay sharp. takes and returns per
+// pixel sums of pSamplesPerPixel samples, the same as the renderers and writer
+Framebuffer denoise(
+	const Framebuffer& pPixels,
+	int pSamplesPerPixel,
+	const AovBuffers& pAovs,
+	const DenoiseSettings& pSettings,
+	ThreadPool& pPool)
+{
+	const int height = pPixels.height();
+	const int width = pPixels.width();
+	const size_t count = static_cast<size_t>(width) * height;
+	const Real inverse = Real(1.0) / pSamplesPerPixel;
+
+	// flat copies of the averages. variance is that of the lighting's mean
+	// luminance, the spread of the samples over how many there were
+	vector<colour> lighting(count), albedo(count), normal(count);
+	vector<Real> depth(count), variance(count);
+
+	pPool.parallelFor(height, 4, [&](size_t pBegin, size_t pEnd)
+	{
+		for (size_t j = pBegin; j < pEnd; ++j)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				const size_t n = j * width + i;
+				albedo[n] = pAovs.mAlbedo[j][i] * inverse;
+				lighting[n] = demodulate(pPixels.get(i, static_cast<int>(j)) * inverse, albedo[n]);
+
+				const Real mean = pAovs.mLuminance[j][i] * inverse;
+				variance[n] = fmax(pAovs.mMoment[j][i] * inverse - mean * mean, Real(0.0)) * inverse;
+
+				// a pixel on an edge averages two normals into a shorter one
+				const vec3 sum = pAovs.mNormal[j][i];
+				const Real length = sum.length();
+				normal[n] = length > 1e-6 ? sum / length : vec3(0, 0, 0);
+				depth[n] = pAovs.mDepth[j][i] * inverse;
+			}
+		}
+	});
+
+	const Real kernel[5] = { 1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0 };
+	const Real albedoScale = Real(1.0) / (pSettings.mAlbedoSigma * pSettings.mAlbedoSigma);
+	vector<colour> filtered(count);
+	vector<Real> filteredVariance(count);
+
+	for (int pass = 0; pass < pSettings.mPasses; ++pass)
+	{
+		const int step = 1 << pass;
+		const Real depthScale = Real(1.0) / (pSettings.mDepthSigma * step);
+
+		pPool.parallelFor(height, 4, [&](size_t pBegin, size_t pEnd)
+		{
+			for (int j = static_cast<int>(pBegin); j < static_cast<int>(pEnd); ++j)
+			{
+				for (int i = 0; i < width; ++i)
+				{
+					const size_t p = static_cast<size_t>(j) * width + i;
+
+					// a single pixel's variance is noisy too, a 3x3 blur of it is steadier
+					Real blurred = 0.0, blurWeight = 0.0;
+					for (int y = max(j - 1, 0); y <= min(j + 1, height - 1); ++y)
+					{
+						for (int x = max(i - 1, 0); x <= min(i + 1, width - 1); ++x)
+						{
+							const Real w = (y == j ? Real(2.0) : Real(1.0)) * (x == i ? Real(2.0) : Real(1.0));
+							blurred += w * variance[static_cast<size_t>(y) * width + x];
+							blurWeight += w;
+						}
+					}
+					const Real luminanceScale = Real(0.5)
+						/ (pSettings.mLuminanceSigma * pSettings.mLuminanceSigma * blurred / blurWeight + Real(1e-8));
+					const Real luminanceP = luminance(lighting[p]);
+					const bool hasNormal = normal[p].lengthSquared() > 0;
+
+					colour sum(0, 0, 0);
+					Real weightSum = 0.0, varianceSum = 0.0;
+					for (int ky = 0; ky < 5; ++ky)
+					{
+						const int y = j + (ky - 2) * step;
+						if (y < 0 || y >= height)
+							continue;
+
+						for (int kx = 0; kx < 5; ++kx)
+						{
+							const int x = i + (kx - 2) * step;
+							if (x < 0 || x >= width)
+								continue;
+
+							const size_t q = static_cast<size_t>(y) * width + x;
+
+							// sky against sky is alike, sky against a surface isn't
+							Real normalWeight = 1.0;
+							if (hasNormal || normal[q].lengthSquared() > 0)
+								normalWeight = pow(fmax(dot(normal[p], normal[q]), Real(0.0)), Real(pSettings.mNormalPower));
+
+							const Real luminanceDistance = luminanceP - luminance(lighting[q]);
+							const Real exponent = luminanceDistance * luminanceDistance * luminanceScale
+								+ fabs(depth[p] - depth[q]) / fmax(depth[p], Real(1e-3)) * depthScale
+								+ (albedo[p] - albedo[q]).lengthSquared() * albedoScale;
+
+							const Real weight = kernel[kx] * kernel[ky] * normalWeight * exp(-exponent);
+							sum += weight * lighting[q];
+							weightSum += weight;
+							varianceSum += weight * weight * variance[q];
+						}
+					}
+
+					// the centre tap always counts for 9/64, so weightSum is never 0
+					filtered[p] = sum / weightSum;
+					filteredVariance[p] = varianceSum / (weightSum * weightSum);
+				}
+			}
+		});
+
+		lighting.swap(filtered);
+		variance.swap(filteredVariance);
+	}
+
+	Framebuffer result(width, height, pPixels.tileSize());
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const size_t n = static_cast<size_t>(j) * width + i;
+			const colour& e = lighting[n];
+			const colour& a = albedo[n];
+			result.set(i, j, colour(e.x() * fmax(a.x(), kMinAlbedo), e.y() * fmax(a.y(), kMinAlbedo),
+				e.z() * fmax(a.z(), kMinAlbedo)) * Real(pSamplesPerPixel), pSamplesPerPixel);
+		}
+	}
+	result.setAllTileSamples(pSamplesPerPixel);
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !DENOISER_H_
\ No newline at end of file
@@ -0,0 +1,588 @@
+// -----------------------------------------------------------------------------
+#ifndef DISTRIBUTED_RENDER_H_
+#define DISTRIBUTED_RENDER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "Camera.h"
+#include "colour.h"
+#include "CompiledScene.h"
+#include "Framebuffer.h"
+#include "Hittable.h"
+#include "ImageWriter.h"
+#include "Material.h"
+#include "MultiThreadFunctions.h"
+#include "RenderSettings.h"
+#include "SceneFile.h"
+#include "Socket.h"
+#include "Span.h"
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// one frame spread over several processes. the coordinator cuts the frame into
+// the same tiles multithreadRender uses and hands them out over tcp, one at a
+// time, to every worker connection. workers load the scene themselves, render
+// each tile with the ordinary tile renderers and send the pixels back. every
+// sample is seeded from its pixel and index alone, so it makes no difference
+// which worker renders a tile or how many times, the image matches a single
+// process render bit for bit.
+//
+// a worker that drops its connection or goes quiet for mWorkerTimeout loses
+// its tile back to the queue. once the queue is empty, idle workers are given
+// copies of tiles that have been out much longer than tiles usually take, and
+// whichever copy comes back first is kept.
+//
+// messages are a type and a size followed by the payload, in the byte order
+// and precision of the machines, which both ends check when they say hello
+
+enum class MessageType : uint32_t
+{
+	Hello = 1,	// worker -> coordinator: version, sizeof(Real), scene fingerprint
+	Setup,		// coordinator -> worker: the settings that decide the pixels
+	Job,		// coordinator -> worker: a tile to render
+	Pixels,		// worker -> coordinator: the tile's pixels
+	Done		// coordinator -> worker: nothing left, hang up
+};
+
+const uint32_t kDistributedVersion = 4;
+
+// a frame's pixels are nowhere near this, anything bigger is a broken stream
+const uint32_t kMaxMessageSize = 1u << 30;
+
+// -----------------------------------------------------------------------------
+
+// the payload of a message, written and read back in the same order
+class Message
+{
+public:
+	// ---- methods
+	template<typename T>
+	void put(const T& pValue)
+	{
+		static_assert(is_trivially_copyable<T>::value, "only plain values go in a message");
+		putBytes(&pValue, sizeof(T));
+	}
+
+	void putBytes(const void* pData, size_t pSize)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(pData);
+		mvData.insert(mvData.end(), data, data + pSize);
+	}
+
+	template<typename T>
+	bool get(T& pValue)
+	{
+		static_assert(is_trivially_copyable<T>::value, "only plain values come out of a message");
+		return getBytes(&pValue, sizeof(T));
+	}
+
+	bool getBytes(void* pData, size_t pSize)
+	{
+		if (pSize > mvData.size() - mRead)
+			return false;
+		memcpy(pData, mvData.data() + mRead, pSize);
+		mRead += pSize;
+		return true;
+	}
+
+	// ---- members
+	vector<uint8_t> mvData;
+	size_t mRead = 0;
+};
+
+// -----------------------------------------------------------------------------
+
+bool sendMessage(Socket& pSocket, MessageType pType, const Message& pMessage = Message())
+{
+	const uint32_t header[2] = { static_cast<uint32_t>(pType), static_cast<uint32_t>(pMessage.mvData.size()) };
+	return pSocket.sendAll(header, sizeof(header))
+		&& (pMessage.mvData.empty() || pSocket.sendAll(pMessage.mvData.data(), pMessage.mvData.size()));
+}
+
+// waits up to pSeconds for each part of the message, or forever if it's negative.
+// a worker stopped halfway through sending a tile mustn't hang the coordinator
+bool receiveMessage(Socket& pSocket, MessageType& pType, Message& pMessage, double pSeconds = -1.0)
+{
+	uint32_t header[2];
+	if (!pSocket.receiveAll(header, sizeof(header), pSeconds) || header[1] > kMaxMessageSize)
+		return false;
+
+	pType = static_cast<MessageType>(header[0]);
+	pMessage.mvData.resize(header[1]);
+	pMessage.mRead = 0;
+	return pMessage.mvData.empty() || pSocket.receiveAll(pMessage.mvData.data(), pMessage.mvData.size(), pSeconds);
+}
+
+// -----------------------------------------------------------------------------
+
+// the settings a worker takes from the coordinator, everything that changes
+// which samples are taken or what they add up to, and the tile size so both
+// ends lay out their framebuffers alike. the scene isn't sent, see
+// sceneFingerprint()
+void putRenderSetup(Message& pMessage, const RenderSettings& pSettings)
+{
+	pMessage.put<int32_t>(pSettings.mImageWidth);
+	pMessage.put<int32_t>(pSettings.mImageHeight);
+	pMessage.put<int32_t>(pSettings.mSamplesPerPixel);
+	pMessage.put<int32_t>(pSettings.mFirstSample);
+	pMessage.put<int32_t>(pSettings.mMaxDepth);
+	pMessage.put<uint64_t>(pSettings.mSeed);
+	pMessage.put<uint8_t>(pSettings.mRussianRoulette);
+	pMessage.put<int32_t>(pSettings.mRouletteMinBounces);
+	pMessage.put<double>(pSettings.mRouletteThreshold);
+	pMessage.put<uint8_t>(pSettings.mUsePackets);
+	pMessage.put<uint8_t>(pSettings.mAdaptive);
+	pMessage.put<int32_t>(pSettings.mMinSamples);
+	pMessage.put<double>(pSettings.mAdaptiveThreshold);
+	pMessage.put<uint8_t>(static_cast<uint8_t>(pSettings.mSampler));
+	pMessage.put<int32_t>(pSettings.mTileSize);
+	pMessage.put<uint8_t>(pSettings.mLightSampling);
+}
+
+bool getRenderSetup(Message& pMessage, RenderSettings& pSettings)
+{
+	int32_t width, height, spp, firstSample, maxDepth, rouletteMinBounces, minSamples, tileSize;
+	uint64_t seed;
+	uint8_t roulette, packets, adaptive, sampler, lightSampling;
+	double rouletteThreshold, adaptiveThreshold;
+
+	if (!pMessage.get(width) || !pMessage.get(height) || !pMessage.get(spp) || !pMessage.get(firstSample)
+		|| !pMessage.get(maxDepth) || !pMessage.get(seed) || !pMessage.get(roulette)
+		|| !pMessage.get(rouletteMinBounces) || !pMessage.get(rouletteThreshold) || !pMessage.get(packets)
+		|| !pMessage.get(adaptive) || !pMessage.get(minSamples) || !pMessage.get(adaptiveThreshold)
+		|| !pMessage.get(sampler) || !pMessage.get(tileSize) || tileSize <= 0 || tileSize > kMaxTileSize
+		|| !pMessage.get(lightSampling))
+		return false;
+
+	pSettings.mImageWidth = width;
+	pSettings.mImageHeight = height;
+	pSettings.mSamplesPerPixel = spp;
+	pSettings.mFirstSample = firstSample;
+	pSettings.mMaxDepth = maxDepth;
+	pSettings.mSeed = seed;
+	pSettings.mRussianRoulette = roulette != 0;
+	pSettings.mRouletteMinBounces = rouletteMinBounces;
+	pSettings.mRouletteThreshold = rouletteThreshold;
+	pSettings.mUsePackets = packets != 0;
+	pSettings.mAdaptive = adaptive != 0;
+	pSettings.mMinSamples = minSamples;
+	pSettings.mAdaptiveThreshold = adaptiveThreshold;
+	pSettings.mSampler = static_cast<SamplerType>(sampler);
+	pSettings.mTileSize = tileSize;
+	pSettings.mLightSampling = lightSampling != 0;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// hands out the tiles of one frame to worker connections and puts the pixels
+// they send back together. one thread per connection
+class Coordinator
+{
+public:
+	// ---- constructors
+	Coordinator(const RenderSettings& pSettings, uint64_t pFingerprint, ostream& pLog)
+		: mSettings(pSettings)
+		, mFingerprint(pFingerprint)
+		, mLog(pLog)
+	{
+		for (const Tile& tile : makeTiles(pSettings.mImageWidth, pSettings.mImageHeight, pSettings.mTileSize, pSettings.mTileOrder))
+		{
+			Job job;
+			job.mTile = tile;
+			mvJobs.push_back(job);
+			mPending.push_back(static_cast<uint32_t>(mvJobs.size() - 1));
+		}
+		mRemaining = mvJobs.size();
+		mPixels = Framebuffer(pSettings.mImageWidth, pSettings.mImageHeight, pSettings.mTileSize);
+	}
+
+	// ---- methods
+	// serves workers on pListener until every tile is back
+	Framebuffer run(Socket& pListener)
+	{
+		vector<thread> connections;
+		int nextWorker = 0;
+
+		while (!finished())
+		{
+			Socket client;
+			if (pListener.accept(client, 0.1))
+			{
+				const int worker = nextWorker++;
+				connections.emplace_back([this, worker](Socket pClient) { serve(pClient, worker); }, move(client));
+			}
+		}
+
+		for (thread& connection : connections)
+			connection.join();
+
+		return move(mPixels);
+	}
+
+	size_t reissued() const { return mReissued; }
+
+private:
+	typedef chrono::steady_clock Clock;
+
+	struct Job
+	{
+		Tile mTile;
+		Clock::time_point mIssued;
+		int mInFlight = 0;
+		bool mDone = false;
+	};
+
+	bool finished()
+	{
+		lock_guard<mutex> lock(mLock);
+		return mRemaining == 0;
+	}
+
+	void log(const string& pText)
+	{
+		lock_guard<mutex> lock(mLock);
+		mLog << pText << '\n';
+	}
+
+	// blocks until there's a tile for a worker, false once the frame is done
+	bool nextJob(uint32_t& pIndex)
+	{
+		unique_lock<mutex> lock(mLock);
+		while (mRemaining > 0)
+		{
+			while (!mPending.empty())
+			{
+				pIndex = mPending.front();
+				mPending.pop_front();
+				if (!mvJobs[pIndex].mDone)
+				{
+					issue(pIndex);
+					return true;
+				}
+			}
+
+			// nothing new to give out, so back up the tile that has been out
+			// longest if it's well past how long tiles usually take
+			if (mCompleted > 0)
+			{
+				const Clock::time_point now = Clock::now();
+				const double slowAfter = max(4.0 * mCompletedSeconds / mCompleted, 0.25);
+				int oldest = -1;
+				for (size_t i = 0; i < mvJobs.size(); ++i)
+				{
+					const Job& job = mvJobs[i];
+					if (job.mDone || job.mInFlight != 1)
+						continue;
+					if (chrono::duration<double>(now - job.mIssued).count() > slowAfter
+						&& (oldest < 0 || job.mIssued < mvJobs[oldest].mIssued))
+						oldest = static_cast<int>(i);
+				}
+				if (oldest >= 0)
+				{
+					pIndex = static_cast<uint32_t>(oldest);
+					issue(pIndex);
+					mReissued++;
+					return true;
+				}
+			}
+
+			mWake.wait_for(lock, chrono::milliseconds(50));
+		}
+		return false;
+	}
+
+	void issue(uint32_t pIndex)
+	{
+		Job& job = mvJobs[pIndex];
+		if (job.mInFlight == 0)
+			job.mIssued = Clock::now();
+		job.mInFlight++;
+	}
+
+	// the worker gave up on the tile, somebody else has to do it
+	void abandon(uint32_t pIndex)
+	{
+		lock_guard<mutex> lock(mLock);
+		Job& job = mvJobs[pIndex];
+		job.mInFlight--;
+		if (!job.mDone && job.mInFlight == 0)
+		{
+			mPending.push_front(pIndex);
+			mReissued++;
+		}
+		mWake.notify_all();
+	}
+
+	bool complete(uint32_t pIndex, Message& pMessage)
+	{
+		const Tile& tile = mvJobs[pIndex].mTile;
+		const size_t count = static_cast<size_t>(tile.width()) * tile.height();
+		if (pMessage.mvData.size() - pMessage.mRead != count * sizeof(FramePixel))
+			return false;
+
+		lock_guard<mutex> lock(mLock);
+		Job& job = mvJobs[pIndex];
+		job.mInFlight--;
+
+		// a copy already came back, this one's the same so it's dropped
+		if (job.mDone)
+			return true;
+
+		// a scheduler tile is one framebuffer tile, so each of its rows is one run
+		for (int j = tile.mY0; j < tile.mY1; ++j)
+			pMessage.getBytes(&mPixels.at(tile.mX0, j), tile.width() * sizeof(FramePixel));
+		mPixels.addTileSamples(tile.mX0, tile.mY0, tile.mX1, tile.mY1, mSettings.mSamplesPerPixel);
+
+		job.mDone = true;
+		mCompleted++;
+		mCompletedSeconds += chrono::duration<double>(Clock::now() - job.mIssued).count();
+		mRemaining--;
+		mWake.notify_all();
+		return true;
+	}
+
+	// waits for a reply, checking now and then whether the frame finished
+	// without it (another copy of the tile came back first)
+	bool awaitReply(Socket& pSocket, MessageType& pType, Message& pMessage)
+	{
+		const Clock::time_point start = Clock::now();
+		while (!pSocket.waitReadable(0.1))
+		{
+			if (finished() || chrono::duration<double>(Clock::now() - start).count() > mSettings.mWorkerTimeout)
+				return false;
+		}
+		return receiveMessage(pSocket, pType, pMessage, mSettings.mWorkerTimeout);
+	}
+
+	void serve(Socket& pSocket, int pWorker)
+	{
+		const string name = "worker " + to_string(pWorker);
+
+		MessageType type;
+		Message message;
+		uint32_t version = 0, realSize = 0;
+		uint64_t fingerprint = 0;
+		if (!receiveMessage(pSocket, type, message, mSettings.mWorkerTimeout) || type != MessageType::Hello
+			|| !message.get(version) || !message.get(realSize) || !message.get(fingerprint))
+		{
+			log(name + " didn't say hello, dropped");
+			return;
+		}
+		if (version != kDistributedVersion || realSize != sizeof(Real) || fingerprint != mFingerprint)
+		{
+			log(name + " has a different " + (version != kDistributedVersion ? "version"
+				: realSize != sizeof(Real) ? "precision" : "scene") + ", dropped");
+			sendMessage(pSocket, MessageType::Done);
+			return;
+		}
+
+		Message setup;
+		putRenderSetup(setup, mSettings);
+		if (!sendMessage(pSocket, MessageType::Setup, setup))
+			return;
+
+		int tiles = 0;
+		uint32_t index;
+		while (nextJob(index))
+		{
+			const Tile& tile = mvJobs[index].mTile;
+			Message job;
+			job.put(index);
+			job.put<int32_t>(tile.mX0);
+			job.put<int32_t>(tile.mY0);
+			job.put<int32_t>(tile.mX1);
+			job.put<int32_t>(tile.mY1);
+
+			uint32_t replyIndex = 0;
+			if (!sendMessage(pSocket, MessageType::Job, job) || !awaitReply(pSocket, type, message)
+				|| type != MessageType::Pixels || !message.get(replyIndex) || replyIndex != index
+				|| !complete(index, message))
+			{
+				abandon(index);
+				if (!finished())
+					log(name + " went quiet or sent garbage, its tile went back in the queue");
+				return;
+			}
+			tiles++;
+		}
+
+		sendMessage(pSocket, MessageType::Done);
+		log(name + " rendered " + to_string(tiles) + " tiles");
+	}
+
+	// ---- members
+	const RenderSettings& mSettings;
+	uint64_t mFingerprint;
+	ostream& mLog;
+
+	mutex mLock;
+	condition_variable mWake;
+	vector<Job> mvJobs;
+	deque<uint32_t> mPending;
+	size_t mRemaining = 0;
+	size_t mCompleted = 0;
+	double mCompletedSeconds = 0.0;
+	size_t mReissued = 0;
+	Framebuffer mPixels;
+};
+
+// -----------------------------------------------------------------------------
+
+// the coordinator's side of --coordinator. it only needs the scene to check
+// the workers have the same one
+bool coordinateRender(const RenderSettings& pSettings, uint64_t pFingerprint)
+{
+	if (pSettings.mProgressive)
+	{
+		cerr << "progressive rendering can't be distributed\n";
+		return false;
+	}
+
+	Socket listener;
+	if (!listener.listen(static_cast<uint16_t>(pSettings.mCoordinatorPort)))
+	{
+		cerr << "couldn't listen on port " << pSettings.mCoordinatorPort << '\n';
+		return false;
+	}
+	cerr << "coordinator listening on port " << listener.port() << endl;
+
+	const auto start = chrono::steady_clock::now();
+	Coordinator coordinator(pSettings, pFingerprint, cerr);
+	const Framebuffer pixels = coordinator.run(listener);
+	cerr << "frame done in " << chrono::duration<double>(chrono::steady_clock::now() - start).count()
+		<< "s, " << coordinator.reissued() << " tiles handed out again\n";
+
+	if (!writeImage(pSettings.mOutputPath, pSettings.mOutputFormat, pixels, pSettings.mSamplesPerPixel))
+	{
+		cerr << "couldn't write " << pSettings.mOutputPath << '\n';
+		return false;
+	}
+	cerr << "wrote " << pSettings.mOutputPath << '\n';
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// one connection to the coordinator, rendering whatever tile it's given until
+// it says it's done. the coordinator may start after the worker, so the
+// connection is retried for a while
+bool workerConnection(const string& pHost, uint16_t pPort, const RenderSettings& pSettings, const Camera& pCamera,
+	const Hittable& pWorld, Span<const Material> pMaterials, uint64_t pFingerprint)
+{
+	Socket socket;
+	const auto start = chrono::steady_clock::now();
+	while (!socket.connect(pHost, pPort))
+	{
+		if (chrono::duration<double>(chrono::steady_clock::now() - start).count() > pSettings.mWorkerTimeout)
+			return false;
+		this_thread::sleep_for(chrono::milliseconds(250));
+	}
+
+	Message hello;
+	hello.put(kDistributedVersion);
+	hello.put<uint32_t>(sizeof(Real));
+	hello.put(pFingerprint);
+
+	MessageType type;
+	Message message;
+	RenderSettings settings = pSettings;
+	if (!sendMessage(socket, MessageType::Hello, hello) || !receiveMessage(socket, type, message)
+		|| type != MessageType::Setup || !getRenderSetup(message, settings))
+		return false;
+
+	// from here on a dropped connection isn't an error. the coordinator hangs
+	// up on workers still busy with a tile someone else already finished, and
+	// if it died, whatever it had is gone anyway
+
+	// one tile's worth of pixels, moved over each tile as it comes, the way
+	// renderOutOfCore does. a whole frame per connection adds up fast
+	Framebuffer pixels(settings.mTileSize, settings.mTileSize, settings.mTileSize);
+	while (receiveMessage(socket, type, message) && type == MessageType::Job)
+	{
+		uint32_t index;
+		Tile tile;
+		if (!message.get(index) || !message.get(tile.mX0) || !message.get(tile.mY0)
+			|| !message.get(tile.mX1) || !message.get(tile.mY1)
+			|| tile.mX0 < 0 || tile.mY0 < 0 || tile.mX1 > settings.mImageWidth || tile.mY1 > settings.mImageHeight
+			|| tile.mX1 <= tile.mX0 || tile.mY1 <= tile.mY0
+			|| tile.width() > settings.mTileSize || tile.height() > settings.mTileSize)
+			break;
+
+		pixels.moveTo(tile.mX0, tile.mY0);
+		pixels.clear();
+		if (settings.mAdaptive)
+			renderAdaptive(tile, settings, pCamera, pWorld, pMaterials, pixels);
+		else if (settings.mUsePackets)
+			renderPackets(tile, settings, pCamera, pWorld, pMaterials, pixels);
+		else
+			render(tile, settings, pCamera, pWorld, pMaterials, pixels);
+
+		Message reply;
+		reply.put(index);
+		for (int j = tile.mY0; j < tile.mY1; ++j)
+			reply.putBytes(&pixels.at(tile.mX0, j), tile.width() * sizeof(FramePixel));
+		if (!sendMessage(socket, MessageType::Pixels, reply))
+			break;
+	}
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// the worker's side of --worker host:port. each render thread is its own
+// connection, so the coordinator just sees more workers
+bool runWorker(const RenderSettings& pSettings, const Camera& pCamera, const Hittable& pWorld,
+	Span<const Material> pMaterials, uint64_t pFingerprint)
+{
+	const size_t colon = pSettings.mWorkerAddress.rfind(':');
+	if (colon == string::npos)
+	{
+		cerr << "the worker needs host:port, not " << pSettings.mWorkerAddress << '\n';
+		return false;
+	}
+	const string host = pSettings.mWorkerAddress.substr(0, colon);
+	const uint16_t port = static_cast<uint16_t>(atoi(pSettings.mWorkerAddress.c_str() + colon + 1));
+
+	const unsigned int numThreads = pSettings.mThreads != 0 ? pSettings.mThreads
+		: (thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 4);
+
+	vector<thread> threads;
+	vector<char> succeeded(numThreads, 0);
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([&, i]()
+		{
+			succeeded[i] = workerConnection(host, port, pSettings, pCamera, pWorld, pMaterials, pFingerprint);
+		});
+	}
+	for (thread& t : threads)
+		t.join();
+
+	const bool ok = find(succeeded.begin(), succeeded.end(), 0) == succeeded.end();
+	cerr << (ok ? "worker finished\n" : "some of the worker's connections never got going\n");
+	return ok;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !DISTRIBUTED_RENDER_H_
\ No newline at end of file
@@ -0,0 +1,286 @@
+// -----------------------------------------------------------------------------
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "colour.h"
+#include "rtweekend.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// one pixel of a Framebuffer: the sum of its samples' colours, and in a how
+// many samples that sum is worth. floats are plenty for a sum that's divided
+// by its count before anyone looks at it, and four of them fill 16 bytes
+// where a colour of doubles took 24
+struct FramePixel
+{
+	float r, g, b, a;
+};
+
+static_assert(sizeof(FramePixel) == 16, "four pixels to a cache line");
+
+// the same as the tile scheduler's default, so a frame's tiles are its
+// framebuffer's tiles
+const int kFramebufferTileSize = 16;
+
+// -----------------------------------------------------------------------------
+
+// a frame's pixel sums in one cache line aligned block, tile by tile instead of
+// row by row. every tile starts on its own cache line and takes the same room
+// however much of it is inside the image, so the renderers, which each write a
+// whole tile of the same size, never write to a line another thread is
+// writing to. rows are bottom up like everywhere else, (0, 0) is the bottom
+// left. each tile also counts how many samples per pixel it holds, so passes
+// of a progressive render can be added in and the count goes along with them.
+// a framebuffer can also be a window onto part of a bigger image: moveTo puts
+// its bottom left at some pixel of the image and every method still takes the
+// image's coordinates, so a renderer can't tell it from the whole frame
+class Framebuffer
+{
+public:
+	// ---- constructors
+	Framebuffer() {}
+
+	Framebuffer(int pWidth, int pHeight, int pTileSize = kFramebufferTileSize)
+		: mWidth(max(pWidth, 0))
+		, mHeight(max(pHeight, 0))
+		, mTileSize(max(pTileSize, 1))
+	{
+		mTilesX = (mWidth + mTileSize - 1) / mTileSize;
+		mTilesY = (mHeight + mTileSize - 1) / mTileSize;
+		mTileStride = alignToCacheLine(static_cast<uint64_t>(mTileSize) * mTileSize * sizeof(FramePixel))
+			/ sizeof(FramePixel);
+		mvTileSamples.assign(static_cast<size_t>(mTilesX) * mTilesY, 0);
+		allocate();
+	}
+
+	Framebuffer(const Framebuffer& pOther) { *this = pOther; }
+	Framebuffer(Framebuffer&& pOther) { *this = move(pOther); }
+
+	Framebuffer& operator=(const Framebuffer& pOther)
+	{
+		if (this == &pOther)
+			return *this;
+
+		mWidth = pOther.mWidth;
+		mHeight = pOther.mHeight;
+		mTileSize = pOther.mTileSize;
+		mTilesX = pOther.mTilesX;
+		mTilesY = pOther.mTilesY;
+		mTileStride = pOther.mTileStride;
+		mX0 = pOther.mX0;
+		mY0 = pOther.mY0;
+		mvTileSamples = pOther.mvTileSamples;
+		allocate();
+		if (pixelCount() > 0)
+			memcpy(mPixels, pOther.mPixels, pixelCount() * sizeof(FramePixel));
+		return *this;
+	}
+
+	// what's moved from is left an empty frame, not one pointing at our pixels
+	Framebuffer& operator=(Framebuffer&& pOther)
+	{
+		if (this == &pOther)
+			return *this;
+
+		mStorage = move(pOther.mStorage);
+		mPixels = pOther.mPixels;
+		mvTileSamples = move(pOther.mvTileSamples);
+		mWidth = pOther.mWidth;
+		mHeight = pOther.mHeight;
+		mTileSize = pOther.mTileSize;
+		mTilesX = pOther.mTilesX;
+		mTilesY = pOther.mTilesY;
+		mTileStride = pOther.mTileStride;
+		mX0 = pOther.mX0;
+		mY0 = pOther.mY0;
+
+		pOther.mPixels = nullptr;
+		pOther.mvTileSamples.clear();
+		pOther.mWidth = pOther.mHeight = 0;
+		pOther.mTilesX = pOther.mTilesY = 0;
+		pOther.mTileStride = 0;
+		pOther.mX0 = pOther.mY0 = 0;
+		return *this;
+	}
+
+	// ---- methods
+	int width() const { return mWidth; }
+	int height() const { return mHeight; }
+	int tileSize() const { return mTileSize; }
+	int tileCount() const { return mTilesX * mTilesY; }
+	bool empty() const { return mWidth == 0 || mHeight == 0; }
+	int x0() const { return mX0; }
+	int y0() const { return mY0; }
+
+	// the window's bottom left pixel in the image. the pixels stay as they are,
+	// the caller clears them if it needs to
+	void moveTo(int pX0, int pY0)
+	{
+		mX0 = pX0;
+		mY0 = pY0;
+	}
+
+	void clear()
+	{
+		memset(static_cast<void*>(mPixels), 0, bytes());
+		setAllTileSamples(0);
+	}
+
+	// what the pixels take, padding included
+	size_t bytes() const { return pixelCount() * sizeof(FramePixel); }
+
+	bool sameLayout(const Framebuffer& pOther) const
+	{
+		return mWidth == pOther.mWidth && mHeight == pOther.mHeight && mTileSize == pOther.mTileSize
+			&& mX0 == pOther.mX0 && mY0 == pOther.mY0;
+	}
+
+	int tileOf(int pX, int pY) const { return ((pY - mY0) / mTileSize) * mTilesX + (pX - mX0) / mTileSize; }
+
+	// a tile's rows are each mTileSize pixels in a row, so a run of pixels
+	// along x from here is contiguous up to the tile's right edge
+	FramePixel& at(int pX, int pY)
+	{
+		return mPixels[offsetOf(pX - mX0, pY - mY0)];
+	}
+
+	const FramePixel& at(int pX, int pY) const
+	{
+		return mPixels[offsetOf(pX - mX0, pY - mY0)];
+	}
+
+	colour get(int pX, int pY) const
+	{
+		const FramePixel& pixel = at(pX, pY);
+		return colour(pixel.r, pixel.g, pixel.b);
+	}
+
+	void set(int pX, int pY, const colour& pSum, Real pSamples)
+	{
+		FramePixel& pixel = at(pX, pY);
+		pixel.r = static_cast<float>(pSum.x());
+		pixel.g = static_cast<float>(pSum.y());
+		pixel.b = static_cast<float>(pSum.z());
+		pixel.a = static_cast<float>(pSamples);
+	}
+
+	void add(int pX, int pY, const colour& pSum, Real pSamples)
+	{
+		FramePixel& pixel = at(pX, pY);
+		pixel.r += static_cast<float>(pSum.x());
+		pixel.g += static_cast<float>(pSum.y());
+		pixel.b += static_cast<float>(pSum.z());
+		pixel.a += static_cast<float>(pSamples);
+	}
+
+	// row pY's sums as width() * 3 Reals, for the writers
+	void readRow(int pY, Real* pRgb) const
+	{
+		for (int i = 0; i < mWidth; ++i)
+		{
+			const FramePixel& pixel = at(mX0 + i, pY);
+			pRgb[i * 3] = pixel.r;
+			pRgb[i * 3 + 1] = pixel.g;
+			pRgb[i * 3 + 2] = pixel.b;
+		}
+	}
+
+	// the samples per pixel of every tile the rectangle [pX0, pX1) x [pY0, pY1)
+	// touches. a renderer's tile is one of ours, so that's the one tile
+	void addTileSamples(int pX0, int pY0, int pX1, int pY1, int pSamples)
+	{
+		for (int ty = (pY0 - mY0) / mTileSize; ty <= (pY1 - 1 - mY0) / mTileSize; ++ty)
+		{
+			for (int tx = (pX0 - mX0) / mTileSize; tx <= (pX1 - 1 - mX0) / mTileSize; ++tx)
+				mvTileSamples[ty * mTilesX + tx] += pSamples;
+		}
+	}
+
+	void setAllTileSamples(int pSamples) { fill(mvTileSamples.begin(), mvTileSamples.end(), pSamples); }
+	int tileSamples(int pTile) const { return mvTileSamples[pTile]; }
+
+	// adds another frame's sums in, pixel by pixel, and its tiles' counts. with
+	// the same layout that's one flat run of floats, padding and all
+	void accumulate(const Framebuffer& pOther)
+	{
+		if (sameLayout(pOther))
+		{
+			float* to = &mPixels[0].r;
+			const float* from = &pOther.mPixels[0].r;
+			const size_t count = pixelCount() * 4;
+			for (size_t i = 0; i < count; ++i)
+				to[i] += from[i];
+			for (size_t t = 0; t < mvTileSamples.size(); ++t)
+				mvTileSamples[t] += pOther.mvTileSamples[t];
+			return;
+		}
+
+		// otherwise whatever of the image both of them cover
+		const int x0 = max(mX0, pOther.mX0), x1 = min(mX0 + mWidth, pOther.mX0 + pOther.mWidth);
+		const int y0 = max(mY0, pOther.mY0), y1 = min(mY0 + mHeight, pOther.mY0 + pOther.mHeight);
+		for (int j = y0; j < y1; ++j)
+		{
+			for (int i = x0; i < x1; ++i)
+			{
+				const FramePixel& pixel = pOther.at(i, j);
+				add(i, j, colour(pixel.r, pixel.g, pixel.b), pixel.a);
+			}
+		}
+		for (int j = mY0; j < mY0 + mHeight; j += mTileSize)
+		{
+			for (int i = mX0; i < mX0 + mWidth; i += mTileSize)
+			{
+				if (i >= x0 && i < x1 && j >= y0 && j < y1)
+					mvTileSamples[tileOf(i, j)] += pOther.tileSamples(pOther.tileOf(i, j));
+			}
+		}
+	}
+
+private:
+	size_t pixelCount() const { return static_cast<size_t>(tileCount()) * mTileStride; }
+
+	// pX and pY from the window's bottom left
+	size_t offsetOf(int pX, int pY) const
+	{
+		const int tile = (pY / mTileSize) * mTilesX + pX / mTileSize;
+		return tile * mTileStride + (pY % mTileSize) * mTileSize + pX % mTileSize;
+	}
+
+	// new[] only promises the alignment of the element type, so ask for an extra
+	// line and start on the first boundary inside it, like CompiledScene does
+	void allocate()
+	{
+		mStorage.reset(new uint8_t[bytes() + kCacheLineSize]);
+		const size_t skip = (kCacheLineSize - reinterpret_cast<uintptr_t>(mStorage.get()) % kCacheLineSize) % kCacheLineSize;
+		mPixels = reinterpret_cast<FramePixel*>(mStorage.get() + skip);
+		memset(static_cast<void*>(mPixels), 0, bytes());
+	}
+
+	// ---- members
+	unique_ptr<uint8_t[]> mStorage;
+	FramePixel* mPixels = nullptr;
+	vector<int> mvTileSamples;
+	int mWidth = 0;
+	int mHeight = 0;
+	int mTileSize = kFramebufferTileSize;
+	int mTilesX = 0;
+	int mTilesY = 0;
+	size_t mTileStride = 0;
+	int mX0 = 0;
+	int mY0 = 0;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !FRAMEBUFFER_H_
\ No newline at end of file
@@ -4,10 +4,18 @@
 // -----------------------------------------------------------------------------
 
 //--INCLUDES--//
-#include "ray.h"
 #include "rtweekend.h"
+#include "AABB.h"
+#include "ray.h"
+#include "RayPacket.h"
+
+#include <cstdint>
+
+// index of a material in the scene's MaterialTable
+typedef uint32_t MaterialId;
 
-class Material;
+// the emitters of a scene, for sampling them directly (see Lights.h)
+class LightList;
 
 // -----------------------------------------------------------------------------
 
@@ -27,24 +35,70 @@ struct HitRecord
 	// ---- members
 	point3 mPoint;
 	vec3 mNormal;
-	shared_ptr<Material> mMatPtr;
-	double mTrace;
+	MaterialId mMaterialId;
+	Real mTrace;
 	bool mFrontFace;
 };
 
+// -----------------------------------------------------------------------------
+
+// lets containers call the concrete hit of the types they know about instead
+// of going through the vtable, anything else is an Other
+enum class HittableType
+{
+	Sphere,
+	Other
+};
+
 // -----------------------------------------------------------------------------
 	
 class Hittable
 {
 public:
 	// ---- constructors
+	Hittable(HittableType pType = HittableType::Other) : mType(pType) {}
+	virtual ~Hittable() {}
 
 	// ---- overrides
 
 	// ---- methods
-	virtual bool hit(const Ray& pRay, double pMinT, double pMaxT, HitRecord& pRecord) const = 0;
+	virtual bool hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const = 0;
+	virtual bool boundingBox(AABB& pOutputBox) const = 0;
+
+	// traces the lanes in pActiveMask together. pMaxT holds each lane's closest
+	// hit so far and is shortened as closer ones turn up, the return value is
+	// the lanes whose record was written. by default the lanes are traced one
+	// at a time, hittables with a real packet path override it
+	virtual int hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+		HitRecord* pRecords) const
+	{
+		int result = 0;
+		for (int lane = 0; lane < RayPacket::kSize; ++lane)
+		{
+			if ((pActiveMask & (1 << lane)) && hit(pPacket.ray(lane), pMinT, pMaxT[lane], pRecords[lane]))
+			{
+				pMaxT[lane] = pRecords[lane].mTrace;
+				result |= 1 << lane;
+			}
+		}
+		return result;
+	}
+
+	// whether anything at all is in the way along pRay in [pMinT, pMaxT], for
+	// shadow rays. which hit it is doesn't matter, so overrides can stop at the
+	// first one they find instead of looking on for a closer one. by default
+	// it's a hit with the record thrown away
+	virtual bool occluded(const Ray& pRay, Real pMinT, Real pMaxT) const
+	{
+		HitRecord record;
+		return hit(pRay, pMinT, pMaxT, record);
+	}
+
+	// the lights in here that can be sampled directly, if it keeps track of them
+	virtual const LightList* lights() const { return nullptr; }
 
 	// ---- members
+	HittableType mType;
 };
 
 
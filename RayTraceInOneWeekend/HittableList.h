@@ -5,6 +5,7 @@
 
 //--INCLUDES--//
 #include "Hittable.h"
+#include "Sphere.h"
 
 #include <memory>
 #include <vector>
@@ -26,7 +27,11 @@ public:
 	void clear() { mvObjects.clear(); }
 	void add(shared_ptr<Hittable> pObject) { mvObjects.push_back(pObject); }
 
-	virtual bool hit(const Ray& pRay, double pMinT, double pMaxT, HitRecord& pRecord) const override;
+	virtual bool hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const override;
+	virtual bool boundingBox(AABB& pOutputBox) const override;
+	virtual int hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+		HitRecord* pRecords) const override;
+	virtual bool occluded(const Ray& pRay, Real pMinT, Real pMaxT) const override;
 
 	// ---- members
 	vector<shared_ptr<Hittable>> mvObjects;
@@ -34,25 +39,80 @@ public:
 
 // -----------------------------------------------------------------------------
 
-bool HittableList::hit(const Ray& pRay, double pMinT, double pMaxT, HitRecord& pRecord) const
+bool HittableList::hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const
 {
-	HitRecord tempRec;
 	bool hitAnything = false;
 	auto closestSoFar = pMaxT;
 
+	// objects only write the record when they report a closer hit, so it can
+	// go straight into pRecord without a copy per hit. spheres skip the vtable
 	for (const auto& object : mvObjects)
 	{
-		if (object->hit(pRay, pMinT, closestSoFar, tempRec))
+		const bool hitObject = object->mType == HittableType::Sphere
+			? static_cast<const Sphere&>(*object).Sphere::hit(pRay, pMinT, closestSoFar, pRecord)
+			: object->hit(pRay, pMinT, closestSoFar, pRecord);
+
+		if (hitObject)
 		{
 			hitAnything = true;
-			closestSoFar = tempRec.mTrace;
-			pRecord = tempRec;
+			closestSoFar = pRecord.mTrace;
 		}
 	}
 
 	return hitAnything;
 }
 
+// -----------------------------------------------------------------------------
+
+int HittableList::hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+	HitRecord* pRecords) const
+{
+	int result = 0;
+	for (const auto& object : mvObjects)
+	{
+		result |= object->mType == HittableType::Sphere
+			? static_cast<const Sphere&>(*object).Sphere::hitPacket(pPacket, pActiveMask, pMinT, pMaxT, pRecords)
+			: object->hitPacket(pPacket, pActiveMask, pMinT, pMaxT, pRecords);
+	}
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+
+bool HittableList::occluded(const Ray& pRay, Real pMinT, Real pMaxT) const
+{
+	for (const auto& object : mvObjects)
+	{
+		const bool blocked = object->mType == HittableType::Sphere
+			? static_cast<const Sphere&>(*object).Sphere::occluded(pRay, pMinT, pMaxT)
+			: object->occluded(pRay, pMinT, pMaxT);
+
+		if (blocked)
+			return true;
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+bool HittableList::boundingBox(AABB& pOutputBox) const
+{
+	if (mvObjects.empty())
+		return false;
+
+	AABB tempBox;
+	pOutputBox = AABB();
+
+	for (const auto& object : mvObjects)
+	{
+		if (!object->boundingBox(tempBox))
+			return false;
+		pOutputBox.grow(tempBox);
+	}
+
+	return true;
+}
+
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -0,0 +1,359 @@
+// -----------------------------------------------------------------------------
+#ifndef IMAGE_WRITER_H_
+#define IMAGE_WRITER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "colour.h"
+#include "Framebuffer.h"
+#include "rtweekend.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// P3 is the original ascii ppm written through writeColour, the rest are built
+// up in memory and written in one go
+enum class ImageFormat
+{
+	P3,		// ascii ppm
+	P6,		// binary ppm
+	Pfm,	// float rgb, no gamma and no clamping
+	Qoi		// the quite ok image format, lossless and a lot smaller than ppm
+};
+
+// -----------------------------------------------------------------------------
+
+const char* imageFormatName(ImageFormat pFormat)
+{
+	switch (pFormat)
+	{
+	case ImageFormat::P3: return "p3";
+	case ImageFormat::P6: return "ppm";
+	case ImageFormat::Pfm: return "pfm";
+	case ImageFormat::Qoi: return "qoi";
+	}
+	return "";
+}
+
+// -----------------------------------------------------------------------------
+
+const char* imageFormatExtension(ImageFormat pFormat)
+{
+	switch (pFormat)
+	{
+	case ImageFormat::P3: return ".ppm";
+	case ImageFormat::P6: return ".ppm";
+	case ImageFormat::Pfm: return ".pfm";
+	case ImageFormat::Qoi: return ".qoi";
+	}
+	return "";
+}
+
+// -----------------------------------------------------------------------------
+
+bool imageFormatFromName(const string& pName, ImageFormat& pFormat)
+{
+	const ImageFormat formats[] = { ImageFormat::P3, ImageFormat::P6, ImageFormat::Pfm, ImageFormat::Qoi };
+	for (ImageFormat format : formats)
+	{
+		if (pName == imageFormatName(format))
+		{
+			pFormat = format;
+			return true;
+		}
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+// the rows are stored bottom up (row j is v = j / (height - 1)), but ppm and qoi
+// want the top row first. the maths matches writeColour, a gamma of 2 then
+// [0, 255]. each row is read out as a flat run of Reals so it goes through
+// simd lanes
+void quantiseImage(const Framebuffer& pPixels, int pSamplesPerPixel, ThreadPool& pPool, vector<uint8_t>& pOut)
+{
+	const size_t height = pPixels.height();
+	const size_t width = pPixels.width();
+	const size_t rowValues = width * 3;
+	pOut.resize(height * rowValues);
+
+	const SimdReal scale(Real(1.0) / pSamplesPerPixel);
+	const SimdReal zero(Real(0.0));
+	const SimdReal top(Real(0.999));
+	const SimdReal range(Real(256.0));
+
+	pPool.parallelFor(height, 8, [&](size_t pBegin, size_t pEnd)
+	{
+		Real lanes[kSimdWidth];
+		vector<Real> values(rowValues);
+		for (size_t row = pBegin; row < pEnd; ++row)
+		{
+			pPixels.readRow(static_cast<int>(height - 1 - row), values.data());
+			const Real* in = values.data();
+			uint8_t* out = pOut.data() + row * rowValues;
+
+			size_t i = 0;
+			for (; i + kSimdWidth <= rowValues; i += kSimdWidth)
+			{
+				const SimdReal value = min(sqrt(max(SimdReal::load(in + i) * scale, zero)), top) * range;
+				value.store(lanes);
+				for (int lane = 0; lane < kSimdWidth; ++lane)
+					out[i + lane] = static_cast<uint8_t>(lanes[lane]);
+			}
+			for (; i < rowValues; ++i)
+				out[i] = static_cast<uint8_t>(256 * clamp(sqrt(fmax(double(in[i]) / pSamplesPerPixel, 0.0)), 0.0, 0.999));
+		}
+	});
+}
+
+// -----------------------------------------------------------------------------
+
+void encodeP6(const vector<uint8_t>& pRgb, int pWidth, int pHeight, vector<uint8_t>& pOut)
+{
+	const string header = "P6\n" + to_string(pWidth) + ' ' + to_string(pHeight) + "\n255\n";
+	pOut.resize(header.size() + pRgb.size());
+	memcpy(pOut.data(), header.data(), header.size());
+	memcpy(pOut.data() + header.size(), pRgb.data(), pRgb.size());
+}
+
+// -----------------------------------------------------------------------------
+
+// https://qoiformat.org/qoi-specification.pdf
+void encodeQoi(const vector<uint8_t>& pRgb, int pWidth, int pHeight, vector<uint8_t>& pOut)
+{
+	struct Pixel { uint8_t r, g, b, a; };
+
+	auto put32 = [&](uint32_t pValue)
+	{
+		pOut.push_back(static_cast<uint8_t>(pValue >> 24));
+		pOut.push_back(static_cast<uint8_t>(pValue >> 16));
+		pOut.push_back(static_cast<uint8_t>(pValue >> 8));
+		pOut.push_back(static_cast<uint8_t>(pValue));
+	};
+
+	pOut.clear();
+	pOut.reserve(14 + pRgb.size() / 2 + 8);
+	pOut.insert(pOut.end(), { 'q', 'o', 'i', 'f' });
+	put32(static_cast<uint32_t>(pWidth));
+	put32(static_cast<uint32_t>(pHeight));
+	pOut.push_back(3);	// channels
+	pOut.push_back(0);	// srgb with linear alpha
+
+	Pixel seen[64] = {};
+	Pixel previous = { 0, 0, 0, 255 };
+	int run = 0;
+
+	const size_t count = pRgb.size() / 3;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Pixel pixel = { pRgb[i * 3], pRgb[i * 3 + 1], pRgb[i * 3 + 2], 255 };
+		const bool same = pixel.r == previous.r && pixel.g == previous.g && pixel.b == previous.b;
+
+		if (same)
+		{
+			++run;
+			if (run == 62 || i + 1 == count)
+			{
+				pOut.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			pOut.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+			run = 0;
+		}
+
+		const int hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+		const Pixel& cached = seen[hash];
+		if (cached.r == pixel.r && cached.g == pixel.g && cached.b == pixel.b && cached.a == pixel.a)
+		{
+			pOut.push_back(static_cast<uint8_t>(hash));
+		}
+		else
+		{
+			seen[hash] = pixel;
+
+			// differences wrap around, so they're taken as signed bytes
+			const int dr = static_cast<int8_t>(pixel.r - previous.r);
+			const int dg = static_cast<int8_t>(pixel.g - previous.g);
+			const int db = static_cast<int8_t>(pixel.b - previous.b);
+			const int drdg = dr - dg;
+			const int dbdg = db - dg;
+
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+			{
+				pOut.push_back(static_cast<uint8_t>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+			}
+			else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7)
+			{
+				pOut.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+				pOut.push_back(static_cast<uint8_t>((drdg + 8) << 4 | (dbdg + 8)));
+			}
+			else
+			{
+				pOut.push_back(0xfe);
+				pOut.push_back(pixel.r);
+				pOut.push_back(pixel.g);
+				pOut.push_back(pixel.b);
+			}
+		}
+
+		previous = pixel;
+	}
+
+	pOut.insert(pOut.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+}
+
+// -----------------------------------------------------------------------------
+
+// pfm keeps the averaged radiance as it is. rows go bottom up in pfm too, and
+// the negative scale says the floats are little endian
+void encodePfm(const Framebuffer& pPixels, int pSamplesPerPixel, ThreadPool& pPool, vector<uint8_t>& pOut)
+{
+	const size_t height = pPixels.height();
+	const size_t width = pPixels.width();
+	const string header = "PF\n" + to_string(width) + ' ' + to_string(height) + "\n-1.0\n";
+
+	pOut.resize(header.size() + height * width * 3 * sizeof(float));
+	memcpy(pOut.data(), header.data(), header.size());
+
+	const double scale = 1.0 / pSamplesPerPixel;
+	pPool.parallelFor(height, 8, [&](size_t pBegin, size_t pEnd)
+	{
+		vector<Real> sums(width * 3);
+		vector<float> values(width * 3);
+		for (size_t row = pBegin; row < pEnd; ++row)
+		{
+			pPixels.readRow(static_cast<int>(row), sums.data());
+			for (size_t i = 0; i < values.size(); ++i)
+				values[i] = static_cast<float>(sums[i] * scale);
+			memcpy(pOut.data() + header.size() + row * width * 3 * sizeof(float),
+				values.data(), values.size() * sizeof(float));
+		}
+	});
+}
+
+// -----------------------------------------------------------------------------
+
+// the original output, one pixel at a time through ostream
+void writeP3(ostream& pOut, const Framebuffer& pPixels, int pSamplesPerPixel)
+{
+	pOut << "P3\n" << pPixels.width() << ' ' << pPixels.height() << "\n255\n";
+
+	for (int row = pPixels.height() - 1; row >= 0; --row)
+	{
+		for (int i = 0; i < pPixels.width(); ++i)
+			writeColour(pOut, pPixels.get(i, row), pSamplesPerPixel);
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// builds the whole file in pOut. pixels hold the sum of pSamplesPerPixel samples
+void encodeImage(ImageFormat pFormat, const Framebuffer& pPixels, int pSamplesPerPixel, ThreadPool& pPool,
+	vector<uint8_t>& pOut)
+{
+	const int height = pPixels.height();
+	const int width = pPixels.width();
+
+	switch (pFormat)
+	{
+	case ImageFormat::P3:
+	{
+		ostringstream text;
+		writeP3(text, pPixels, pSamplesPerPixel);
+		const string data = text.str();
+		pOut.assign(data.begin(), data.end());
+		break;
+	}
+	case ImageFormat::P6:
+	case ImageFormat::Qoi:
+	{
+		vector<uint8_t> rgb;
+		quantiseImage(pPixels, pSamplesPerPixel, pPool, rgb);
+		if (pFormat == ImageFormat::P6)
+			encodeP6(rgb, width, height, pOut);
+		else
+			encodeQoi(rgb, width, height, pOut);
+		break;
+	}
+	case ImageFormat::Pfm:
+		encodePfm(pPixels, pSamplesPerPixel, pPool, pOut);
+		break;
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+bool writeImage(const string& pPath, ImageFormat pFormat, const Framebuffer& pPixels, int pSamplesPerPixel)
+{
+	ofstream file(pPath, ios::binary);
+	if (!file)
+		return false;
+
+	// p3 goes straight to the file as it always has
+	if (pFormat == ImageFormat::P3)
+	{
+		writeP3(file, pPixels, pSamplesPerPixel);
+		return static_cast<bool>(file);
+	}
+
+	ThreadPool pool;
+	vector<uint8_t> data;
+	encodeImage(pFormat, pPixels, pSamplesPerPixel, pool, data);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return static_cast<bool>(file);
+}
+
+// -----------------------------------------------------------------------------
+
+// a false colour binary ppm of pValues, rows bottom up like the render. 0 is
+// black, then it runs through blue, green and yellow up to white at pMaxValue
+bool writeHeatmap(const string& pPath, const vector<vector<double>>& pValues, double pMaxValue)
+{
+	const colour ramp[] = { colour(0, 0, 0), colour(0, 0, 1), colour(0, 1, 0), colour(1, 1, 0), colour(1, 1, 1) };
+	const int steps = sizeof(ramp) / sizeof(ramp[0]) - 1;
+
+	const int height = static_cast<int>(pValues.size());
+	const int width = height > 0 ? static_cast<int>(pValues[0].size()) : 0;
+
+	vector<uint8_t> rgb;
+	rgb.reserve(static_cast<size_t>(width) * height * 3);
+	for (int j = height - 1; j >= 0; --j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const double t = clamp(pMaxValue > 0.0 ? pValues[j][i] / pMaxValue : 0.0, 0.0, 1.0) * steps;
+			const int step = min(static_cast<int>(t), steps - 1);
+			const colour c = ramp[step] + (t - step) * (ramp[step + 1] - ramp[step]);
+			for (int k = 0; k < 3; ++k)
+				rgb.push_back(static_cast<uint8_t>(255.0 * c[k] + 0.5));
+		}
+	}
+
+	vector<uint8_t> data;
+	encodeP6(rgb, width, height, data);
+
+	ofstream file(pPath, ios::binary);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return static_cast<bool>(file);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !IMAGE_WRITER_H_
\ No newline at end of file
@@ -0,0 +1,266 @@
+// -----------------------------------------------------------------------------
+#ifndef INTEGRATOR_H_
+#define INTEGRATOR_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "Hittable.h"
+#include "Lights.h"
+#include "Material.h"
+#include "RenderSettings.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// how many paths were traced in a frame and how many rays they were made of,
+// added to by every thread. the tiled renderers can also say where the time
+// went: each tile's seconds, and each pixel's if mPixelSeconds is sized to the
+// image before the frame starts
+struct PathStats
+{
+	// ---- methods
+	void add(uint64_t pPaths, uint64_t pSegments)
+	{
+		mPaths += pPaths;
+		mSegments += pSegments;
+	}
+
+	double averageLength() const
+	{
+		return mPaths > 0 ? static_cast<double>(mSegments) / mPaths : 0.0;
+	}
+
+	bool timesPixels() const { return !mPixelSeconds.empty(); }
+
+	// ---- members
+	atomic<uint64_t> mPaths{ 0 };
+	atomic<uint64_t> mSegments{ 0 };
+
+	vector<Tile> mvTiles;
+	vector<double> mvTileSeconds;
+	vector<vector<double>> mPixelSeconds;
+};
+
+// -----------------------------------------------------------------------------
+
+// what a camera ray saw first, the guides for the denoiser. a ray that hits
+// nothing sees the sky as its albedo and has no normal or depth
+struct FirstHit
+{
+	// ---- members
+	colour mAlbedo;
+	vec3 mNormal;
+	Real mDepth = 0.0;
+};
+
+// -----------------------------------------------------------------------------
+
+colour skyColour(const Ray& pRay)
+{
+	vec3 unitDirection = unitVector(pRay.direction());
+	auto t = 0.5 * (unitDirection.y() + 1.0);
+	return (1.0 - t) * colour(1.0, 1.0, 1.0) + t * colour(0.5, 0.7, 1.0);
+}
+
+// -----------------------------------------------------------------------------
+
+// russian roulette on a path that has just bounced for the pBounce'th time.
+// once its throughput drops below the threshold it survives with probability
+// throughput / threshold, and survivors are scaled up by the same amount so
+// the expected value doesn't change. doesn't touch pSampler when it's switched off
+bool survivesRoulette(colour& pThroughput, int pBounce, const RenderSettings& pSettings, Sampler& pSampler)
+{
+	if (!pSettings.mRussianRoulette || pBounce < pSettings.mRouletteMinBounces)
+		return true;
+
+	const Real strength = max(pThroughput.x(), max(pThroughput.y(), pThroughput.z()));
+	if (strength >= pSettings.mRouletteThreshold)
+		return true;
+
+	const Real survival = strength / pSettings.mRouletteThreshold;
+	pSampler.setDimension(bounceDimension(pBounce - 1) + kRouletteDimension);
+	if (pSampler.get1D() >= survival)
+		return false;
+
+	pThroughput /= survival;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// the lights a path can send shadow rays to, or null if it can't
+inline const LightList* sampledLights(const Hittable& pWorld, const RenderSettings& pSettings)
+{
+	const LightList* lights = pSettings.mLightSampling ? pWorld.lights() : nullptr;
+	return lights && !lights->empty() ? lights : nullptr;
+}
+
+// the pdf a lambertian bounce off pNormal has of going along pDirection
+inline Real lambertianPdf(const vec3& pNormal, const vec3& pDirection)
+{
+	return fmax(dot(pNormal, unitVector(pDirection)), Real(0)) / kPi;
+}
+
+// next event estimation at a lambertian hit: one light and a direction toward
+// it from the light's dimensions of this bounce, and if nothing is in the way,
+// the light that comes back along it off pMaterial. it's weighted against the
+// chance the bounce itself would have gone the same way, the bounce that hits
+// the light gets the rest (see tracePath)
+colour sampleLight(const HitRecord& pRecord, const Material& pMaterial, const Hittable& pWorld,
+	const LightList& pLights, Span<const Material> pMaterials, Sampler& pSampler, int pBounce)
+{
+	pSampler.setDimension(bounceDimension(pBounce) + kLightDimension);
+	const Real pick = pSampler.get1D();
+	Real u, v;
+	pSampler.get2D(u, v);
+
+	LightSample sample;
+	if (!pLights.sample(pRecord.mPoint, pick, u, v, sample))
+		return colour(0, 0, 0);
+
+	const Real cosine = dot(pRecord.mNormal, sample.mDirection);
+	if (cosine <= 0)
+		return colour(0, 0, 0);
+
+	// stopped just short of the light, or it would be in its own way
+	RT_STAT(threadStats().mShadowRays++);
+	const Ray shadow(pRecord.mPoint, sample.mDirection);
+	if (pWorld.occluded(shadow, minHitT(shadow), sample.mDistance * (1 - kRelativeMinRayT)))
+	{
+		RT_STAT(threadStats().mShadowsBlocked++);
+		return colour(0, 0, 0);
+	}
+
+	// a lambertian's brdf is albedo / pi
+	const Real weight = powerHeuristic(sample.mPdf, cosine / kPi);
+	return pMaterial.mAlbedo * DiffuseLight::emitted(pMaterials[sample.mMaterialId])
+		* (weight * cosine / (kPi * sample.mPdf));
+}
+
+// what a path picks up when it runs into a light. if the bounce before could
+// have sampled the light as well it only gets its share of it, pScatterPdf is
+// that bounce's pdf and 0 when it couldn't (a camera ray, a mirror, a glass)
+colour emittedAlongPath(const Material& pMaterial, const HitRecord& pRecord, const LightList* pLights,
+	Real pScatterPdf, const point3& pScatterOrigin)
+{
+	Real weight = 1;
+	if (pLights && pScatterPdf > 0)
+		weight = powerHeuristic(pScatterPdf, pLights->pdf(pScatterOrigin, pRecord));
+	return DiffuseLight::emitted(pMaterial) * weight;
+}
+
+// -----------------------------------------------------------------------------
+
+// the light arriving back along pRay. the path is followed in a loop carrying
+// the product of the attenuations so far, rather than recursing once per bounce.
+// hits name their material by id in pMaterials. pSegments counts the rays
+// traced, and pFirstHit lets a caller that already intersected pRay (the
+// packet renderer) skip the first trace. pAovs gets what the first hit was.
+// lights are found both ways, by the bounces running into them and by a
+// shadow ray from every diffuse bounce, see sampleLight()
+colour tracePath(
+	const Ray& pRay,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	const RenderSettings& pSettings,
+	Sampler& pSampler,
+	int* pSegments = nullptr,
+	const HitRecord* pFirstHit = nullptr,
+	FirstHit* pAovs = nullptr)
+{
+	Ray ray = pRay;
+	colour throughput(1.0, 1.0, 1.0);
+	int segments = 0;
+	colour result(0, 0, 0);
+
+	const LightList* lights = sampledLights(pWorld, pSettings);
+	Real scatterPdf = 0;
+	point3 scatterOrigin;
+
+	// if we've exceeded the ray bounce limit, no more light it gathered
+	bool finished = false;
+	for (int bounce = 0; bounce < pSettings.mMaxDepth; ++bounce)
+	{
+		RT_STAT(bounce == 0 ? threadStats().mPrimaryRays++ : threadStats().mSecondaryRays++);
+		++segments;
+
+		HitRecord rec;
+		if (bounce == 0 && pFirstHit)
+		{
+			rec = *pFirstHit;
+		}
+		else if (!pWorld.hit(ray, minHitT(ray), gInfinity, rec))
+		{
+			RT_STAT(threadStats().mEscaped++);
+			const colour sky = throughput * skyColour(ray);
+			result += sky;
+			if (bounce == 0 && pAovs)
+				pAovs->mAlbedo = sky;
+			finished = true;
+			break;
+		}
+
+		const Material& material = pMaterials[rec.mMaterialId];
+		if (bounce == 0 && pAovs)
+		{
+			pAovs->mAlbedo = material.mAlbedo;
+			pAovs->mNormal = rec.mNormal;
+			pAovs->mDepth = rec.mTrace * ray.direction().length();
+		}
+
+		if (material.mType == MaterialType::DiffuseLight)
+			result += throughput * emittedAlongPath(material, rec, lights, scatterPdf, scatterOrigin);
+		else if (lights && material.mType == MaterialType::Lambertian)
+			result += throughput * sampleLight(rec, material, pWorld, *lights, pMaterials, pSampler, bounce);
+
+		Ray scattered;
+		colour attenuation;
+		RT_STAT(threadStats().mScatters[static_cast<int>(material.mType)]++);
+		pSampler.setDimension(bounceDimension(bounce));
+		if (!material.scatter(ray, rec, attenuation, scattered, pSampler))
+		{
+			RT_STAT(threadStats().mAbsorbed++);
+			finished = true;
+			break;
+		}
+
+		if (lights)
+		{
+			scatterPdf = material.mType == MaterialType::Lambertian ? lambertianPdf(rec.mNormal, scattered.direction()) : 0;
+			scatterOrigin = rec.mPoint;
+		}
+
+		throughput = throughput * attenuation;
+		ray = scattered;
+
+		if (!survivesRoulette(throughput, bounce + 1, pSettings, pSampler))
+		{
+			RT_STAT(threadStats().mRouletteKilled++);
+			finished = true;
+			break;
+		}
+	}
+
+	// anything that didn't stop on its own ran into the depth limit
+	RT_STAT(threadStats().countPath(segments));
+	RT_STAT(finished ? 0 : threadStats().mDepthLimited++);
+	(void)finished;
+
+	if (pSegments)
+		*pSegments += segments;
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !INTEGRATOR_H_
\ No newline at end of file
@@ -0,0 +1,141 @@
+// -----------------------------------------------------------------------------
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// writes json straight to a stream, just enough of it for reports that other
+// tools read back in. it keeps track of where the commas go and indents nested
+// objects and arrays, the caller is trusted to open and close them in order
+class JsonWriter
+{
+public:
+	// ---- constructors
+	JsonWriter(ostream& pOut) : mOut(pOut) {}
+
+	// ---- methods
+	JsonWriter& beginObject() { return open('{'); }
+	JsonWriter& endObject() { return close('}'); }
+	JsonWriter& beginArray() { return open('['); }
+	JsonWriter& endArray() { return close(']'); }
+
+	// the next value written goes under pName in the current object
+	JsonWriter& key(const string& pName)
+	{
+		separate();
+		writeString(pName);
+		mOut << ": ";
+		mAfterKey = true;
+		return *this;
+	}
+
+	JsonWriter& value(const string& pValue) { separate(); writeString(pValue); return *this; }
+	JsonWriter& value(const char* pValue) { return value(string(pValue)); }
+	JsonWriter& value(bool pValue) { separate(); mOut << (pValue ? "true" : "false"); return *this; }
+	JsonWriter& value(int pValue) { separate(); mOut << pValue; return *this; }
+	JsonWriter& value(unsigned int pValue) { separate(); mOut << pValue; return *this; }
+	JsonWriter& value(int64_t pValue) { separate(); mOut << pValue; return *this; }
+	JsonWriter& value(uint64_t pValue) { separate(); mOut << pValue; return *this; }
+
+	// json has no nan or infinity, they come out as null
+	JsonWriter& value(double pValue)
+	{
+		separate();
+		if (std::isfinite(pValue))
+			mOut << setprecision(10) << pValue;
+		else
+			mOut << "null";
+		return *this;
+	}
+
+	template<typename T>
+	JsonWriter& field(const string& pName, const T& pValue) { return key(pName).value(pValue); }
+
+private:
+	JsonWriter& open(char pBracket)
+	{
+		separate();
+		mOut << pBracket;
+		mvFirst.push_back(true);
+		return *this;
+	}
+
+	JsonWriter& close(char pBracket)
+	{
+		const bool empty = mvFirst.back();
+		mvFirst.pop_back();
+		if (!empty)
+			newline();
+		mOut << pBracket;
+		if (mvFirst.empty())
+			mOut << '\n';
+		return *this;
+	}
+
+	// a value straight after its key stays on the key's line, anything else
+	// inside an object or array goes on a new line after a comma
+	void separate()
+	{
+		if (mAfterKey)
+		{
+			mAfterKey = false;
+			return;
+		}
+		if (mvFirst.empty())
+			return;
+
+		if (!mvFirst.back())
+			mOut << ',';
+		mvFirst.back() = false;
+		newline();
+	}
+
+	void newline()
+	{
+		mOut << '\n';
+		for (size_t i = 0; i < mvFirst.size(); ++i)
+			mOut << "  ";
+	}
+
+	void writeString(const string& pText)
+	{
+		mOut << '"';
+		for (char c : pText)
+		{
+			switch (c)
+			{
+			case '"': mOut << "\\\""; break;
+			case '\\': mOut << "\\\\"; break;
+			case '\n': mOut << "\\n"; break;
+			case '\t': mOut << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					mOut << "\\u00" << hex << setw(2) << setfill('0') << static_cast<int>(c) << dec << setfill(' ');
+				else
+					mOut << c;
+			}
+		}
+		mOut << '"';
+	}
+
+	// ---- members
+	ostream& mOut;
+	vector<bool> mvFirst;
+	bool mAfterKey = false;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !JSON_WRITER_H_
\ No newline at end of file
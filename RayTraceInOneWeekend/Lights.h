@@ -0,0 +1,148 @@
+// -----------------------------------------------------------------------------
+#ifndef LIGHTS_H_
+#define LIGHTS_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "Hittable.h"
+#include "Span.h"
+#include "Warps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a sphere with a DiffuseLight for its material. mSlot is where the scene that
+// found it keeps the sphere, so it can follow the sphere when that moves.
+// scenes keep these in their arena, so it's copied as raw bytes
+struct SphereLight
+{
+	point3 mCenter;
+	Real mRadius;
+	MaterialId mMaterialId;
+	uint32_t mSlot;
+};
+
+// a direction toward a light from some point, how far along it the light's
+// surface is, and the pdf of having picked it, over solid angle and with the
+// choice of light in it
+struct LightSample
+{
+	vec3 mDirection;
+	Real mDistance;
+	Real mPdf;
+	MaterialId mMaterialId;
+};
+
+// -----------------------------------------------------------------------------
+
+// veach's power heuristic with beta = 2, the weight for a sample drawn with
+// pdf pA when pB could also have drawn it
+inline Real powerHeuristic(Real pA, Real pB)
+{
+	const Real a2 = pA * pA;
+	const Real b2 = pB * pB;
+	return a2 + b2 > 0 ? a2 / (a2 + b2) : Real(0);
+}
+
+// -----------------------------------------------------------------------------
+
+// the emitters of a scene, for next event estimation. a light is picked
+// uniformly and then a direction inside the cone it fills as seen from the
+// shading point, so every direction drawn hits the sphere and the pdf is one
+// over the cone's solid angle. nothing's drawn from inside a light. the list
+// only looks at lights someone else keeps, a CompiledScene's light section
+class LightList
+{
+public:
+	// ---- constructors
+	LightList() {}
+	LightList(Span<const SphereLight> pLights) : mLights(pLights) {}
+
+	// ---- methods
+	bool empty() const { return mLights.empty(); }
+	size_t size() const { return mLights.size(); }
+	const SphereLight& operator[](size_t pIndex) const { return mLights[pIndex]; }
+
+	// pPick chooses the light and pU, pV the direction, all in [0, 1)
+	bool sample(const point3& pFrom, Real pPick, Real pU, Real pV, LightSample& pSample) const
+	{
+		if (mLights.empty())
+			return false;
+
+		const size_t index = min(static_cast<size_t>(pPick * mLights.size()), mLights.size() - 1);
+		const SphereLight& light = mLights[index];
+
+		const vec3 toCenter = light.mCenter - pFrom;
+		const Real distanceSquared = toCenter.lengthSquared();
+		const Real radiusSquared = light.mRadius * light.mRadius;
+		if (distanceSquared <= radiusSquared)
+			return false;
+
+		// 1 - cos of the cone's half angle straight from sin^2, which keeps its
+		// bits for far away lights where cos is all but 1
+		const Real sinSquared = radiusSquared / distanceSquared;
+		const Real oneMinusCosMax = sinSquared / (1 + sqrt(1 - sinSquared));
+
+		const Real oneMinusCos = pU * oneMinusCosMax;
+		const Real cosTheta = 1 - oneMinusCos;
+		const Real sinTheta = sqrt(max(Real(0), oneMinusCos * (2 - oneMinusCos)));
+		Real sinPhi, cosPhi;
+		sinCosTurns(pV, sinPhi, cosPhi);
+
+		const vec3 w = toCenter / sqrt(distanceSquared);
+		const vec3 a = fabs(w.x()) > 0.9 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+		const vec3 u = unitVector(cross(a, w));
+		const vec3 v = cross(w, u);
+		pSample.mDirection = (sinTheta * cosPhi) * u + (sinTheta * sinPhi) * v + cosTheta * w;
+
+		// the near side of the sphere along it. inside the cone the
+		// discriminant can only come out below 0 by rounding
+		const Real halfB = dot(toCenter, pSample.mDirection);
+		const Real discriminant = max(Real(0), halfB * halfB - (distanceSquared - radiusSquared));
+		pSample.mDistance = halfB - sqrt(discriminant);
+		pSample.mPdf = conePdf(oneMinusCosMax) / mLights.size();
+		pSample.mMaterialId = light.mMaterialId;
+		return true;
+	}
+
+	// the pdf sample() has of the direction from pFrom that ended at pRecord,
+	// or 0 if what it hit isn't one of these lights
+	Real pdf(const point3& pFrom, const HitRecord& pRecord) const
+	{
+		for (const SphereLight& light : mLights)
+		{
+			if (light.mMaterialId != pRecord.mMaterialId)
+				continue;
+
+			const Real radius = fabs(light.mRadius);
+			if (fabs((pRecord.mPoint - light.mCenter).length() - radius) > 1e-3 * radius)
+				continue;
+
+			const Real distanceSquared = (light.mCenter - pFrom).lengthSquared();
+			const Real radiusSquared = radius * radius;
+			if (distanceSquared <= radiusSquared)
+				return 0;
+
+			const Real sinSquared = radiusSquared / distanceSquared;
+			return conePdf(sinSquared / (1 + sqrt(1 - sinSquared))) / mLights.size();
+		}
+		return 0;
+	}
+
+private:
+	static Real conePdf(Real pOneMinusCosMax) { return 1 / (2 * kPi * pOneMinusCosMax); }
+
+	// ---- members
+	Span<const SphereLight> mLights;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !LIGHTS_H_
\ No newline at end of file
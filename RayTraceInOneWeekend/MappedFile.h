@@ -0,0 +1,223 @@
+// -----------------------------------------------------------------------------
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a whole file mapped read only into memory. nothing is read up front, pages
+// come in from the os cache the first time they're touched, and the mapping
+// always starts on a page boundary. create() makes a new file of a given size
+// and maps it for writing instead, what's written goes back to the file
+class MappedFile
+{
+public:
+	// ---- constructors
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// ---- methods
+	bool open(const string& pPath)
+	{
+		close();
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(pPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			return false;
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!data)
+			return false;
+
+		mData = static_cast<const uint8_t*>(data);
+		mSize = static_cast<size_t>(size.QuadPart);
+#else
+		const int file = ::open(pPath.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		// the mapping keeps its own reference to the file
+		void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (data == MAP_FAILED)
+			return false;
+
+		mData = static_cast<const uint8_t*>(data);
+		mSize = static_cast<size_t>(info.st_size);
+#endif
+		return true;
+	}
+
+	// a new file of pSize bytes at pPath, replacing whatever was there. the
+	// file is sparse until it's written to, so this is quick however big it is
+	bool create(const string& pPath, size_t pSize)
+	{
+		close();
+		if (pSize == 0)
+			return false;
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(pPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		// the mapping sets the file's size
+		const uint64_t size = pSize;
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+			static_cast<DWORD>(size), nullptr);
+		CloseHandle(file);
+		if (!mapping)
+			return false;
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!data)
+			return false;
+#else
+		const int file = ::open(pPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (file < 0)
+			return false;
+
+		if (ftruncate(file, static_cast<off_t>(pSize)) != 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		void* data = mmap(nullptr, pSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		::close(file);
+		if (data == MAP_FAILED)
+			return false;
+#endif
+		mData = static_cast<const uint8_t*>(data);
+		mSize = pSize;
+		mWritable = true;
+		return true;
+	}
+
+	// starts writing [pOffset, pOffset + pSize) back to the file, and with pWait
+	// doesn't return until it's there
+	bool flush(size_t pOffset, size_t pSize, bool pWait)
+	{
+		if (!mWritable || pSize == 0)
+			return true;
+
+		size_t begin, end;
+		pageRange(pOffset, pSize, begin, end);
+#if defined(_WIN32)
+		(void)pWait;
+		return FlushViewOfFile(mData + begin, end - begin) != 0;
+#else
+		return msync(const_cast<uint8_t*>(mData) + begin, end - begin, pWait ? MS_SYNC : MS_ASYNC) == 0;
+#endif
+	}
+
+	// lets the os take the pages of [pOffset, pOffset + pSize) out of memory.
+	// it's a shared mapping, so nothing written is lost: the next touch reads
+	// the page back from the file or whatever the os still has cached
+	void release(size_t pOffset, size_t pSize)
+	{
+		if (!mData || pSize == 0)
+			return;
+
+		size_t begin, end;
+		pageRange(pOffset, pSize, begin, end);
+#if defined(_WIN32)
+		// unlocking pages that aren't locked drops them from the working set
+		VirtualUnlock(const_cast<uint8_t*>(mData) + begin, end - begin);
+#else
+		madvise(const_cast<uint8_t*>(mData) + begin, end - begin, MADV_DONTNEED);
+#endif
+	}
+
+	void close()
+	{
+		if (!mData)
+			return;
+
+#if defined(_WIN32)
+		UnmapViewOfFile(mData);
+#else
+		munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+		mData = nullptr;
+		mSize = 0;
+		mWritable = false;
+	}
+
+	const uint8_t* data() const { return mData; }
+	uint8_t* writableData() { return mWritable ? const_cast<uint8_t*>(mData) : nullptr; }
+	size_t size() const { return mSize; }
+	bool isOpen() const { return mData != nullptr; }
+
+private:
+	// the whole pages around [pOffset, pOffset + pSize), clipped to the file
+	void pageRange(size_t pOffset, size_t pSize, size_t& pBegin, size_t& pEnd) const
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		const size_t page = info.dwPageSize;
+#else
+		const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		pBegin = pOffset - pOffset % page;
+		pEnd = min(mSize, pOffset + pSize);
+	}
+
+	// ---- members
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+	bool mWritable = false;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !MAPPED_FILE_H_
\ No newline at end of file
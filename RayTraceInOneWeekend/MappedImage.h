@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------------
+#ifndef MAPPED_IMAGE_H_
+#define MAPPED_IMAGE_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "Framebuffer.h"
+#include "ImageWriter.h"
+#include "MappedFile.h"
+#include "rtweekend.h"
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// an output file that the renderers write into tile by tile, for frames too
+// big to keep in memory. the whole file, header and all, is mapped and each
+// tile goes straight to its place in it as soon as it's rendered, so the file
+// is the framebuffer and there's nothing to write out at the end. only pfm and
+// binary ppm work, they're the formats where a pixel is always in the same
+// place. every tile's rows are flushed once it's in, and when a band of tiles
+// is finished its pages are handed back to the os, so what stays in memory is
+// the bands still being worked on
+class MappedImage
+{
+public:
+	// ---- methods
+	bool create(const string& pPath, ImageFormat pFormat, int pWidth, int pHeight, int pTileSize,
+		int pSamplesPerPixel, string& pError)
+	{
+		if (pFormat != ImageFormat::Pfm && pFormat != ImageFormat::P6)
+		{
+			pError = string("an out of core render can't write ") + imageFormatName(pFormat) + ", only pfm or ppm";
+			return false;
+		}
+
+		mFormat = pFormat;
+		mWidth = pWidth;
+		mHeight = pHeight;
+		mTileSize = max(pTileSize, 1);
+		mSamplesPerPixel = pSamplesPerPixel;
+		mTilesX = (mWidth + mTileSize - 1) / mTileSize;
+
+		// the same headers encodePfm and encodeP6 write
+		const string header = mFormat == ImageFormat::Pfm
+			? "PF\n" + to_string(mWidth) + ' ' + to_string(mHeight) + "\n-1.0\n"
+			: "P6\n" + to_string(mWidth) + ' ' + to_string(mHeight) + "\n255\n";
+		mHeaderSize = header.size();
+		mRowBytes = static_cast<size_t>(mWidth) * 3 * (mFormat == ImageFormat::Pfm ? sizeof(float) : 1);
+
+		if (!mFile.create(pPath, mHeaderSize + mRowBytes * mHeight))
+		{
+			pError = "couldn't create " + pPath + " at " + to_string(mHeaderSize + mRowBytes * mHeight) + " bytes";
+			return false;
+		}
+		memcpy(mFile.writableData(), header.data(), mHeaderSize);
+
+		const int bands = (mHeight + mTileSize - 1) / mTileSize;
+		mvBandTiles.reset(new atomic<int>[bands]);
+		for (int b = 0; b < bands; ++b)
+			mvBandTiles[b] = 0;
+		return true;
+	}
+
+	// pPixels holds at least pTile, with pSamplesPerPixel samples in each pixel
+	void writeTile(const Framebuffer& pPixels, const Tile& pTile)
+	{
+		const double scale = 1.0 / mSamplesPerPixel;
+		const Real quantiseScale = Real(1.0) / mSamplesPerPixel;
+		uint8_t* data = mFile.writableData();
+		const size_t pixelBytes = mRowBytes / mWidth;
+
+		for (int j = pTile.mY0; j < pTile.mY1; ++j)
+		{
+			uint8_t* out = data + rowOffset(j) + pTile.mX0 * pixelBytes;
+			for (int i = pTile.mX0; i < pTile.mX1; ++i)
+			{
+				const FramePixel& pixel = pPixels.at(i, j);
+				const Real sums[3] = { pixel.r, pixel.g, pixel.b };
+				for (int k = 0; k < 3; ++k)
+				{
+					// the same maths as encodePfm and the lanes of quantiseImage
+					if (mFormat == ImageFormat::Pfm)
+					{
+						const float value = static_cast<float>(sums[k] * scale);
+						memcpy(out, &value, sizeof(float));
+						out += sizeof(float);
+					}
+					else
+					{
+						*out++ = static_cast<uint8_t>(fmin(sqrt(fmax(sums[k] * quantiseScale, Real(0.0))), Real(0.999))
+							* Real(256.0));
+					}
+				}
+			}
+			mFile.flush(rowOffset(j) + pTile.mX0 * pixelBytes, pTile.width() * pixelBytes, false);
+		}
+
+		// the last tile of a band lets go of the band's pages
+		const int band = pTile.mY0 / mTileSize;
+		if (mvBandTiles[band].fetch_add(1) + 1 == mTilesX)
+		{
+			const int top = min((band + 1) * mTileSize, mHeight);
+			const size_t begin = min(rowOffset(band * mTileSize), rowOffset(top - 1));
+			const size_t end = max(rowOffset(band * mTileSize), rowOffset(top - 1)) + mRowBytes;
+			mFile.release(begin, end - begin);
+		}
+	}
+
+	// waits for everything to reach the file and unmaps it
+	bool finish()
+	{
+		const bool flushed = mFile.flush(0, mFile.size(), true);
+		mFile.close();
+		return flushed;
+	}
+
+	size_t bytes() const { return mFile.size(); }
+
+private:
+	// pfm rows go bottom up like the render, ppm rows top down
+	size_t rowOffset(int pY) const
+	{
+		const int row = mFormat == ImageFormat::Pfm ? pY : mHeight - 1 - pY;
+		return mHeaderSize + static_cast<size_t>(row) * mRowBytes;
+	}
+
+	// ---- members
+	MappedFile mFile;
+	unique_ptr<atomic<int>[]> mvBandTiles;
+	ImageFormat mFormat = ImageFormat::Pfm;
+	int mWidth = 0;
+	int mHeight = 0;
+	int mTileSize = kFramebufferTileSize;
+	int mTilesX = 0;
+	int mSamplesPerPixel = 1;
+	size_t mHeaderSize = 0;
+	size_t mRowBytes = 0;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !MAPPED_IMAGE_H_
\ No newline at end of file
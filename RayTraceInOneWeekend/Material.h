@@ -6,111 +6,149 @@
 //--INCLUDES--//
 #include "Hittable.h"
 #include "rtweekend.h"
+#include "Sampler.h"
+#include "Span.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
 
 // -----------------------------------------------------------------------------
 
+// picks which scatter a material runs. code that batches work by material (the
+// wavefront shade stage) uses it to call the concrete scatter for a whole batch
+enum class MaterialType
+{
+	Lambertian,
+	Metal,
+	Dielectric,
+	DiffuseLight
+};
+
+const int kNumMaterialTypes = 4;
+
+inline const char* materialTypeName(MaterialType pType)
+{
+	switch (pType)
+	{
+	case MaterialType::Lambertian: return "lambertian";
+	case MaterialType::Metal: return "metal";
+	case MaterialType::Dielectric: return "dielectric";
+	case MaterialType::DiffuseLight: return "diffuse_light";
+	}
+	return "";
+}
 
 // -----------------------------------------------------------------------------
 
-class Material
+// every material is the same plain struct, mType says which of the fields it
+// uses. they live in the scene's MaterialTable and hits refer to them by index,
+// so nothing on the hot path touches a refcount or a vtable
+struct Material
 {
-public:
 	// ---- constructors
-
-	// ---- overrides
+	Material(MaterialType pType = MaterialType::Lambertian)
+		: mType(pType), mAlbedo(1.0, 1.0, 1.0), mFuzz(0.0), mIndexOfRefraction(1.0)
+	{}
 
 	// ---- methods
-	virtual bool scatter(const Ray& pRay, const HitRecord& pRecord, colour& pAttenuation,
-		Ray& pScatteredRay) const = 0;
+	bool scatter(const Ray& pRay, const HitRecord& pRecord, colour& pAttenuation,
+		Ray& pScatteredRay, Sampler& pSampler) const;
 
 	// ---- members
+	MaterialType mType;
+	colour mAlbedo;
+	Real mFuzz;
+	Real mIndexOfRefraction;
 };
 
 // -----------------------------------------------------------------------------
 
-class Lambertian : public Material
+// the material types only add a constructor and a scatter on top of Material,
+// no data, so they can be stored in the table as a plain Material
+struct Lambertian : public Material
 {
-public:
 	// ---- constructors
 	Lambertian(const colour& pAlbedo)
-		: mAlbedo(pAlbedo)
-	{}
-
-	// ---- overrides
+		: Material(MaterialType::Lambertian)
+	{
+		mAlbedo = pAlbedo;
+	}
 
 	// ---- methods
-	virtual bool scatter(const Ray& pRay, const HitRecord& pRecord, colour& pAttenuation,
-		Ray& pScatteredRay) const override
+	static bool scatter(const Material& pMat, const Ray& pRay, const HitRecord& pRecord,
+		colour& pAttenuation, Ray& pScatteredRay, Sampler& pSampler)
 	{
-		auto scatterDirection = pRecord.mNormal + randomUnitVector();
+		scatterAlong(pMat, pRecord, pSampler.unitVector(), pAttenuation, pScatteredRay);
+		return true;
+	}
+
+	// the scatter with its unit vector already drawn, for callers that warp
+	// a whole batch of them at once
+	static void scatterAlong(const Material& pMat, const HitRecord& pRecord, const vec3& pUnitVector,
+		colour& pAttenuation, Ray& pScatteredRay)
+	{
+		auto scatterDirection = pRecord.mNormal + pUnitVector;
 
 		// catch degenerate scatter direction
 		if (scatterDirection.nearZero())
 			scatterDirection = pRecord.mNormal;
 
 		pScatteredRay = Ray(pRecord.mPoint, scatterDirection);
-		pAttenuation = mAlbedo;
-		return true;
+		pAttenuation = pMat.mAlbedo;
 	}
-
-	// ---- members
-	colour mAlbedo;
 };
 
 // -----------------------------------------------------------------------------
 
-class Metal : public Material
+struct Metal : public Material
 {
-public:
 	// ---- constructors
-	Metal(const colour& pAlbedo, double pFuzz)
-		: mAlbedo(pAlbedo), mFuzz((pFuzz < 1) ? pFuzz : 1)
-	{}
-
-	// ---- overrides
+	Metal(const colour& pAlbedo, Real pFuzz)
+		: Material(MaterialType::Metal)
+	{
+		mAlbedo = pAlbedo;
+		mFuzz = (pFuzz < 1) ? pFuzz : 1;
+	}
 
 	// ---- methods
-	virtual bool scatter(const Ray& pRay, const HitRecord& pRecord, colour& pAttenuation,
-		Ray& pScatteredRay) const override
+	static bool scatter(const Material& pMat, const Ray& pRay, const HitRecord& pRecord,
+		colour& pAttenuation, Ray& pScatteredRay, Sampler& pSampler)
 	{
 		vec3 reflected = reflect(unitVector(pRay.direction()), pRecord.mNormal);
-		pScatteredRay = Ray(pRecord.mPoint, reflected + mFuzz*randomInUnitSphere());
-		pAttenuation = mAlbedo;
+		pScatteredRay = Ray(pRecord.mPoint, reflected + pMat.mFuzz*pSampler.inUnitSphere());
+		pAttenuation = pMat.mAlbedo;
 		return (dot(pScatteredRay.direction(), pRecord.mNormal) > 0);
 	}
-
-	// ---- members
-	colour mAlbedo;
-	double mFuzz;
 };
 
 // -----------------------------------------------------------------------------
 
-class Dielectric : public Material
+struct Dielectric : public Material
 {
-public:
 	// ---- constructors
-	Dielectric(double pIndexOfRefraction)
-		: mIndexOfRefraction(pIndexOfRefraction)
-	{}
-
-	// ---- overrides
+	Dielectric(Real pIndexOfRefraction)
+		: Material(MaterialType::Dielectric)
+	{
+		mIndexOfRefraction = pIndexOfRefraction;
+	}
 
 	// ---- methods
-	virtual bool scatter(const Ray& pRay, const HitRecord& pRecord, colour& pAttenuation,
-		Ray& pScatteredRay) const override
+	static bool scatter(const Material& pMat, const Ray& pRay, const HitRecord& pRecord,
+		colour& pAttenuation, Ray& pScatteredRay, Sampler& pSampler)
 	{
 		pAttenuation = colour(1.0, 1.0, 1.0);
-		double refractionRatio = pRecord.mFrontFace ? (1.0 / mIndexOfRefraction) : mIndexOfRefraction;
+		Real refractionRatio = pRecord.mFrontFace ? (1.0 / pMat.mIndexOfRefraction) : pMat.mIndexOfRefraction;
 
 		vec3 unitDirection = unitVector(pRay.direction());
-		double cosTheta = fmin(dot(-unitDirection, pRecord.mNormal), 1.0);
-		double sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+		Real cosTheta = fmin(dot(-unitDirection, pRecord.mNormal), 1.0);
+		Real sinTheta = sqrt(1.0 - cosTheta * cosTheta);
 
 		bool cannotRefract = refractionRatio * sinTheta > 1.0;
 		vec3 direction;
 
-		if (cannotRefract || reflectance(cosTheta, refractionRatio) > randomDouble())
+		if (cannotRefract || reflectance(cosTheta, refractionRatio) > pSampler.get1D())
 			direction = reflect(unitDirection, pRecord.mNormal);
 		else
 			direction = refract(unitDirection, pRecord.mNormal, refractionRatio);
@@ -119,16 +157,76 @@ public:
 		return true;
 	}
 
-	static double reflectance(double pCosine, double pRefIdx)
+	static Real reflectance(Real pCosine, Real pRefIdx)
 	{
 		// use Schlick's approcimation for reflectance
 		auto r0 = (1 - pRefIdx) / (1 + pRefIdx);
 		r0 = r0 * r0;
 		return r0 + (1 - r0)*pow((1 - pCosine), 5);
 	}
+};
+
+// -----------------------------------------------------------------------------
+
+// gives off light the same in every direction and scatters none. what it
+// emits is kept in mAlbedo, so a light is still a plain Material and nothing
+// that stores or maps materials needs to know about it
+struct DiffuseLight : public Material
+{
+	// ---- constructors
+	DiffuseLight(const colour& pEmitted)
+		: Material(MaterialType::DiffuseLight)
+	{
+		mAlbedo = pEmitted;
+	}
+
+	// ---- methods
+	static const colour& emitted(const Material& pMat) { return pMat.mAlbedo; }
+
+	static bool scatter(const Material&, const Ray&, const HitRecord&, colour&, Ray&, Sampler&)
+	{
+		return false;
+	}
+};
+
+// -----------------------------------------------------------------------------
+
+inline bool Material::scatter(const Ray& pRay, const HitRecord& pRecord, colour& pAttenuation,
+	Ray& pScatteredRay, Sampler& pSampler) const
+{
+	switch (mType)
+	{
+	case MaterialType::Lambertian: return Lambertian::scatter(*this, pRay, pRecord, pAttenuation, pScatteredRay, pSampler);
+	case MaterialType::Metal: return Metal::scatter(*this, pRay, pRecord, pAttenuation, pScatteredRay, pSampler);
+	case MaterialType::Dielectric: return Dielectric::scatter(*this, pRay, pRecord, pAttenuation, pScatteredRay, pSampler);
+	case MaterialType::DiffuseLight: return DiffuseLight::scatter(*this, pRay, pRecord, pAttenuation, pScatteredRay, pSampler);
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+// owns every material in a scene. objects and hit records hold a MaterialId,
+// which stays valid for as long as the table does
+class MaterialTable
+{
+public:
+	// ---- methods
+	MaterialId add(const Material& pMaterial)
+	{
+		mvMaterials.push_back(pMaterial);
+		return static_cast<MaterialId>(mvMaterials.size() - 1);
+	}
+
+	const Material& operator[](MaterialId pId) const { return mvMaterials[pId]; }
+	size_t size() const { return mvMaterials.size(); }
+
+	// the renderers only read materials through a span, so a table and a
+	// CompiledScene can be handed to them the same way
+	operator Span<const Material>() const { return Span<const Material>(mvMaterials.data(), mvMaterials.size()); }
 
 	// ---- members
-	double mIndexOfRefraction;
+	vector<Material> mvMaterials;
 };
 
 // -----------------------------------------------------------------------------
@@ -5,13 +5,27 @@
 
 //--INCLUDES--//
 #include "Camera.h"
+#include "Checkpoint.h"
 #include "colour.h"
+#include "Denoiser.h"
+#include "Framebuffer.h"
 #include "HittableList.h"
+#include "ImageWriter.h"
+#include "Integrator.h"
+#include "JsonWriter.h"
+#include "MappedImage.h"
 #include "Material.h"
+#include "RayPacket.h"
+#include "RenderSettings.h"
+#include "RenderStats.h"
 #include "rtweekend.h"
 #include "Sphere.h"
+#include "TileScheduler.h"
+#include "WavefrontRenderer.h"
 
-#include <conio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <mutex>
@@ -24,7 +38,7 @@ using namespace std;
 
 // -----------------------------------------------------------------------------
 
-double hitSphere(const point3& pCenter, double pRadius, const Ray& pRay)
+Real hitSphere(const point3& pCenter, Real pRadius, const Ray& pRay)
 {
 	vec3 oc = pRay.origin() - pCenter;
 	auto a = pRay.direction().lengthSquared();
@@ -44,36 +58,13 @@ double hitSphere(const point3& pCenter, double pRadius, const Ray& pRay)
 
 // -----------------------------------------------------------------------------
 
-colour rayColour(const Ray& pRay, const Hittable& pWorld, int pDepth)
-{
-	// if we've exceeded the ray bounce limit, no more light it gathered
-	if (pDepth <= 0)
-		return colour(0, 0, 0);
-
-	HitRecord rec;
-
-	if (pWorld.hit(pRay, 0.001, gInfinity, rec))
-	{
-		Ray scattered;
-		colour attentuation;
-
-		if (rec.mMatPtr->scatter(pRay, rec, attentuation, scattered))
-			return attentuation * rayColour(scattered, pWorld, pDepth - 1);
-		return colour(0, 0, 0);
-	}
-
-	vec3 unitDirection = unitVector(pRay.direction());
-	auto t = 0.5 * (unitDirection.y() + 1.0);
-	return (1.0 - t) * colour(1.0, 1.0, 1.0) + t * colour(0.5, 0.7, 1.0);
-}
-
-// -----------------------------------------------------------------------------
-
-HittableList randomScene()
+// the spheres go into the returned list and their materials into pMaterials,
+// which has to outlive the list
+HittableList randomScene(MaterialTable& pMaterials)
 {
 	HittableList world;
 
-	auto matGround = make_shared<Lambertian>(colour(0.5, 0.5, 0.5));
+	auto matGround = pMaterials.add(Lambertian(colour(0.5, 0.5, 0.5)));
 	world.add(make_shared<Sphere>(point3(0, -1000, 0), 1000, matGround));
 
 	for (int a = -11; a < 11; ++a)
@@ -85,13 +76,13 @@ HittableList randomScene()
 
 			if ((center - point3(4, 0.2, 0)).length() > 0.9)
 			{
-				shared_ptr<Material> sphereMaterial;
+				MaterialId sphereMaterial;
 
 				if (chooseMat < 0.8)
 				{
 					// diffuse
 					auto albedo = colour::random() * colour::random();
-					sphereMaterial = make_shared<Lambertian>(albedo);
+					sphereMaterial = pMaterials.add(Lambertian(albedo));
 					world.add(make_shared<Sphere>(center, 0.2, sphereMaterial));
 				}
 				else if (chooseMat < 0.95)
@@ -99,26 +90,26 @@ HittableList randomScene()
 					// metal
 					auto albedo = colour::random(0.5, 1);
 					auto fuzz = randomDouble(0, 0.5);
-					sphereMaterial = make_shared<Metal>(albedo, fuzz);
+					sphereMaterial = pMaterials.add(Metal(albedo, fuzz));
 					world.add(make_shared<Sphere>(center, 0.2, sphereMaterial));
 				}
 				else
 				{
 					// glass
-					sphereMaterial = make_shared<Dielectric>(1.5);
+					sphereMaterial = pMaterials.add(Dielectric(1.5));
 					world.add(make_shared<Sphere>(center, 0.2, sphereMaterial));
 				}
 			}
 		}
 	}
 
-	auto material1 = make_shared<Dielectric>(1.5);
+	auto material1 = pMaterials.add(Dielectric(1.5));
 	world.add(make_shared<Sphere>(point3(0, 1, 0), 1.0, material1));
 
-	auto material2 = make_shared<Lambertian>(colour(0.4, 0.2, 0.1));
+	auto material2 = pMaterials.add(Lambertian(colour(0.4, 0.2, 0.1)));
 	world.add(make_shared<Sphere>(point3(-4, 1, 0), 1.0, material2));
 
-	auto material3 = make_shared<Metal>(colour(0.7, 0.6, 0.5), 0.0);
+	auto material3 = pMaterials.add(Metal(colour(0.7, 0.6, 0.5), 0.0));
 	world.add(make_shared<Sphere>(point3(4, 1, 0), 1.0, material3));
 
 	return world;
@@ -134,67 +125,381 @@ HittableList randomScene()
 // -----------------------------------------------------------------------------
 
 void render(
-	int pStartPosX, int pStartPosY,
-	const int pChunkWidth, const int pChunkHeight,
-	const int pImageHeight, 
-	const int pImageWidth, 
-	const int pSamplesPerPixel, 
-	const int pMaxDepth,
-	const int pThreadNumber,
-	Camera pCamera, 
-	HittableList pWorld,
-	vector<vector<colour>>& pPixels)
+	const Tile& pTile,
+	const RenderSettings& pSettings,
+	const Camera& pCamera, 
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	Framebuffer& pPixels,
+	PathStats* pPathStats = nullptr,
+	AovBuffers* pAovs = nullptr)
 {
-	const int iw = pImageWidth - 1;
-	const int ih = pImageHeight - 1;
+	const int iw = pSettings.mImageWidth - 1;
+	const int ih = pSettings.mImageHeight - 1;
+	const bool timePixels = pPathStats && pPathStats->timesPixels();
+	int segments = 0;
+	Sampler sampler(pSettings.mSampler, pSettings.mSamplesPerPixel, pSettings.mSeed);
+
+	for (int j = pTile.mY1 - 1; j >= pTile.mY0; --j)
+	{
+		for (int i = pTile.mX0; i < pTile.mX1; ++i)
+		{
+			const uint64_t pixelIndex = static_cast<uint64_t>(j) * pSettings.mImageWidth + i;
+			const auto pixelStart = timePixels ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+
+			colour pixelColour(0, 0, 0);
+			PixelAovs pixelAovs;
+			for (int s = pSettings.mFirstSample; s < pSettings.mFirstSample + pSettings.mSamplesPerPixel; ++s)
+			{
+				// each sample has its own seed so the result is the same whichever
+				// thread or tile gets here first
+				sampler.startSample(pixelIndex, s);
+				Real du, dv;
+				sampler.get2D(du, dv);
+				auto u = (i + du) / iw;
+				auto v = (j + dv) / ih;
+				Ray r = pCamera.getRay(u, v, sampler);
+				if (pAovs)
+				{
+					FirstHit firstHit;
+					const colour sample = tracePath(r, pWorld, pMaterials, pSettings, sampler, &segments, nullptr, &firstHit);
+					pixelColour += sample;
+					pixelAovs.add(firstHit, sample);
+				}
+				else
+				{
+					pixelColour += tracePath(r, pWorld, pMaterials, pSettings, sampler, &segments);
+				}
+			}
+			pPixels.set(i, j, pixelColour, pSettings.mSamplesPerPixel);
+			if (pAovs)
+				pAovs->set(i, j, pixelAovs);
+
+			if (timePixels)
+				pPathStats->mPixelSeconds[j][i] = chrono::duration<double>(chrono::steady_clock::now() - pixelStart).count();
+		}
+	}
 
-	const int minY = pStartPosY - pChunkHeight;
-	for (int j = pStartPosY - 1; j >= minY; --j)
+	pPixels.addTileSamples(pTile.mX0, pTile.mY0, pTile.mX1, pTile.mY1, pSettings.mSamplesPerPixel);
+	if (pPathStats)
+		pPathStats->add(static_cast<uint64_t>(pTile.width()) * pTile.height() * pSettings.mSamplesPerPixel, segments);
+}
+
+// -----------------------------------------------------------------------------
+
+// render with a sample budget per pixel instead of a fixed count. every pixel
+// gets mMinSamples, then more in small batches until the standard error of its
+// luminance drops under mAdaptiveThreshold or it reaches mSamplesPerPixel. the
+// error is measured after the writer's gamma of 2, so dark pixels aren't held
+// to a tighter standard than anyone can see. samples use the same seeds as
+// render, and the result is scaled up to mSamplesPerPixel samples' worth so it
+// can be written out like any other frame
+void renderAdaptive(
+	const Tile& pTile,
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	Framebuffer& pPixels,
+	vector<vector<int>>* pSampleCounts = nullptr,
+	PathStats* pPathStats = nullptr,
+	AovBuffers* pAovs = nullptr)
+{
+	const int batch = 4;
+	const int minSamples = max(2, min(pSettings.mMinSamples, pSettings.mSamplesPerPixel));
+	const int iw = pSettings.mImageWidth - 1;
+	const int ih = pSettings.mImageHeight - 1;
+	const bool timePixels = pPathStats && pPathStats->timesPixels();
+	int segments = 0;
+	uint64_t samplesTaken = 0;
+	Sampler sampler(pSettings.mSampler, pSettings.mSamplesPerPixel, pSettings.mSeed);
+
+	for (int j = pTile.mY1 - 1; j >= pTile.mY0; --j)
 	{
-		const int maxX = pStartPosX + pChunkWidth;
-		for (int i = pStartPosX; i < maxX; ++i)
+		for (int i = pTile.mX0; i < pTile.mX1; ++i)
 		{
+			const uint64_t pixelIndex = static_cast<uint64_t>(j) * pSettings.mImageWidth + i;
+			const auto pixelStart = timePixels ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+
+			// running mean and sum of squared differences of the luminance (welford)
 			colour pixelColour(0, 0, 0);
-			for (int s = 0; s < pSamplesPerPixel; ++s)
+			PixelAovs pixelAovs;
+			double mean = 0.0;
+			double m2 = 0.0;
+			int n = 0;
+
+			while (n < pSettings.mSamplesPerPixel)
+			{
+				const int target = n < minSamples ? minSamples : min(n + batch, pSettings.mSamplesPerPixel);
+				for (; n < target; ++n)
+				{
+					sampler.startSample(pixelIndex, pSettings.mFirstSample + n);
+					Real du, dv;
+					sampler.get2D(du, dv);
+					auto u = (i + du) / iw;
+					auto v = (j + dv) / ih;
+					Ray r = pCamera.getRay(u, v, sampler);
+					FirstHit firstHit;
+					const colour sample = tracePath(r, pWorld, pMaterials, pSettings, sampler, &segments, nullptr,
+						pAovs ? &firstHit : nullptr);
+					pixelColour += sample;
+					if (pAovs)
+						pixelAovs.add(firstHit, sample);
+
+					const double luminance = 0.2126 * sample.x() + 0.7152 * sample.y() + 0.0722 * sample.z();
+					const double delta = luminance - mean;
+					mean += delta / (n + 1);
+					m2 += delta * (luminance - mean);
+				}
+
+				const double standardError = sqrt(m2 / (n - 1) / n);
+				const double displayError = standardError / (2.0 * sqrt(max(mean, 1e-4)));
+				if (displayError < pSettings.mAdaptiveThreshold)
+					break;
+			}
+
+			const double scale = static_cast<double>(pSettings.mSamplesPerPixel) / n;
+			pPixels.set(i, j, pixelColour * scale, pSettings.mSamplesPerPixel);
+			if (pAovs)
 			{
-				auto u = (i + randomDouble()) / iw;
-				auto v = (j + randomDouble()) / ih;
-				Ray r = pCamera.getRay(u, v);
-				pixelColour += rayColour(r, pWorld, pMaxDepth);
+				pixelAovs.scale(scale);
+				pAovs->set(i, j, pixelAovs);
 			}
-			pPixels[j][i] = pixelColour;
+			if (pSampleCounts)
+				(*pSampleCounts)[j][i] = n;
+			samplesTaken += n;
+
+			if (timePixels)
+				pPathStats->mPixelSeconds[j][i] = chrono::duration<double>(chrono::steady_clock::now() - pixelStart).count();
 		}
 	}
+
+	// scaled up to a full count, so the tile holds as many as any other
+	pPixels.addTileSamples(pTile.mX0, pTile.mY0, pTile.mX1, pTile.mY1, pSettings.mSamplesPerPixel);
+	if (pPathStats)
+		pPathStats->add(samplesTaken, segments);
+}
+
+// -----------------------------------------------------------------------------
+
+// the same as render, but the camera rays for a 4x2 block of pixels are traced
+// together as one packet. only the first hit is shared, everything after the
+// first bounce goes off on its own through tracePath. the samples use the same
+// seeds and the same minHitT as render so both give identical images, as long
+// as the compiler isn't allowed to fuse multiply-adds (see CMakeLists.txt)
+void renderPackets(
+	const Tile& pTile,
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	Framebuffer& pPixels,
+	PathStats* pPathStats = nullptr,
+	AovBuffers* pAovs = nullptr)
+{
+	const int blockWidth = 4;
+	const int blockHeight = RayPacket::kSize / blockWidth;
+	const int iw = pSettings.mImageWidth - 1;
+	const int ih = pSettings.mImageHeight - 1;
+	const bool timePixels = pPathStats && pPathStats->timesPixels();
+	int segments = 0;
+
+	for (int by = pTile.mY1 - 1; by >= pTile.mY0; by -= blockHeight)
+	{
+		for (int bx = pTile.mX0; bx < pTile.mX1; bx += blockWidth)
+		{
+			const auto blockStart = timePixels ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+
+			// lanes hanging off the edge of the tile stay switched off
+			int pixelX[RayPacket::kSize], pixelY[RayPacket::kSize];
+			int activeMask = 0;
+			for (int lane = 0; lane < RayPacket::kSize; ++lane)
+			{
+				pixelX[lane] = bx + lane % blockWidth;
+				pixelY[lane] = by - lane / blockWidth;
+				if (pixelX[lane] < pTile.mX1 && pixelY[lane] >= pTile.mY0)
+					activeMask |= 1 << lane;
+			}
+
+			colour pixelColour[RayPacket::kSize];
+			PixelAovs pixelAovs[RayPacket::kSize];
+			for (int s = pSettings.mFirstSample; s < pSettings.mFirstSample + pSettings.mSamplesPerPixel; ++s)
+			{
+				RayPacket packet;
+				Sampler samplers[RayPacket::kSize];
+				int scalarMask = 0;
+				for (int lane = 0; lane < RayPacket::kSize; ++lane)
+				{
+					// dead lanes get a copy of lane 0 so they never hold garbage
+					if (!(activeMask & (1 << lane)))
+					{
+						packet.set(lane, packet.ray(0));
+						continue;
+					}
+
+					const uint64_t pixelIndex = static_cast<uint64_t>(pixelY[lane]) * pSettings.mImageWidth + pixelX[lane];
+					samplers[lane] = Sampler(pSettings.mSampler, pSettings.mSamplesPerPixel, pSettings.mSeed);
+					samplers[lane].startSample(pixelIndex, s);
+					Real du, dv;
+					samplers[lane].get2D(du, dv);
+					auto u = (pixelX[lane] + du) / iw;
+					auto v = (pixelY[lane] + dv) / ih;
+					const Ray r = pCamera.getRay(u, v, samplers[lane]);
+					packet.set(lane, r);
+
+					// the packet tests every lane from kMinRayT. a ray whose own
+					// epsilon is bigger (a camera far from the origin) is traced
+					// on its own like render() would, so the two still agree
+					if (minHitT(r) != kMinRayT)
+						scalarMask |= 1 << lane;
+				}
+
+				Real closest[RayPacket::kSize];
+				for (int lane = 0; lane < RayPacket::kSize; ++lane)
+					closest[lane] = gInfinity;
+
+				HitRecord records[RayPacket::kSize];
+				const int hitMask = pSettings.mMaxDepth > 0
+					? pWorld.hitPacket(packet, activeMask & ~scalarMask, kMinRayT, closest, records) : 0;
+
+				for (int lane = 0; lane < RayPacket::kSize; ++lane)
+				{
+					if (!(activeMask & (1 << lane)))
+						continue;
+
+					// counted the way tracePath would have counted it
+					if (pSettings.mMaxDepth <= 0)
+					{
+						RT_STAT(threadStats().countPath(0));
+						RT_STAT(threadStats().mDepthLimited++);
+						continue;
+					}
+
+					const Ray r = packet.ray(lane);
+					FirstHit firstHit;
+					colour sample;
+					if (hitMask & (1 << lane))
+					{
+						sample = tracePath(r, pWorld, pMaterials, pSettings, samplers[lane], &segments, &records[lane],
+							pAovs ? &firstHit : nullptr);
+					}
+					else if (scalarMask & (1 << lane))
+					{
+						sample = tracePath(r, pWorld, pMaterials, pSettings, samplers[lane], &segments, nullptr,
+							pAovs ? &firstHit : nullptr);
+					}
+					else
+					{
+						RT_STAT(threadStats().mPrimaryRays++);
+						RT_STAT(threadStats().mEscaped++);
+						RT_STAT(threadStats().countPath(1));
+						sample = skyColour(r);
+						firstHit.mAlbedo = sample;
+						++segments;
+					}
+					pixelColour[lane] += sample;
+					if (pAovs)
+						pixelAovs[lane].add(firstHit, sample);
+				}
+			}
+
+			// the lanes were traced together, so they share the block's time
+			const double laneSeconds = timePixels
+				? chrono::duration<double>(chrono::steady_clock::now() - blockStart).count() / countLanes(activeMask) : 0.0;
+
+			for (int lane = 0; lane < RayPacket::kSize; ++lane)
+			{
+				if (!(activeMask & (1 << lane)))
+					continue;
+
+				pPixels.set(pixelX[lane], pixelY[lane], pixelColour[lane], pSettings.mSamplesPerPixel);
+				if (pAovs)
+					pAovs->set(pixelX[lane], pixelY[lane], pixelAovs[lane]);
+				if (timePixels)
+					pPathStats->mPixelSeconds[pixelY[lane]][pixelX[lane]] = laneSeconds;
+			}
+		}
+	}
+
+	pPixels.addTileSamples(pTile.mX0, pTile.mY0, pTile.mX1, pTile.mY1, pSettings.mSamplesPerPixel);
+	if (pPathStats)
+		pPathStats->add(static_cast<uint64_t>(pTile.width()) * pTile.height() * pSettings.mSamplesPerPixel, segments);
 }
 
 // -----------------------------------------------------------------------------
 
 // this is me attempting to multi thread the function
-// it separates the pixels into a 4x4 grid. Each square writes to its own output file
-// the output files are then concatenated after all the threads are done.
-void multithreadRender(
-	const int pImageHeight,
-	const int pImageWidth,
-	const int pSamplesPerPixel,
-	const int pMaxDepth,
-	Camera pCamera,
-	HittableList pWorld)
+// the image is cut into small tiles which are handed out by a work stealing
+// scheduler, so threads that land on cheap sky tiles go and help the ones stuck
+// on the glass spheres. all the threads write into one shared Framebuffer whose
+// tiles are the scheduler's, so no two threads ever write to one cache line,
+// and it's written out once they're all done. pAovs gets what each pixel's
+// samples hit first, the wavefront renderer leaves it empty
+Framebuffer renderFrame(
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	ostream* pReport = nullptr,
+	PathStats* pPathStats = nullptr,
+	vector<vector<int>>* pSampleCounts = nullptr,
+	AovBuffers* pAovs = nullptr)
 {
+	PathStats localPathStats;
+	PathStats& pathStats = pPathStats ? *pPathStats : localPathStats;
+	const auto start = chrono::steady_clock::now();
+
+	auto printPathReport = [&]()
+	{
+		*pReport << "average path length " << pathStats.averageLength() << " rays, "
+			<< static_cast<double>(pathStats.mPaths) / (static_cast<double>(pSettings.mImageWidth) * pSettings.mImageHeight)
+			<< " spp on average, frame time "
+			<< chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s\n";
+	};
+
+	if (pSettings.mMode == RenderMode::Wavefront)
+	{
+		WavefrontStats stats;
+		Framebuffer pixels = renderWavefront(pSettings, pCamera, pWorld, pMaterials, &stats, &pathStats);
+		if (pReport)
+		{
+			stats.printReport(*pReport);
+			printPathReport();
+		}
+		return pixels;
+	}
+
 	// returns a uint representing the number of concurrent threads that can be supported
 	// by the hardware. It can return 0 if the number of hardware threads can't be
 	// determined so we add a check for that
-	const unsigned int numThreads = thread::hardware_concurrency() != 0
-		? thread::hardware_concurrency() : 4;
-	const int chunkHeight = pImageHeight / numThreads;
+	const unsigned int numThreads = pSettings.mThreads != 0 ? pSettings.mThreads
+		: (thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 4);
 
-	vector<vector<colour>> pixels(pImageHeight, vector<colour>(pImageWidth));
+	Framebuffer pixels(pSettings.mImageWidth, pSettings.mImageHeight, pSettings.mTileSize);
 	vector<thread> threads;
 
+	if (pSampleCounts)
+		pSampleCounts->assign(pSettings.mImageHeight, vector<int>(pSettings.mImageWidth, pSettings.mSamplesPerPixel));
+	if (pAovs)
+		pAovs->resize(pSettings.mImageWidth, pSettings.mImageHeight);
+
+	TileScheduler scheduler(makeTiles(pSettings.mImageWidth, pSettings.mImageHeight,
+		pSettings.mTileSize, pSettings.mTileOrder), numThreads);
+
 	for (uint32_t i = 0; i < numThreads; ++i)
 	{
-		int startY = pImageHeight - i * chunkHeight;
-		threads.emplace_back(render, 0, startY, pImageWidth, chunkHeight, pImageHeight, pImageWidth,
-			pSamplesPerPixel, pMaxDepth, i, pCamera, pWorld, ref(pixels));
+		threads.emplace_back([&, i]()
+		{
+			scheduler.work(i, [&](const Tile& pTile)
+			{
+				if (pSettings.mAdaptive)
+					renderAdaptive(pTile, pSettings, pCamera, pWorld, pMaterials, pixels, pSampleCounts, &pathStats, pAovs);
+				else if (pSettings.mUsePackets)
+					renderPackets(pTile, pSettings, pCamera, pWorld, pMaterials, pixels, &pathStats, pAovs);
+				else
+					render(pTile, pSettings, pCamera, pWorld, pMaterials, pixels, &pathStats, pAovs);
+			});
+		});
 	}
 
 	for (thread& t : threads)
@@ -202,17 +507,388 @@ void multithreadRender(
 		t.join();
 	}
 
-	// now stitch all the pixels together in one file
-	ofstream file("output.ppm");
-	file << "P3\n" << pImageWidth << ' ' << pImageHeight << "\n255\n";
+	pathStats.mvTiles = scheduler.tiles();
+	pathStats.mvTileSeconds = scheduler.tileSeconds();
+
+	if (pReport)
+	{
+		scheduler.printReport(*pReport);
+		printPathReport();
+	}
+
+	return pixels;
+}
+
+// -----------------------------------------------------------------------------
 
-	for (const auto& row : pixels)
+// renders the frame in passes of mPassSamples and keeps a running sum, so there
+// is always a finished image to hand. it stops at mSamplesPerPixel or when the
+// next pass wouldn't fit in mTimeBudget, shrinking the last pass to whatever
+// still fits. every mSnapshotInterval seconds the image so far is written out,
+// and every mCheckpointInterval the sums go to mCheckpointPath. pPixels can
+// come in already holding pSamplesDone samples from a checkpoint, the passes
+// then carry on from there and add up to exactly what an uninterrupted render
+// would have. returns how many samples ended up in each pixel
+int progressiveRender(
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	Framebuffer& pPixels,
+	ostream* pReport = nullptr,
+	int pSamplesDone = 0,
+	uint64_t pSceneFingerprint = 0)
+{
+	typedef chrono::steady_clock Clock;
+	auto secondsSince = [](Clock::time_point pStart)
+	{
+		return chrono::duration<double>(Clock::now() - pStart).count();
+	};
+
+	const auto start = Clock::now();
+	auto lastSnapshot = start;
+	auto lastCheckpoint = start;
+	if (pSamplesDone == 0)
+		pPixels = Framebuffer(pSettings.mImageWidth, pSettings.mImageHeight, pSettings.mTileSize);
+
+	auto checkpoint = [&](int pDone)
+	{
+		string error;
+		if (!saveCheckpoint(pSettings.mCheckpointPath, pSettings, pSceneFingerprint, pDone, pPixels, error))
+			cerr << '\n' << error << '\n';
+		lastCheckpoint = Clock::now();
+	};
+
+	RenderSettings pass = pSettings;
+	int done = pSamplesDone;
+	int passes = 0;
+	double secondsPerSample = 0.0;
+
+	while (done < pSettings.mSamplesPerPixel)
 	{
-		for (const auto& pixel : row)
+		int samples = min(pSettings.mPassSamples, pSettings.mSamplesPerPixel - done);
+
+		// the first pass always runs so there's something to show for it
+		if (pSettings.mTimeBudget > 0.0 && passes > 0)
+		{
+			const double remaining = pSettings.mTimeBudget - secondsSince(start);
+			samples = min(samples, static_cast<int>(remaining / secondsPerSample));
+			if (samples <= 0)
+				break;
+		}
+
+		pass.mFirstSample = pSettings.mFirstSample + done;
+		pass.mSamplesPerPixel = samples;
+
+		const auto passStart = Clock::now();
+		pPixels.accumulate(renderFrame(pass, pCamera, pWorld, pMaterials));
+		done += samples;
+		passes++;
+
+		// the slowest pass so far decides how much more fits in the budget
+		secondsPerSample = max(secondsPerSample, secondsSince(passStart) / samples);
+
+		if (pReport)
+			*pReport << "\r" << done << " spp after " << secondsSince(start) << "s" << flush;
+
+		if (pSettings.mSnapshotInterval > 0.0 && done < pSettings.mSamplesPerPixel
+			&& secondsSince(lastSnapshot) >= pSettings.mSnapshotInterval)
 		{
-			writeColour(file, pixel, pSamplesPerPixel);
+			writeImage(pSettings.mOutputPath, pSettings.mOutputFormat, pPixels, done);
+			lastSnapshot = Clock::now();
 		}
+
+		if (!pSettings.mCheckpointPath.empty() && done < pSettings.mSamplesPerPixel
+			&& secondsSince(lastCheckpoint) >= pSettings.mCheckpointInterval)
+			checkpoint(done);
+	}
+
+	if (pReport)
+		*pReport << '\n';
+
+	// the last one is kept too, more samples can be added to it later
+	if (!pSettings.mCheckpointPath.empty())
+		checkpoint(done);
+
+	return done;
+}
+
+// -----------------------------------------------------------------------------
+
+// the counters of a whole frame as json. pPathStats has the tile times when
+// the frame was rendered in one go by the tiled renderer
+void writeStatsReport(
+	ostream& pOut,
+	const RenderSettings& pSettings,
+	const StatCounters& pCounters,
+	const PathStats& pPathStats,
+	int pSamplesPerPixel,
+	double pSeconds)
+{
+	JsonWriter json(pOut);
+	json.beginObject();
+	json.field("stats_compiled_in", RT_STATS != 0);
+	json.field("mode", pSettings.mMode == RenderMode::Wavefront ? "wavefront" : "tiled");
+	json.field("packets", pSettings.mUsePackets);
+	json.field("adaptive", pSettings.mAdaptive);
+	json.field("progressive", pSettings.mProgressive);
+	json.field("width", pSettings.mImageWidth);
+	json.field("height", pSettings.mImageHeight);
+	json.field("spp", pSamplesPerPixel);
+	json.field("max_depth", pSettings.mMaxDepth);
+	json.field("seconds", pSeconds);
+
+	const uint64_t rays = pCounters.mPrimaryRays + pCounters.mSecondaryRays;
+	json.key("rays").beginObject();
+	json.field("primary", pCounters.mPrimaryRays);
+	json.field("secondary", pCounters.mSecondaryRays);
+	json.field("total", rays);
+	json.field("mrays_per_sec", pSeconds > 0.0 ? rays / pSeconds * 1e-6 : 0.0);
+	json.endObject();
+
+	json.key("sphere").beginObject();
+	json.field("tests", pCounters.mSphereTests);
+	json.field("hits", pCounters.mSphereHits);
+	json.field("hit_rate", pCounters.mSphereTests > 0 ? static_cast<double>(pCounters.mSphereHits) / pCounters.mSphereTests : 0.0);
+	json.field("tests_per_ray", rays > 0 ? static_cast<double>(pCounters.mSphereTests) / rays : 0.0);
+	json.endObject();
+
+	json.key("shadow").beginObject();
+	json.field("rays", pCounters.mShadowRays);
+	json.field("blocked", pCounters.mShadowsBlocked);
+	json.endObject();
+
+	json.key("scatters").beginObject();
+	for (int t = 0; t < kNumMaterialTypes; ++t)
+		json.field(materialTypeName(static_cast<MaterialType>(t)), pCounters.mScatters[t]);
+	json.endObject();
+
+	// every path ends in exactly one of these
+	uint64_t paths = 0;
+	for (int d = 0; d < kStatsDepthBins; ++d)
+		paths += pCounters.mPathDepth[d];
+
+	json.key("paths").beginObject();
+	json.field("total", paths);
+	json.field("escaped", pCounters.mEscaped);
+	json.field("absorbed", pCounters.mAbsorbed);
+	json.field("roulette_killed", pCounters.mRouletteKilled);
+	json.field("depth_limited", pCounters.mDepthLimited);
+	json.field("average_length", paths > 0 ? static_cast<double>(rays) / paths : 0.0);
+	json.endObject();
+
+	// bin d is paths that traced d rays, the last bin also has anything longer
+	json.key("path_depth").beginArray();
+	const int lastBin = min(max(pSettings.mMaxDepth, 0), kStatsDepthBins - 1);
+	for (int d = 0; d <= lastBin; ++d)
+		json.value(pCounters.mPathDepth[d]);
+	json.endArray();
+
+	json.key("tiles").beginArray();
+	for (size_t t = 0; t < pPathStats.mvTiles.size(); ++t)
+	{
+		const Tile& tile = pPathStats.mvTiles[t];
+		json.beginObject();
+		json.field("x0", tile.mX0);
+		json.field("y0", tile.mY0);
+		json.field("x1", tile.mX1);
+		json.field("y1", tile.mY1);
+		json.field("seconds", pPathStats.mvTileSeconds[t]);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.endObject();
+}
+
+// -----------------------------------------------------------------------------
+
+// renders straight into the output file, for frames like 32k x 32k prints that
+// won't fit in memory as a Framebuffer. each thread renders a tile at a time
+// into a Framebuffer of one tile, moved to wherever that tile is, and copies it
+// into the mapped file, see MappedImage. tiles are handed out in scanline order
+// from one counter: the bands of the file that are open at once stay few, and
+// unlike the scheduler nothing is kept per tile. anything that needs the whole
+// frame in memory (progressive passes, the denoiser and aovs, the heatmaps and
+// the wavefront renderer) is left out
+bool renderOutOfCore(
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials)
+{
+	if (pSettings.mProgressive || pSettings.mMode == RenderMode::Wavefront || pSettings.mDenoise
+		|| !pSettings.mAovPrefix.empty() || !pSettings.mHeatmapPath.empty() || !pSettings.mCostHeatmapPath.empty())
+		cerr << "an out of core render is one tiled pass with nothing but the image, leaving the rest out\n";
+
+	const auto start = chrono::steady_clock::now();
+	MappedImage image;
+	string error;
+	if (!image.create(pSettings.mOutputPath, pSettings.mOutputFormat, pSettings.mImageWidth, pSettings.mImageHeight,
+		pSettings.mTileSize, pSettings.mSamplesPerPixel, error))
+	{
+		cerr << error << '\n';
+		return false;
+	}
+
+	const unsigned int numThreads = pSettings.mThreads != 0 ? pSettings.mThreads
+		: (thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 4);
+	const int tileSize = max(pSettings.mTileSize, 1);
+	const int tilesX = (pSettings.mImageWidth + tileSize - 1) / tileSize;
+	const int tilesY = (pSettings.mImageHeight + tileSize - 1) / tileSize;
+	const uint64_t tileCount = static_cast<uint64_t>(tilesX) * tilesY;
+
+	PathStats pathStats;
+	atomic<uint64_t> nextTile{ 0 };
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([&]()
+		{
+			Framebuffer pixels(tileSize, tileSize, tileSize);
+			for (uint64_t n = nextTile++; n < tileCount; n = nextTile++)
+			{
+				// from the top of the image down, like makeTiles
+				Tile tile;
+				tile.mX0 = static_cast<int>(n % tilesX) * tileSize;
+				tile.mY0 = (tilesY - 1 - static_cast<int>(n / tilesX)) * tileSize;
+				tile.mX1 = min(tile.mX0 + tileSize, pSettings.mImageWidth);
+				tile.mY1 = min(tile.mY0 + tileSize, pSettings.mImageHeight);
+
+				pixels.moveTo(tile.mX0, tile.mY0);
+				pixels.clear();
+				if (pSettings.mAdaptive)
+					renderAdaptive(tile, pSettings, pCamera, pWorld, pMaterials, pixels, nullptr, &pathStats);
+				else if (pSettings.mUsePackets)
+					renderPackets(tile, pSettings, pCamera, pWorld, pMaterials, pixels, &pathStats);
+				else
+					render(tile, pSettings, pCamera, pWorld, pMaterials, pixels, &pathStats);
+				image.writeTile(pixels, tile);
+			}
+		});
+	}
+
+	for (thread& t : threads)
+		t.join();
+
+	const size_t bytes = image.bytes();
+	if (!image.finish())
+	{
+		cerr << "couldn't write " << pSettings.mOutputPath << '\n';
+		return false;
+	}
+	cerr << "average path length " << pathStats.averageLength() << " rays, frame time "
+		<< chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s\n"
+		<< "wrote " << pSettings.mOutputPath << " (" << imageFormatName(pSettings.mOutputFormat) << ", "
+		<< pSettings.mSamplesPerPixel << " spp, " << bytes / (1024.0 * 1024.0) << "MB) out of core\n";
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// pSceneFingerprint goes into checkpoints so they can't be resumed with another
+// scene, see sceneFingerprint(). returns false if nothing could be rendered
+bool multithreadRender(
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	uint64_t pSceneFingerprint = 0)
+{
+	StatsRegistry::instance().reset();
+	const auto frameStart = chrono::steady_clock::now();
+
+	// pixels can only be timed when one thread renders each of them from start to finish
+	PathStats pathStats;
+	const bool costHeatmap = !pSettings.mCostHeatmapPath.empty();
+	if (costHeatmap && (pSettings.mProgressive || pSettings.mMode == RenderMode::Wavefront))
+		cerr << "the cost heatmap needs a tiled frame that isn't progressive, not writing one\n";
+	else if (costHeatmap)
+		pathStats.mPixelSeconds.assign(pSettings.mImageHeight, vector<double>(pSettings.mImageWidth, 0.0));
+
+	// so can the first hits the denoiser is guided by
+	AovBuffers aovs;
+	const bool wantAovs = pSettings.mDenoise || !pSettings.mAovPrefix.empty();
+	const bool keepAovs = wantAovs && !pSettings.mProgressive && pSettings.mMode == RenderMode::Tiled;
+	if (wantAovs && !keepAovs)
+		cerr << "denoising and aovs need a tiled frame that isn't progressive, leaving them out\n";
+
+	Framebuffer pixels;
+	vector<vector<int>> sampleCounts;
+	int samplesDone = 0;
+	if (!pSettings.mResumePath.empty())
+	{
+		string error;
+		if (!loadCheckpoint(pSettings.mResumePath, pSettings, pSceneFingerprint, samplesDone, pixels, error))
+		{
+			cerr << error << '\n';
+			return false;
+		}
+		cerr << "resuming " << pSettings.mResumePath << " at " << samplesDone << " spp\n";
+	}
+
+	int samplesPerPixel = pSettings.mSamplesPerPixel;
+	if (pSettings.mProgressive)
+		samplesPerPixel = progressiveRender(pSettings, pCamera, pWorld, pMaterials, pixels, &cerr, samplesDone, pSceneFingerprint);
+	else
+		pixels = renderFrame(pSettings, pCamera, pWorld, pMaterials, &cerr, &pathStats, &sampleCounts, keepAovs ? &aovs : nullptr);
+
+	const double frameSeconds = chrono::duration<double>(chrono::steady_clock::now() - frameStart).count();
+
+	if (!pSettings.mStatsPath.empty())
+	{
+		const StatCounters counters = StatsRegistry::instance().collect();
+		cerr << counters.mPrimaryRays << " primary and " << counters.mSecondaryRays << " secondary rays, "
+			<< counters.mSphereTests << " sphere tests for " << counters.mSphereHits << " hits, "
+			<< counters.mShadowRays << " shadow rays\n";
+
+		ofstream file(pSettings.mStatsPath);
+		writeStatsReport(file, pSettings, counters, pathStats, samplesPerPixel, frameSeconds);
+		if (!file)
+			cerr << "couldn't write " << pSettings.mStatsPath << '\n';
+	}
+
+	if (pathStats.timesPixels())
+	{
+		double slowest = 0.0;
+		for (const vector<double>& row : pathStats.mPixelSeconds)
+			slowest = max(slowest, *max_element(row.begin(), row.end()));
+		if (!writeHeatmap(pSettings.mCostHeatmapPath, pathStats.mPixelSeconds, slowest))
+			cerr << "couldn't write " << pSettings.mCostHeatmapPath << '\n';
+	}
+
+	if (pSettings.mAdaptive && !pSettings.mProgressive && !pSettings.mHeatmapPath.empty())
+	{
+		vector<vector<double>> heat(sampleCounts.size());
+		for (size_t j = 0; j < sampleCounts.size(); ++j)
+			heat[j].assign(sampleCounts[j].begin(), sampleCounts[j].end());
+		if (!writeHeatmap(pSettings.mHeatmapPath, heat, pSettings.mSamplesPerPixel))
+			cerr << "couldn't write " << pSettings.mHeatmapPath << '\n';
+	}
+
+	if (!aovs.empty() && !pSettings.mAovPrefix.empty() && !writeAovs(pSettings.mAovPrefix, aovs, samplesPerPixel))
+		cerr << "couldn't write the aovs to " << pSettings.mAovPrefix << "_*.pfm\n";
+
+	if (!aovs.empty() && pSettings.mDenoise)
+	{
+		const auto denoiseStart = chrono::steady_clock::now();
+		ThreadPool pool(pSettings.mThreads);
+		DenoiseSettings denoiseSettings;
+		denoiseSettings.mPasses = pSettings.mDenoisePasses;
+		pixels = denoise(pixels, samplesPerPixel, aovs, denoiseSettings, pool);
+		cerr << "denoised in " << chrono::duration<double>(chrono::steady_clock::now() - denoiseStart).count() << "s\n";
+	}
+
+	// now stitch all the pixels together in one file
+	const auto start = chrono::steady_clock::now();
+	if (!writeImage(pSettings.mOutputPath, pSettings.mOutputFormat, pixels, samplesPerPixel))
+	{
+		cerr << "couldn't write " << pSettings.mOutputPath << '\n';
+		return false;
 	}
+	cerr << "wrote " << pSettings.mOutputPath << " (" << imageFormatName(pSettings.mOutputFormat) << ", "
+		<< samplesPerPixel << " spp) in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << "s\n";
+	return true;
 }
 
 // -----------------------------------------------------------------------------
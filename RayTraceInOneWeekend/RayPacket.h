@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------------
+#ifndef RAY_PACKET_H_
+#define RAY_PACKET_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "AABB.h"
+#include "ray.h"
+#include "Simd.h"
+
+// -----------------------------------------------------------------------------
+
+// a bundle of neighbouring rays stored as structure of arrays so each field
+// loads straight into simd lanes. lanes are switched on and off with a bit mask
+// (bit i is lane i) rather than by moving rays around
+struct RayPacket
+{
+	static const int kSize = 8;
+	static const int kGroups = kSize / kSimdWidth;
+	static const int kAllLanes = (1 << kSize) - 1;
+
+	// ---- methods
+	void set(int pLane, const Ray& pRay)
+	{
+		mOrigX[pLane] = pRay.mOrig.x();
+		mOrigY[pLane] = pRay.mOrig.y();
+		mOrigZ[pLane] = pRay.mOrig.z();
+		mDirX[pLane] = pRay.mDir.x();
+		mDirY[pLane] = pRay.mDir.y();
+		mDirZ[pLane] = pRay.mDir.z();
+		mInvDirX[pLane] = 1.0 / pRay.mDir.x();
+		mInvDirY[pLane] = 1.0 / pRay.mDir.y();
+		mInvDirZ[pLane] = 1.0 / pRay.mDir.z();
+		mDirLengthSquared[pLane] = pRay.mDir.lengthSquared();
+	}
+
+	Ray ray(int pLane) const
+	{
+		return Ray(point3(mOrigX[pLane], mOrigY[pLane], mOrigZ[pLane]),
+			vec3(mDirX[pLane], mDirY[pLane], mDirZ[pLane]));
+	}
+
+	// ---- members
+	Real mOrigX[kSize], mOrigY[kSize], mOrigZ[kSize];
+	Real mDirX[kSize], mDirY[kSize], mDirZ[kSize];
+	Real mInvDirX[kSize], mInvDirY[kSize], mInvDirZ[kSize];
+	Real mDirLengthSquared[kSize];
+};
+
+// -----------------------------------------------------------------------------
+
+// slab test of every lane in pActiveMask against one box, returns the lanes
+// that enter it before their current closest hit
+inline int hitBoxPacket(const AABB& pBox, const RayPacket& pPacket, int pActiveMask, Real pMinT,
+	const Real* pMaxT)
+{
+	const SimdReal minX(pBox.mMin.x()), minY(pBox.mMin.y()), minZ(pBox.mMin.z());
+	const SimdReal maxX(pBox.mMax.x()), maxY(pBox.mMax.y()), maxZ(pBox.mMax.z());
+	const SimdReal minT(pMinT);
+
+	int result = 0;
+	for (int g = 0; g < RayPacket::kGroups; ++g)
+	{
+		const int offset = g * kSimdWidth;
+		const int groupMask = (pActiveMask >> offset) & ((1 << kSimdWidth) - 1);
+		if (groupMask == 0)
+			continue;
+
+		const SimdReal ox = SimdReal::load(pPacket.mOrigX + offset);
+		const SimdReal oy = SimdReal::load(pPacket.mOrigY + offset);
+		const SimdReal oz = SimdReal::load(pPacket.mOrigZ + offset);
+		const SimdReal ix = SimdReal::load(pPacket.mInvDirX + offset);
+		const SimdReal iy = SimdReal::load(pPacket.mInvDirY + offset);
+		const SimdReal iz = SimdReal::load(pPacket.mInvDirZ + offset);
+
+		const SimdReal tx0 = (minX - ox) * ix, tx1 = (maxX - ox) * ix;
+		const SimdReal ty0 = (minY - oy) * iy, ty1 = (maxY - oy) * iy;
+		const SimdReal tz0 = (minZ - oz) * iz, tz1 = (maxZ - oz) * iz;
+
+		const SimdReal enter = max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), minT));
+		const SimdReal exit = min(min(max(tx0, tx1), max(ty0, ty1)), min(max(tz0, tz1), SimdReal::load(pMaxT + offset)));
+
+		result |= (moveMask(enter <= exit) & groupMask) << offset;
+	}
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+
+// the Sphere::hit maths for one sphere against every lane in pActiveMask. lanes
+// that find a root closer than pMaxT get it written back and are returned
+inline int hitSpherePacket(const point3& pCenter, Real pRadiusSquared, const RayPacket& pPacket,
+	int pActiveMask, Real pMinT, Real* pMaxT)
+{
+	const SimdReal cx(pCenter.x()), cy(pCenter.y()), cz(pCenter.z());
+	const SimdReal r2(pRadiusSquared);
+	const SimdReal minT(pMinT);
+	const SimdReal zero(0.0);
+
+	int result = 0;
+	for (int g = 0; g < RayPacket::kGroups; ++g)
+	{
+		const int offset = g * kSimdWidth;
+		const int groupMask = (pActiveMask >> offset) & ((1 << kSimdWidth) - 1);
+		if (groupMask == 0)
+			continue;
+
+		const SimdReal ocx = SimdReal::load(pPacket.mOrigX + offset) - cx;
+		const SimdReal ocy = SimdReal::load(pPacket.mOrigY + offset) - cy;
+		const SimdReal ocz = SimdReal::load(pPacket.mOrigZ + offset) - cz;
+		const SimdReal dx = SimdReal::load(pPacket.mDirX + offset);
+		const SimdReal dy = SimdReal::load(pPacket.mDirY + offset);
+		const SimdReal dz = SimdReal::load(pPacket.mDirZ + offset);
+		const SimdReal a = SimdReal::load(pPacket.mDirLengthSquared + offset);
+
+		const SimdReal halfB = ocx * dx + ocy * dy + ocz * dz;
+		const SimdReal c = ocx * ocx + ocy * ocy + ocz * ocz - r2;
+		const SimdReal discriminant = halfB * halfB - a * c;
+
+		const SimdReal hitMask = discriminant >= zero;
+		if ((moveMask(hitMask) & groupMask) == 0)
+			continue;
+
+		const SimdReal maxT = SimdReal::load(pMaxT + offset);
+		const SimdReal sqrtd = sqrt(max(discriminant, zero));
+		const SimdReal nearRoot = (zero - halfB - sqrtd) / a;
+		const SimdReal farRoot = (zero - halfB + sqrtd) / a;
+
+		const SimdReal nearOk = (minT <= nearRoot) & (nearRoot <= maxT);
+		const SimdReal farOk = (minT <= farRoot) & (farRoot <= maxT);
+		const int accepted = moveMask(hitMask & (nearOk | farOk)) & groupMask;
+		if (accepted == 0)
+			continue;
+
+		Real roots[kSimdWidth];
+		select(nearOk, nearRoot, farRoot).store(roots);
+		for (int lane = 0; lane < kSimdWidth; ++lane)
+		{
+			if (accepted & (1 << lane))
+				pMaxT[offset + lane] = roots[lane];
+		}
+		result |= accepted << offset;
+	}
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !RAY_PACKET_H_
\ No newline at end of file
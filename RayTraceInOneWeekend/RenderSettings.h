@@ -0,0 +1,332 @@
+// -----------------------------------------------------------------------------
+#ifndef RENDER_SETTINGS_H_
+#define RENDER_SETTINGS_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "ImageWriter.h"
+#include "Sampler.h"
+#include "TileScheduler.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// how the frame is split up between threads
+enum class RenderMode
+{
+	Tiled,		// one recursive path at a time, tiles handed out to threads
+	Wavefront	// a big pool of paths advanced one bounce at a time, see renderWavefront()
+};
+
+// -----------------------------------------------------------------------------
+
+// a framebuffer tile is allocated whole, so tiles can't be arbitrarily big
+const int kMaxTileSize = 1024;
+
+// everything multithreadRender needs to know about how to render a frame
+struct RenderSettings
+{
+	// ---- members
+
+	int mImageWidth = 400;
+	int mImageHeight = 225;
+	int mSamplesPerPixel = 100;
+	int mMaxDepth = 50;
+
+	// the index of the first sample in each pixel. frames rendered with
+	// mFirstSample = 0, N, 2N... use different random numbers and add up to
+	// exactly the same image as one frame with all the samples
+	int mFirstSample = 0;
+
+	// russian roulette, see survivesRoulette(). paths that have bounced at least
+	// mRouletteMinBounces times and carry less than mRouletteThreshold of their
+	// light get randomly cut short
+	bool mRussianRoulette = false;
+	int mRouletteMinBounces = 3;
+	double mRouletteThreshold = 0.1;
+
+	// next event estimation, see sampleLight(). every diffuse bounce also
+	// sends a shadow ray toward a light the scene has, and the two ways of
+	// finding a light are weighted with mis. a scene without lights is the same
+	// either way, this is for comparing against the bounces alone
+	bool mLightSampling = true;
+
+	// scheduling. mThreads of 0 uses every hardware thread
+	RenderMode mMode = RenderMode::Tiled;
+	unsigned int mThreads = 0;
+	int mTileSize = 16;
+	TileOrder mTileOrder = TileOrder::Hilbert;
+
+	// every sample's random numbers are derived from this
+	uint64_t mSeed = 0;
+
+	// trace primary rays in coherent packets, see renderPackets()
+	bool mUsePackets = false;
+
+	// how many paths the wavefront renderer keeps in flight at once
+	int mWavefrontPathCount = 1 << 18;
+
+	// adaptive sampling in tiled mode, see renderAdaptive(). mSamplesPerPixel is
+	// the most any pixel gets, and mHeatmapPath (if set) gets an image of where
+	// they went
+	bool mAdaptive = false;
+	int mMinSamples = 16;
+	double mAdaptiveThreshold = 0.005;
+	string mHeatmapPath;
+
+	// progressive rendering, see progressiveRender(). passes of mPassSamples
+	// are added up until mSamplesPerPixel is reached or mTimeBudget seconds
+	// run out (0 for no limit). a snapshot is written every mSnapshotInterval
+	bool mProgressive = false;
+	int mPassSamples = 4;
+	double mTimeBudget = 0.0;
+	double mSnapshotInterval = 10.0;
+
+	// checkpoints of a progressive render, see Checkpoint.h. the sums so far go
+	// to mCheckpointPath every mCheckpointInterval seconds and when it finishes.
+	// mResumePath carries on from one, or adds samples to a finished render
+	string mCheckpointPath;
+	double mCheckpointInterval = 60.0;
+	string mResumePath;
+
+	// first hit buffers and the denoiser, see Denoiser.h. mAovPrefix (if set)
+	// gets the albedo, normal and depth as pfms, and mDenoise runs an a-trous
+	// filter of mDenoisePasses passes guided by them over the finished frame
+	bool mDenoise = false;
+	int mDenoisePasses = 3;
+	string mAovPrefix;
+
+	// where each sample's random numbers come from, see Sampler.h. the
+	// stratified sampler stratifies each progressive pass on its own
+	SamplerType mSampler = SamplerType::Independent;
+
+	// a scene file to render instead of randomScene(), see SceneFile.h
+	string mScenePath;
+
+	// a keyframe file to render as a sequence of images, see Animation.h. the
+	// tree is refit between frames unless mRebuildEveryFrame asks to compare
+	string mAnimationPath;
+	bool mRebuildEveryFrame = false;
+
+	// distributed rendering, see DistributedRender.h. a coordinator listens on
+	// mCoordinatorPort (0 lets the os pick) and workers connect to
+	// mWorkerAddress as host:port. a worker that's quiet for mWorkerTimeout
+	// seconds is given up on
+	int mCoordinatorPort = -1;
+	string mWorkerAddress;
+	double mWorkerTimeout = 60.0;
+
+	// output
+	ImageFormat mOutputFormat = ImageFormat::P6;
+	string mOutputPath = "output.ppm";
+
+	// render straight into the output file instead of memory, for frames too
+	// big to hold, see renderOutOfCore(). pfm or ppm only
+	bool mOutOfCore = false;
+
+	// profiling, see writeStatsReport(). mStatsPath gets the frame's counters as
+	// json and mCostHeatmapPath an image of how long each pixel took
+	string mStatsPath;
+	string mCostHeatmapPath;
+};
+
+// -----------------------------------------------------------------------------
+
+// fills in pSettings from the command line. anything it doesn't understand is
+// reported to pErr and it returns false. the image height isn't an option, it
+// comes from the width and the camera's aspect ratio
+bool parseArguments(int argc, char* argv[], RenderSettings& pSettings, ostream& pErr)
+{
+	bool outputGiven = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string option = argv[i];
+
+		// the flags first, then everything that takes a value
+		if (option == "--packets")
+		{
+			pSettings.mUsePackets = true;
+			continue;
+		}
+		if (option == "--roulette")
+		{
+			pSettings.mRussianRoulette = true;
+			continue;
+		}
+		if (option == "--no-light-sampling")
+		{
+			pSettings.mLightSampling = false;
+			continue;
+		}
+		if (option == "--adaptive")
+		{
+			pSettings.mAdaptive = true;
+			continue;
+		}
+		if (option == "--progressive")
+		{
+			pSettings.mProgressive = true;
+			continue;
+		}
+		if (option == "--denoise")
+		{
+			pSettings.mDenoise = true;
+			continue;
+		}
+		if (option == "--rebuild-every-frame")
+		{
+			pSettings.mRebuildEveryFrame = true;
+			continue;
+		}
+		if (option == "--out-of-core")
+		{
+			pSettings.mOutOfCore = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			pErr << "missing value for " << option << '\n';
+			return false;
+		}
+		const string value = argv[++i];
+
+		if (option == "--width")
+			pSettings.mImageWidth = atoi(value.c_str());
+		else if (option == "--spp")
+			pSettings.mSamplesPerPixel = atoi(value.c_str());
+		else if (option == "--depth")
+			pSettings.mMaxDepth = atoi(value.c_str());
+		else if (option == "--threads")
+			pSettings.mThreads = static_cast<unsigned int>(atoi(value.c_str()));
+		else if (option == "--tile-size")
+		{
+			pSettings.mTileSize = atoi(value.c_str());
+			if (pSettings.mTileSize < 1 || pSettings.mTileSize > kMaxTileSize)
+			{
+				pErr << "the tile size must be between 1 and " << kMaxTileSize << '\n';
+				return false;
+			}
+		}
+		else if (option == "--tile-order")
+		{
+			if (!tileOrderFromName(value, pSettings.mTileOrder))
+			{
+				pErr << "unknown tile order " << value << " (scanline, hilbert or spiral)\n";
+				return false;
+			}
+		}
+		else if (option == "--seed")
+			pSettings.mSeed = strtoull(value.c_str(), nullptr, 10);
+		else if (option == "--min-spp")
+			pSettings.mMinSamples = atoi(value.c_str());
+		else if (option == "--threshold")
+			pSettings.mAdaptiveThreshold = atof(value.c_str());
+		else if (option == "--heatmap")
+			pSettings.mHeatmapPath = value;
+		else if (option == "--pass-spp")
+			pSettings.mPassSamples = atoi(value.c_str());
+		else if (option == "--budget")
+		{
+			pSettings.mTimeBudget = atof(value.c_str());
+			pSettings.mProgressive = true;
+		}
+		else if (option == "--snapshot-every")
+			pSettings.mSnapshotInterval = atof(value.c_str());
+		else if (option == "--checkpoint")
+		{
+			pSettings.mCheckpointPath = value;
+			pSettings.mProgressive = true;
+		}
+		else if (option == "--checkpoint-every")
+			pSettings.mCheckpointInterval = atof(value.c_str());
+		else if (option == "--resume")
+		{
+			pSettings.mResumePath = value;
+			pSettings.mProgressive = true;
+		}
+		else if (option == "--denoise-passes")
+			pSettings.mDenoisePasses = atoi(value.c_str());
+		else if (option == "--aovs")
+			pSettings.mAovPrefix = value;
+		else if (option == "--scene")
+			pSettings.mScenePath = value;
+		else if (option == "--animation")
+			pSettings.mAnimationPath = value;
+		else if (option == "--coordinator")
+			pSettings.mCoordinatorPort = atoi(value.c_str());
+		else if (option == "--worker")
+			pSettings.mWorkerAddress = value;
+		else if (option == "--worker-timeout")
+			pSettings.mWorkerTimeout = atof(value.c_str());
+		else if (option == "--stats")
+			pSettings.mStatsPath = value;
+		else if (option == "--cost-heatmap")
+			pSettings.mCostHeatmapPath = value;
+		else if (option == "--output")
+		{
+			pSettings.mOutputPath = value;
+			outputGiven = true;
+		}
+		else if (option == "--format")
+		{
+			if (!imageFormatFromName(value, pSettings.mOutputFormat))
+			{
+				pErr << "unknown format " << value << " (p3, ppm, pfm or qoi)\n";
+				return false;
+			}
+		}
+		else if (option == "--sampler")
+		{
+			if (!samplerFromName(value, pSettings.mSampler))
+			{
+				pErr << "unknown sampler " << value << " (independent, stratified, sobol or halton)\n";
+				return false;
+			}
+		}
+		else if (option == "--mode")
+		{
+			if (value == "tiled")
+				pSettings.mMode = RenderMode::Tiled;
+			else if (value == "wavefront")
+				pSettings.mMode = RenderMode::Wavefront;
+			else
+			{
+				pErr << "unknown mode " << value << " (tiled or wavefront)\n";
+				return false;
+			}
+		}
+		else
+		{
+			pErr << "unknown option " << option << '\n';
+			return false;
+		}
+	}
+
+	if (pSettings.mImageWidth < 2 || pSettings.mSamplesPerPixel < 1 || pSettings.mPassSamples < 1)
+	{
+		pErr << "the width must be at least 2 and spp at least 1\n";
+		return false;
+	}
+
+	// a resumed render keeps checkpointing to the file it came from
+	if (!pSettings.mResumePath.empty() && pSettings.mCheckpointPath.empty())
+		pSettings.mCheckpointPath = pSettings.mResumePath;
+
+	if (!outputGiven)
+		pSettings.mOutputPath = string("output") + imageFormatExtension(pSettings.mOutputFormat);
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !RENDER_SETTINGS_H_
\ No newline at end of file
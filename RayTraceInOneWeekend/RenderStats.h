@@ -0,0 +1,159 @@
+// -----------------------------------------------------------------------------
+#ifndef RENDER_STATS_H_
+#define RENDER_STATS_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "Material.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// counters in the hot paths. build with RT_STATS=0 and every RT_STAT() goes
+// away completely, with it on they're plain adds to the thread's own block
+#ifndef RT_STATS
+#define RT_STATS 1
+#endif
+
+#if RT_STATS
+#define RT_STAT(pExpression) (pExpression)
+#else
+#define RT_STAT(pExpression) ((void)0)
+#endif
+
+// paths longer than this all land in the last bin of the depth histogram
+const int kStatsDepthBins = 65;
+
+// how many lanes of a packet mask are switched on
+inline int countLanes(int pMask)
+{
+	int count = 0;
+	for (; pMask != 0; pMask &= pMask - 1)
+		++count;
+	return count;
+}
+
+// -----------------------------------------------------------------------------
+
+struct StatCounters
+{
+	// ---- methods
+	void add(const StatCounters& pOther)
+	{
+		mPrimaryRays += pOther.mPrimaryRays;
+		mSecondaryRays += pOther.mSecondaryRays;
+		mSphereTests += pOther.mSphereTests;
+		mSphereHits += pOther.mSphereHits;
+		mShadowRays += pOther.mShadowRays;
+		mShadowsBlocked += pOther.mShadowsBlocked;
+		for (int t = 0; t < kNumMaterialTypes; ++t)
+			mScatters[t] += pOther.mScatters[t];
+		mAbsorbed += pOther.mAbsorbed;
+		mEscaped += pOther.mEscaped;
+		mRouletteKilled += pOther.mRouletteKilled;
+		mDepthLimited += pOther.mDepthLimited;
+		for (int d = 0; d < kStatsDepthBins; ++d)
+			mPathDepth[d] += pOther.mPathDepth[d];
+	}
+
+	void countPath(int pSegments)
+	{
+		mPathDepth[min(pSegments, kStatsDepthBins - 1)]++;
+	}
+
+	// ---- members
+	uint64_t mPrimaryRays = 0;
+	uint64_t mSecondaryRays = 0;
+	uint64_t mSphereTests = 0;
+	uint64_t mSphereHits = 0;
+	uint64_t mShadowRays = 0;		// traced toward a light by next event estimation
+	uint64_t mShadowsBlocked = 0;
+	uint64_t mScatters[kNumMaterialTypes] = {};
+	uint64_t mAbsorbed = 0;			// a material scattered nothing, lights included
+	uint64_t mEscaped = 0;			// left the scene and picked up the sky
+	uint64_t mRouletteKilled = 0;
+	uint64_t mDepthLimited = 0;		// still going at mMaxDepth
+	uint64_t mPathDepth[kStatsDepthBins] = {};
+};
+
+// -----------------------------------------------------------------------------
+
+// knows about every thread's counters. a thread's block is added into the
+// retired total when the thread ends, so render threads that have come and
+// gone are still counted. collect() and reset() are for when nothing is
+// rendering, they don't stop anyone writing
+class StatsRegistry
+{
+public:
+	// ---- methods
+	static StatsRegistry& instance()
+	{
+		static StatsRegistry registry;
+		return registry;
+	}
+
+	void attach(StatCounters* pCounters)
+	{
+		lock_guard<mutex> lock(mLock);
+		mvLive.push_back(pCounters);
+	}
+
+	void detach(StatCounters* pCounters)
+	{
+		lock_guard<mutex> lock(mLock);
+		mRetired.add(*pCounters);
+		mvLive.erase(remove(mvLive.begin(), mvLive.end(), pCounters), mvLive.end());
+	}
+
+	StatCounters collect()
+	{
+		lock_guard<mutex> lock(mLock);
+		StatCounters total = mRetired;
+		for (const StatCounters* counters : mvLive)
+			total.add(*counters);
+		return total;
+	}
+
+	void reset()
+	{
+		lock_guard<mutex> lock(mLock);
+		mRetired = StatCounters();
+		for (StatCounters* counters : mvLive)
+			*counters = StatCounters();
+	}
+
+private:
+	// ---- members
+	mutex mLock;
+	vector<StatCounters*> mvLive;
+	StatCounters mRetired;
+};
+
+// -----------------------------------------------------------------------------
+
+struct ThreadStatCounters
+{
+	ThreadStatCounters() { StatsRegistry::instance().attach(&mCounters); }
+	~ThreadStatCounters() { StatsRegistry::instance().detach(&mCounters); }
+
+	StatCounters mCounters;
+};
+
+// the calling thread's counters, nobody else writes to them
+inline StatCounters& threadStats()
+{
+	thread_local ThreadStatCounters counters;
+	return counters.mCounters;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !RENDER_STATS_H_
\ No newline at end of file
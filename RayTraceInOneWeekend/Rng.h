@@ -0,0 +1,86 @@
+// -----------------------------------------------------------------------------
+#ifndef RNG_H_
+#define RNG_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <cstdint>
+
+// -----------------------------------------------------------------------------
+
+// splitmix64 finaliser, turns nearby integers into unrelated 64 bit values
+inline uint64_t mixBits(uint64_t pValue)
+{
+	pValue += 0x9e3779b97f4a7c15ULL;
+	pValue = (pValue ^ (pValue >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	pValue = (pValue ^ (pValue >> 27)) * 0x94d049bb133111ebULL;
+	return pValue ^ (pValue >> 31);
+}
+
+// -----------------------------------------------------------------------------
+
+// the seed for one sample of one pixel. every sample gets its own stream, so
+// the image doesn't depend on which thread or tile rendered it
+inline uint64_t sampleSeed(uint64_t pRenderSeed, uint64_t pPixelIndex, uint64_t pSampleIndex)
+{
+	return mixBits(pRenderSeed ^ mixBits(pPixelIndex ^ mixBits(pSampleIndex)));
+}
+
+// -----------------------------------------------------------------------------
+
+// pcg32 (www.pcg-random.org). 16 bytes of state, cheap to seed and plenty for
+// a path tracer. one lives on the stack of whoever is drawing samples, nothing
+// is shared between threads
+class Rng
+{
+public:
+	// ---- constructors
+	explicit Rng(uint64_t pSeed = 0x853c49e6748fea9bULL, uint64_t pStream = 0xda3e39cb94b95bdbULL)
+	{
+		seed(pSeed, pStream);
+	}
+
+	// ---- methods
+	void seed(uint64_t pSeed, uint64_t pStream = 0xda3e39cb94b95bdbULL)
+	{
+		mState = 0;
+		mInc = (pStream << 1) | 1;
+		nextUint();
+		mState += pSeed;
+		nextUint();
+	}
+
+	uint32_t nextUint()
+	{
+		const uint64_t old = mState;
+		mState = old * 6364136223846793005ULL + mInc;
+		const uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+		const uint32_t rot = static_cast<uint32_t>(old >> 59);
+		return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+	}
+
+	// returns a random real in [0,1)
+	double nextDouble()
+	{
+		return nextUint() * (1.0 / 4294967296.0);
+	}
+
+	// ---- members
+	uint64_t mState;
+	uint64_t mInc;
+};
+
+// -----------------------------------------------------------------------------
+
+// for code that isn't on the render path (building scenes, benchmarks). each
+// thread gets its own fixed-seed generator so it's still reproducible
+inline Rng& threadRng()
+{
+	thread_local Rng rng;
+	return rng;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !RNG_H_
\ No newline at end of file
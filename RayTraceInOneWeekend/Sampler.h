@@ -0,0 +1,358 @@
+// -----------------------------------------------------------------------------
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "Rng.h"
+#include "vec3.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// where a sample's random numbers come from. independent is a fresh uniform
+// number every time, the book's way and the default. the others spread each
+// pixel's samples out evenly over every dimension so the noise falls faster
+// than 1/sqrt(spp):
+//	stratified - correlated multi-jittered sampling (kensler 2013), one jittered
+//				 cell per sample. it needs the sample count up front, see Sampler
+//	sobol      - owen scrambled sobol, shuffled and scrambled per dimension with
+//				 the hashes from burley's "practical hash-based owen scrambling"
+//	halton     - halton points, owen scrambled per pixel and dimension
+enum class SamplerType
+{
+	Independent,
+	Stratified,
+	Sobol,
+	Halton
+};
+
+inline const char* samplerName(SamplerType pType)
+{
+	switch (pType)
+	{
+	case SamplerType::Stratified: return "stratified";
+	case SamplerType::Sobol: return "sobol";
+	case SamplerType::Halton: return "halton";
+	default: return "independent";
+	}
+}
+
+inline bool samplerFromName(const string& pName, SamplerType& pType)
+{
+	for (SamplerType type : { SamplerType::Independent, SamplerType::Stratified, SamplerType::Sobol, SamplerType::Halton })
+	{
+		if (pName == samplerName(type))
+		{
+			pType = type;
+			return true;
+		}
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+// which dimensions of a sample go to what. the camera takes the first four,
+// then every bounce gets the next eight: up to three for the scatter, one for
+// roulette and three for picking a light and a direction toward it (see
+// Lights.h), with one spare. a bounce always starts at the same dimension however many
+// numbers the bounces before it used, so the same bounce of every sample of a
+// pixel draws from the same well spread set
+const int kPixelDimension = 0;
+const int kLensDimension = 2;
+const int kCameraDimensions = 4;
+const int kBounceDimensions = 8;
+const int kRouletteDimension = 3;
+const int kLightDimension = 4;
+
+inline int bounceDimension(int pBounce)
+{
+	return kCameraDimensions + kBounceDimensions * pBounce;
+}
+
+// -----------------------------------------------------------------------------
+
+// a number in [0, 1] pulled back under 1. anything worked out in doubles or
+// divided down can round up to exactly 1 as a float, and every sample has to
+// stay in [0, 1)
+inline Real belowOne(Real pX)
+{
+	return fmin(pX, Real(1) - numeric_limits<Real>::epsilon() / 2);
+}
+
+// 32 random bits to [0, 1)
+inline Real bitsToUnit(uint32_t pBits)
+{
+	return belowOne(static_cast<Real>(pBits * (1.0 / 4294967296.0)));
+}
+
+// kensler's hashed permutation, a random shuffle of [0, pLength) picked by pSeed
+inline uint32_t permuteIndex(uint32_t pIndex, uint32_t pLength, uint32_t pSeed)
+{
+	uint32_t w = pLength - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+	do
+	{
+		pIndex ^= pSeed;
+		pIndex *= 0xe170893d;
+		pIndex ^= pSeed >> 16;
+		pIndex ^= (pIndex & w) >> 4;
+		pIndex ^= pSeed >> 8;
+		pIndex *= 0x0929eb3f;
+		pIndex ^= pSeed >> 23;
+		pIndex ^= (pIndex & w) >> 1;
+		pIndex *= 1 | pSeed >> 27;
+		pIndex *= 0x6935fa69;
+		pIndex ^= (pIndex & w) >> 11;
+		pIndex *= 0x74dcb303;
+		pIndex ^= (pIndex & w) >> 2;
+		pIndex *= 0x9e501cc3;
+		pIndex ^= (pIndex & w) >> 2;
+		pIndex *= 0xc860a3df;
+		pIndex &= w;
+		pIndex ^= pIndex >> 5;
+	} while (pIndex >= pLength);
+	return (pIndex + pSeed) % pLength;
+}
+
+inline uint32_t hashBits(uint32_t pIndex, uint32_t pSeed)
+{
+	return static_cast<uint32_t>(mixBits((static_cast<uint64_t>(pSeed) << 32) | pIndex));
+}
+
+// -----------------------------------------------------------------------------
+
+inline uint32_t reverseBits(uint32_t pBits)
+{
+	pBits = (pBits << 16) | (pBits >> 16);
+	pBits = ((pBits & 0x00ff00ff) << 8) | ((pBits & 0xff00ff00) >> 8);
+	pBits = ((pBits & 0x0f0f0f0f) << 4) | ((pBits & 0xf0f0f0f0) >> 4);
+	pBits = ((pBits & 0x33333333) << 2) | ((pBits & 0xcccccccc) >> 2);
+	pBits = ((pBits & 0x55555555) << 1) | ((pBits & 0xaaaaaaaa) >> 1);
+	return pBits;
+}
+
+// a random owen scramble of the bits, each bit flipped by a hash of the bits
+// above it. laine and karras' hash as tuned by burley
+inline uint32_t owenScramble(uint32_t pBits, uint32_t pSeed)
+{
+	pBits = reverseBits(pBits);
+	pBits += pSeed;
+	pBits ^= pBits * 0x6c50b47cu;
+	pBits ^= pBits * 0xb82f1e52u;
+	pBits ^= pBits * 0xc7afe638u;
+	pBits ^= pBits * 0x8d22f6e6u;
+	return reverseBits(pBits);
+}
+
+// the first two sobol dimensions. the first is the bits reversed, the second's
+// direction numbers are each the one before xored with itself shifted by one
+inline void sobol2D(uint32_t pIndex, uint32_t& pX, uint32_t& pY)
+{
+	pX = reverseBits(pIndex);
+	pY = 0;
+	for (uint32_t direction = 1u << 31; pIndex; pIndex >>= 1, direction ^= direction >> 1)
+	{
+		if (pIndex & 1)
+			pY ^= direction;
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+const int kHaltonDimensions = 64;
+const uint32_t kHaltonBases[kHaltonDimensions] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+	59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167,
+	173, 179, 181, 191, 193, 197, 199, 211, 223, 227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281,
+	283, 293, 307, 311 };
+
+// the digits of pIndex in base pBase mirrored about the point, with a nested
+// (owen) scramble: each digit is shuffled by a permutation picked by the digits
+// before it. past the last digit of pIndex they're all scrambled zeros, which
+// are as good as a uniform random remainder, so that's what's added instead
+// of working them out one at a time
+inline double scrambledRadicalInverse(uint64_t pIndex, uint32_t pBase, uint32_t pSeed)
+{
+	const double inverseBase = 1.0 / pBase;
+	double scale = 1.0;
+	uint64_t digits = 0;
+	for (uint64_t level = 1; pIndex > 0; pIndex /= pBase, ++level)
+	{
+		const uint32_t digitSeed = static_cast<uint32_t>(mixBits(digits ^ mixBits(level ^ pSeed)));
+		digits = digits * pBase + permuteIndex(static_cast<uint32_t>(pIndex % pBase), pBase, digitSeed);
+		scale *= inverseBase;
+	}
+	const uint64_t rest = mixBits(digits ^ mixBits(~static_cast<uint64_t>(pSeed)));
+	return (static_cast<double>(digits) + (rest >> 11) * (1.0 / 9007199254740992.0)) * scale;
+}
+
+// -----------------------------------------------------------------------------
+
+// hands out the random numbers of one sample of one pixel, already warped to
+// whatever shape the caller needs. one lives wherever an Rng used to, seeded
+// per sample by startSample() so a sample's numbers never depend on what thread
+// or tile took it. the independent sampler's shapes are the same numbers
+// through the same warps as randomInUnitDisk() and friends in vec3.h.
+// pSamplesPerPixel is only for the stratified sampler, which spreads every run
+// of that many samples of a pixel over a grid. dimensions past the end of the
+// halton table go back to independent numbers, by then a path has bounced
+// often enough that it hardly matters
+class Sampler
+{
+public:
+	// ---- constructors
+	Sampler() {}
+	Sampler(SamplerType pType, int pSamplesPerPixel, uint64_t pSeed)
+		: mType(pType)
+		, mSeed(pSeed)
+		, mSamplesPerPixel(static_cast<uint32_t>(pSamplesPerPixel > 0 ? pSamplesPerPixel : 1))
+	{
+	}
+
+	// ---- methods
+	void startSample(uint64_t pPixelIndex, uint64_t pSampleIndex)
+	{
+		mRng.seed(sampleSeed(mSeed, pPixelIndex, pSampleIndex));
+		mPixel = pPixelIndex;
+		mSample = pSampleIndex;
+		mDimension = 0;
+	}
+
+	void setDimension(int pDimension) { mDimension = pDimension; }
+
+	Real get1D()
+	{
+		switch (mType)
+		{
+		case SamplerType::Stratified:
+		{
+			const uint32_t seed = dimensionSeed();
+			const uint32_t index = static_cast<uint32_t>(mSample % mSamplesPerPixel);
+			const uint32_t cell = permuteIndex(index, mSamplesPerPixel, seed);
+			return belowOne((cell + bitsToUnit(hashBits(index, seed * 0xa399d265))) / mSamplesPerPixel);
+		}
+		case SamplerType::Sobol:
+		{
+			const uint32_t seed = dimensionSeed();
+			const uint32_t index = owenScramble(static_cast<uint32_t>(mSample), seed);
+			return bitsToUnit(owenScramble(reverseBits(index), hashBits(0, seed)));
+		}
+		case SamplerType::Halton:
+			if (mDimension < kHaltonDimensions)
+			{
+				const Real x = halton(mDimension);
+				++mDimension;
+				return x;
+			}
+			break;
+		default:
+			break;
+		}
+		++mDimension;
+		return belowOne(static_cast<Real>(randomDouble(mRng)));
+	}
+
+	void get2D(Real& pU, Real& pV)
+	{
+		switch (mType)
+		{
+		case SamplerType::Stratified:
+		{
+			// kensler's correlated multi-jittered pattern, an m by n grid that each
+			// row and column of is also stratified
+			const uint32_t seed = dimensionSeed();
+			const uint32_t count = mSamplesPerPixel;
+			const uint32_t m = static_cast<uint32_t>(sqrt(static_cast<double>(count)));
+			const uint32_t n = (count + m - 1) / m;
+			const uint32_t index = permuteIndex(static_cast<uint32_t>(mSample % count), count, seed * 0x51633e2d);
+			const uint32_t sx = permuteIndex(index % m, m, seed * 0x68bc21eb);
+			const uint32_t sy = permuteIndex(index / m, n, seed * 0x02e5be93);
+			const Real jx = bitsToUnit(hashBits(index, seed * 0x967a889b));
+			const Real jy = bitsToUnit(hashBits(index, seed * 0x368cc8b7));
+			pU = belowOne((sx + (sy + jx) / n) / m);
+			pV = belowOne((index + jy) / count);
+			mDimension += 2;
+			return;
+		}
+		case SamplerType::Sobol:
+		{
+			const uint32_t seed = dimensionSeed();
+			uint32_t x, y;
+			sobol2D(owenScramble(static_cast<uint32_t>(mSample), seed), x, y);
+			pU = bitsToUnit(owenScramble(x, hashBits(0, seed)));
+			pV = bitsToUnit(owenScramble(y, hashBits(1, seed)));
+			mDimension += 2;
+			return;
+		}
+		default:
+			pU = get1D();
+			pV = get1D();
+			return;
+		}
+	}
+
+	vec3 inUnitDisk()
+	{
+		Real u, v;
+		get2D(u, v);
+		return squareToUnitDisk(u, v);
+	}
+
+	vec3 unitVector()
+	{
+		Real u, v;
+		get2D(u, v);
+		return squareToUnitSphere(u, v);
+	}
+
+	vec3 inUnitSphere()
+	{
+		Real u, v;
+		get2D(u, v);
+		return cubeToUnitBall(u, v, get1D());
+	}
+
+	SamplerType type() const { return mType; }
+	Rng& rng() { return mRng; }
+
+private:
+	// every pixel and dimension gets its own scramble, so neighbouring pixels'
+	// noise doesn't line up and nor do the dimensions of one sample. the
+	// stratified sampler's pattern changes with every run of mSamplesPerPixel
+	uint32_t dimensionSeed() const
+	{
+		const uint64_t round = mType == SamplerType::Stratified ? mSample / mSamplesPerPixel : 0;
+		return static_cast<uint32_t>(mixBits(mSeed ^ mixBits(mPixel ^ mixBits((round << 16) + mDimension))));
+	}
+
+	Real halton(int pDimension) const
+	{
+		const double x = scrambledRadicalInverse(mSample, kHaltonBases[pDimension], dimensionSeed());
+		return belowOne(static_cast<Real>(x));
+	}
+
+	// ---- members
+	Rng mRng;
+	SamplerType mType = SamplerType::Independent;
+	uint64_t mSeed = 0;
+	uint64_t mPixel = 0;
+	uint64_t mSample = 0;
+	uint32_t mSamplesPerPixel = 1;
+	int mDimension = 0;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !SAMPLER_H_
\ No newline at end of file
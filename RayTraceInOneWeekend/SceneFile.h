@@ -0,0 +1,578 @@
+// -----------------------------------------------------------------------------
+#ifndef SCENE_FILE_H_
+#define SCENE_FILE_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "Camera.h"
+#include "CompiledScene.h"
+#include "MappedFile.h"
+#include "Material.h"
+#include "Span.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// scenes come in two kinds of file. the text one is for people:
+//
+//   # anything after a hash is a comment
+//   camera lookfrom 13 2 3 lookat 0 0 0 up 0 1 0 fov 20 aperture 0.1 focus 10
+//   material ground lambertian 0.5 0.5 0.5
+//   material mirror metal 0.7 0.6 0.5 0.0
+//   material glass dielectric 1.5
+//   material lamp diffuse_light 4 4 4
+//   sphere 0 -1000 0 1000 ground
+//
+// every camera keyword is optional and materials have to come before the
+// spheres that use them. the binary one (.rtsb) is for loading fast: a header
+// and then a CompiledScene arena exactly as it sits in memory, so loading it is
+// one mmap and no parsing, copying or bvh building. it's only good for the
+// precision and byte order it was written with, the header says which
+
+// -----------------------------------------------------------------------------
+
+// the camera as a scene describes it, Camera itself only keeps what getRay
+// needs. the defaults are the book's final render
+struct SceneCamera
+{
+	// ---- methods
+	Camera makeCamera(Real pAspectRatio) const
+	{
+		return Camera(mLookFrom, mLookAt, mUp, mVerticalFov, pAspectRatio, mAperture, mFocusDistance);
+	}
+
+	// ---- members
+	point3 mLookFrom = point3(13, 2, 3);
+	point3 mLookAt = point3(0, 0, 0);
+	vec3 mUp = vec3(0, 1, 0);
+	Real mVerticalFov = 20;
+	Real mAperture = 0.1;
+	Real mFocusDistance = 10;
+};
+
+// -----------------------------------------------------------------------------
+
+// a scene the way the text format holds it, flat arrays ready for a
+// CompiledScene and no hittables
+struct SceneDescription
+{
+	SceneCamera mCamera;
+	MaterialTable mMaterials;
+	vector<CompiledSphere> mSpheres;
+};
+
+// -----------------------------------------------------------------------------
+
+const char kSceneBinaryExtension[] = ".rtsb";
+
+inline bool hasExtension(const string& pPath, const char* pExtension)
+{
+	const size_t length = strlen(pExtension);
+	return pPath.size() >= length && pPath.compare(pPath.size() - length, length, pExtension) == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// walks the text a token at a time. the text has to end in a null, which
+// std::string guarantees, so strtod can never run off the end
+class SceneTextReader
+{
+public:
+	// ---- constructors
+	SceneTextReader(const char* pText) : mCursor(pText) {}
+
+	// ---- methods
+	// skips spaces and comments up to the end of the line, returns false there
+	bool moreOnLine()
+	{
+		while (*mCursor == ' ' || *mCursor == '\t' || *mCursor == '\r')
+			++mCursor;
+		if (*mCursor == '#')
+		{
+			while (*mCursor != '\n' && *mCursor != '\0')
+				++mCursor;
+		}
+		return *mCursor != '\n' && *mCursor != '\0';
+	}
+
+	// moves onto the next line, returns false at the end of the text
+	bool nextLine()
+	{
+		while (*mCursor != '\n' && *mCursor != '\0')
+			++mCursor;
+		if (*mCursor == '\0')
+			return false;
+		++mCursor;
+		++mLine;
+		return true;
+	}
+
+	bool token(string& pToken)
+	{
+		if (!moreOnLine())
+			return false;
+		const char* start = mCursor;
+		while (*mCursor != ' ' && *mCursor != '\t' && *mCursor != '\r' && *mCursor != '\n' && *mCursor != '\0')
+			++mCursor;
+		pToken.assign(start, mCursor);
+		return true;
+	}
+
+	bool number(Real& pValue)
+	{
+		if (!moreOnLine())
+			return false;
+		char* end;
+		const double value = strtod(mCursor, &end);
+		if (end == mCursor || (*end != ' ' && *end != '\t' && *end != '\r' && *end != '\n' && *end != '\0' && *end != '#'))
+			return false;
+		mCursor = end;
+		pValue = static_cast<Real>(value);
+		return true;
+	}
+
+	bool point(vec3& pValue)
+	{
+		Real x, y, z;
+		if (!number(x) || !number(y) || !number(z))
+			return false;
+		pValue = vec3(x, y, z);
+		return true;
+	}
+
+	int line() const { return mLine; }
+
+private:
+	// ---- members
+	const char* mCursor;
+	int mLine = 1;
+};
+
+// -----------------------------------------------------------------------------
+
+bool parseSceneText(const string& pText, SceneDescription& pScene, string& pError)
+{
+	SceneTextReader reader(pText.c_str());
+	unordered_map<string, MaterialId> materialIds;
+	string keyword, name;
+
+	auto fail = [&](const string& pWhat)
+	{
+		pError = "line " + to_string(reader.line()) + ": " + pWhat;
+		return false;
+	};
+
+	do
+	{
+		if (!reader.token(keyword))
+			continue;
+
+		if (keyword == "sphere")
+		{
+			CompiledSphere sphere;
+			if (!reader.point(sphere.mCenter) || !reader.number(sphere.mRadius) || !reader.token(name))
+				return fail("expected sphere <x> <y> <z> <radius> <material>");
+
+			const auto material = materialIds.find(name);
+			if (material == materialIds.end())
+				return fail("no material called " + name);
+			sphere.mMaterialId = material->second;
+			pScene.mSpheres.push_back(sphere);
+		}
+		else if (keyword == "material")
+		{
+			string type;
+			if (!reader.token(name) || !reader.token(type))
+				return fail("expected material <name> <type> ...");
+			if (materialIds.count(name))
+				return fail("material " + name + " is already defined");
+
+			colour albedo;
+			Real value;
+			if (type == materialTypeName(MaterialType::Lambertian))
+			{
+				if (!reader.point(albedo))
+					return fail("expected material <name> lambertian <r> <g> <b>");
+				materialIds[name] = pScene.mMaterials.add(Lambertian(albedo));
+			}
+			else if (type == materialTypeName(MaterialType::Metal))
+			{
+				if (!reader.point(albedo) || !reader.number(value))
+					return fail("expected material <name> metal <r> <g> <b> <fuzz>");
+				materialIds[name] = pScene.mMaterials.add(Metal(albedo, value));
+			}
+			else if (type == materialTypeName(MaterialType::Dielectric))
+			{
+				if (!reader.number(value))
+					return fail("expected material <name> dielectric <index of refraction>");
+				materialIds[name] = pScene.mMaterials.add(Dielectric(value));
+			}
+			else if (type == materialTypeName(MaterialType::DiffuseLight))
+			{
+				if (!reader.point(albedo))
+					return fail("expected material <name> diffuse_light <r> <g> <b>");
+				materialIds[name] = pScene.mMaterials.add(DiffuseLight(albedo));
+			}
+			else
+			{
+				return fail("unknown material type " + type);
+			}
+		}
+		else if (keyword == "camera")
+		{
+			SceneCamera& camera = pScene.mCamera;
+			string field;
+			while (reader.token(field))
+			{
+				bool ok = false;
+				if (field == "lookfrom")
+					ok = reader.point(camera.mLookFrom);
+				else if (field == "lookat")
+					ok = reader.point(camera.mLookAt);
+				else if (field == "up")
+					ok = reader.point(camera.mUp);
+				else if (field == "fov")
+					ok = reader.number(camera.mVerticalFov);
+				else if (field == "aperture")
+					ok = reader.number(camera.mAperture);
+				else if (field == "focus")
+					ok = reader.number(camera.mFocusDistance);
+				else
+					return fail("unknown camera setting " + field);
+
+				if (!ok)
+					return fail("bad value for camera " + field);
+			}
+		}
+		else
+		{
+			return fail("unknown keyword " + keyword);
+		}
+
+		if (reader.moreOnLine())
+			return fail("unexpected text after " + keyword);
+	} while (reader.nextLine());
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool loadSceneText(const string& pPath, SceneDescription& pScene, string& pError)
+{
+	ifstream file(pPath, ios::binary);
+	if (!file)
+	{
+		pError = "couldn't open " + pPath;
+		return false;
+	}
+
+	// one read of the whole file, it's parsed in place
+	file.seekg(0, ios::end);
+	string text(static_cast<size_t>(file.tellg()), '\0');
+	file.seekg(0, ios::beg);
+	file.read(&text[0], text.size());
+	if (!file)
+	{
+		pError = "couldn't read " + pPath;
+		return false;
+	}
+
+	return parseSceneText(text, pScene, pError);
+}
+
+// -----------------------------------------------------------------------------
+
+// materials are written out as m0, m1... in table order. numbers get enough
+// digits to come back exactly, so text -> binary -> text changes nothing
+void writeSceneText(ostream& pOut, const SceneCamera& pCamera, Span<const CompiledSphere> pSpheres,
+	Span<const Material> pMaterials)
+{
+	pOut << setprecision(numeric_limits<Real>::max_digits10);
+
+	auto writePoint = [&](const vec3& pPoint)
+	{
+		pOut << pPoint.x() << ' ' << pPoint.y() << ' ' << pPoint.z();
+	};
+
+	pOut << "# " << pSpheres.size() << " spheres, " << pMaterials.size() << " materials\n";
+	pOut << "camera lookfrom ";
+	writePoint(pCamera.mLookFrom);
+	pOut << " lookat ";
+	writePoint(pCamera.mLookAt);
+	pOut << " up ";
+	writePoint(pCamera.mUp);
+	pOut << " fov " << pCamera.mVerticalFov << " aperture " << pCamera.mAperture
+		<< " focus " << pCamera.mFocusDistance << '\n';
+
+	for (size_t m = 0; m < pMaterials.size(); ++m)
+	{
+		const Material& material = pMaterials[m];
+		pOut << "material m" << m << ' ' << materialTypeName(material.mType) << ' ';
+		switch (material.mType)
+		{
+		case MaterialType::Lambertian: writePoint(material.mAlbedo); break;
+		case MaterialType::Metal: writePoint(material.mAlbedo); pOut << ' ' << material.mFuzz; break;
+		case MaterialType::Dielectric: pOut << material.mIndexOfRefraction; break;
+		case MaterialType::DiffuseLight: writePoint(DiffuseLight::emitted(material)); break;
+		}
+		pOut << '\n';
+	}
+
+	for (const CompiledSphere& sphere : pSpheres)
+	{
+		pOut << "sphere ";
+		writePoint(sphere.mCenter);
+		pOut << ' ' << sphere.mRadius << " m" << sphere.mMaterialId << '\n';
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// the start of a binary scene. the arena follows at mArenaOffset, which is a
+// multiple of the cache line size, and mmap always hands back a page aligned
+// address, so the arena is exactly as aligned as one CompiledScene builds
+struct SceneFileHeader
+{
+	char mMagic[8];
+	uint32_t mVersion;
+	uint32_t mRealSize;
+	uint32_t mNodeSize;
+	uint32_t mSphereSize;
+	uint32_t mMaterialSize;
+	uint32_t mLightSize;
+	uint32_t mByteOrder;
+	SceneCamera mCamera;
+	CompiledSceneLayout mLayout;
+	uint64_t mContentHash;
+	uint64_t mArenaOffset;
+};
+
+const char kSceneMagic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+const uint32_t kSceneVersion = 3;
+const uint32_t kSceneByteOrder = 0x01020304;
+
+// -----------------------------------------------------------------------------
+
+bool saveSceneBinary(const string& pPath, const SceneCamera& pCamera, const CompiledScene& pScene, string& pError)
+{
+	static_assert(is_trivially_copyable<SceneFileHeader>::value, "SceneFileHeader is written as raw bytes");
+
+	if (!pScene.mOthers.mvObjects.empty())
+	{
+		pError = "only spheres can go in a binary scene";
+		return false;
+	}
+
+	SceneFileHeader header;
+	memset(static_cast<void*>(&header), 0, sizeof(header));
+	memcpy(header.mMagic, kSceneMagic, sizeof(kSceneMagic));
+	header.mVersion = kSceneVersion;
+	header.mRealSize = sizeof(Real);
+	header.mNodeSize = sizeof(BvhNode);
+	header.mSphereSize = sizeof(CompiledSphere);
+	header.mMaterialSize = sizeof(Material);
+	header.mLightSize = sizeof(SphereLight);
+	header.mByteOrder = kSceneByteOrder;
+	header.mCamera = pCamera;
+	header.mLayout = pScene.mLayout;
+	header.mContentHash = pScene.contentHash();
+	header.mArenaOffset = alignToCacheLine(sizeof(SceneFileHeader));
+
+	ofstream file(pPath, ios::binary);
+	const char padding[kCacheLineSize] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(padding, static_cast<streamsize>(header.mArenaOffset - sizeof(header)));
+	file.write(reinterpret_cast<const char*>(pScene.data()), static_cast<streamsize>(pScene.sizeInBytes()));
+	if (!file)
+	{
+		pError = "couldn't write " + pPath;
+		return false;
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// where the time went loading a scene. read is opening and parsing (or mapping)
+// the file, build is making the bvh and the arena, which binary files skip
+struct SceneLoadTimes
+{
+	double mRead = 0.0;
+	double mBuild = 0.0;
+};
+
+// -----------------------------------------------------------------------------
+
+// a scene from either kind of file, ready to render. a binary scene renders
+// straight out of the mapping, so it has to stay alive as long as the scene does
+class LoadedScene
+{
+public:
+	// ---- methods
+	// text or binary is decided by the file's first bytes, not its name
+	bool load(const string& pPath, string& pError)
+	{
+		mScene.reset();
+		mFile.close();
+
+		ifstream probe(pPath, ios::binary);
+		char magic[sizeof(kSceneMagic)] = {};
+		probe.read(magic, sizeof(magic));
+		if (!probe && !probe.eof())
+		{
+			pError = "couldn't open " + pPath;
+			return false;
+		}
+		probe.close();
+
+		if (memcmp(magic, kSceneMagic, sizeof(magic)) == 0)
+			return loadBinary(pPath, pError);
+		return loadText(pPath, pError);
+	}
+
+	const CompiledScene& scene() const { return *mScene; }
+	bool isMapped() const { return mFile.isOpen(); }
+
+	// ---- members
+	SceneCamera mCamera;
+	SceneLoadTimes mTimes;
+
+private:
+	typedef chrono::steady_clock Clock;
+
+	static double secondsSince(Clock::time_point pStart)
+	{
+		return chrono::duration<double>(Clock::now() - pStart).count();
+	}
+
+	bool loadText(const string& pPath, string& pError)
+	{
+		auto start = Clock::now();
+		SceneDescription description;
+		if (!loadSceneText(pPath, description, pError))
+			return false;
+		mTimes.mRead = secondsSince(start);
+
+		start = Clock::now();
+		mScene.reset(new CompiledScene(
+			Span<const CompiledSphere>(description.mSpheres.data(), description.mSpheres.size()),
+			description.mMaterials));
+		mTimes.mBuild = secondsSince(start);
+
+		mCamera = description.mCamera;
+		return true;
+	}
+
+	// everything is checked against the header and the file size, but the
+	// contents of the sections are trusted. looking at them would page in the
+	// whole file, which is what the format is there to avoid
+	bool loadBinary(const string& pPath, string& pError)
+	{
+		const auto start = Clock::now();
+		if (!mFile.open(pPath))
+		{
+			pError = "couldn't map " + pPath;
+			return false;
+		}
+
+		SceneFileHeader header;
+		if (mFile.size() < sizeof(header))
+		{
+			pError = pPath + " is too short to be a scene";
+			return false;
+		}
+		memcpy(&header, mFile.data(), sizeof(header));
+
+		if (header.mVersion != kSceneVersion || header.mByteOrder != kSceneByteOrder)
+		{
+			pError = pPath + " is a different version or byte order";
+			return false;
+		}
+		if (header.mRealSize != sizeof(Real) || header.mNodeSize != sizeof(BvhNode)
+			|| header.mSphereSize != sizeof(CompiledSphere) || header.mMaterialSize != sizeof(Material)
+			|| header.mLightSize != sizeof(SphereLight))
+		{
+			pError = pPath + " was written by a " + (header.mRealSize == 4 ? "float" : "double")
+				+ " build, this is a " + kPrecisionName + " one";
+			return false;
+		}
+
+		const CompiledSceneLayout& layout = header.mLayout;
+		auto fits = [&](uint64_t pOffset, uint64_t pCount, uint64_t pSize)
+		{
+			return pOffset % kCacheLineSize == 0 && pCount <= layout.mSize / pSize
+				&& pOffset <= layout.mSize && pCount * pSize <= layout.mSize - pOffset;
+		};
+		if (header.mArenaOffset % kCacheLineSize != 0 || header.mArenaOffset > mFile.size()
+			|| layout.mSize > mFile.size() - header.mArenaOffset
+			|| !fits(layout.mNodeOffset, layout.mNodeCount, sizeof(BvhNode))
+			|| !fits(layout.mSphereOffset, layout.mSphereCount, sizeof(CompiledSphere))
+			|| !fits(layout.mMaterialOffset, layout.mMaterialCount, sizeof(Material))
+			|| !fits(layout.mLightOffset, layout.mLightCount, sizeof(SphereLight)))
+		{
+			pError = pPath + " is truncated or its layout is corrupt";
+			return false;
+		}
+
+		mScene.reset(new CompiledScene(layout, mFile.data() + header.mArenaOffset, header.mContentHash));
+		mCamera = header.mCamera;
+		mTimes.mRead = secondsSince(start);
+		mTimes.mBuild = 0.0;
+		return true;
+	}
+
+	// ---- members
+	MappedFile mFile;
+	unique_ptr<CompiledScene> mScene;
+};
+
+// -----------------------------------------------------------------------------
+
+// a cheap check that two renders have the same scene, a worker and its
+// coordinator or a checkpoint and the run resuming it: the section sizes, the
+// root bounds, every sphere and material through the scene's content hash,
+// and the camera. the hash was worked out when the scene was compiled and a
+// mapped file carries it in its header, so nothing here reads the sections,
+// which for a mapped file would mean paging all of it in
+uint64_t sceneFingerprint(const CompiledScene& pScene, const SceneCamera& pCamera)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	auto mix = [&](const void* pData, size_t pSize)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(pData);
+		for (size_t i = 0; i < pSize; ++i)
+			hash = (hash ^ data[i]) * 0x100000001b3ULL;
+	};
+
+	mix(&pScene.mLayout, sizeof(pScene.mLayout));
+	if (!pScene.mNodes.empty())
+		mix(&pScene.mNodes[0], sizeof(BvhNode));
+	const uint64_t contents = pScene.contentHash();
+	mix(&contents, sizeof(contents));
+	mix(&pCamera, sizeof(pCamera));
+
+	const uint64_t others = pScene.mOthers.mvObjects.size();
+	mix(&others, sizeof(others));
+	return hash;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !SCENE_FILE_H_
\ No newline at end of file
@@ -0,0 +1,276 @@
+// -----------------------------------------------------------------------------
+#ifndef SIMD_H_
+#define SIMD_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <cmath>
+
+// the instruction set is picked at build time from what the compiler is
+// targeting (/arch:AVX2 or -mavx2 for avx, sse2 is always there on x64).
+// define RT_NO_SIMD to force the plain scalar fallback
+#if !defined(RT_NO_SIMD) && defined(__AVX__)
+	#define RT_SIMD_AVX 1
+	#include <immintrin.h>
+#elif !defined(RT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define RT_SIMD_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define RT_SIMD_SCALAR 1
+#endif
+
+// -----------------------------------------------------------------------------
+
+// four doubles processed together. with avx that's one register, with sse2
+// it's two and the scalar version is just an array the compiler may or may
+// not vectorise. masks use the same type, all bits set in a lane means true
+struct Double4
+{
+	static const int kWidth = 4;
+
+#if RT_SIMD_AVX
+	__m256d v;
+
+	Double4() {}
+	Double4(__m256d pV) : v(pV) {}
+	explicit Double4(double pS) : v(_mm256_set1_pd(pS)) {}
+	Double4(double p0, double p1, double p2, double p3) : v(_mm256_setr_pd(p0, p1, p2, p3)) {}
+
+	static Double4 load(const double* pPtr) { return _mm256_loadu_pd(pPtr); }
+	void store(double* pPtr) const { _mm256_storeu_pd(pPtr, v); }
+
+	friend Double4 operator+(Double4 a, Double4 b) { return _mm256_add_pd(a.v, b.v); }
+	friend Double4 operator-(Double4 a, Double4 b) { return _mm256_sub_pd(a.v, b.v); }
+	friend Double4 operator*(Double4 a, Double4 b) { return _mm256_mul_pd(a.v, b.v); }
+	friend Double4 operator/(Double4 a, Double4 b) { return _mm256_div_pd(a.v, b.v); }
+	friend Double4 operator&(Double4 a, Double4 b) { return _mm256_and_pd(a.v, b.v); }
+	friend Double4 operator|(Double4 a, Double4 b) { return _mm256_or_pd(a.v, b.v); }
+	friend Double4 operator<(Double4 a, Double4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+	friend Double4 operator<=(Double4 a, Double4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+	friend Double4 operator>=(Double4 a, Double4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+
+	friend Double4 sqrt(Double4 a) { return _mm256_sqrt_pd(a.v); }
+	friend Double4 min(Double4 a, Double4 b) { return _mm256_min_pd(a.v, b.v); }
+	friend Double4 max(Double4 a, Double4 b) { return _mm256_max_pd(a.v, b.v); }
+
+	// picks pA where the mask is set, otherwise pB
+	friend Double4 select(Double4 pMask, Double4 pA, Double4 pB) { return _mm256_blendv_pd(pB.v, pA.v, pMask.v); }
+	friend int moveMask(Double4 pMask) { return _mm256_movemask_pd(pMask.v); }
+#elif RT_SIMD_SSE2
+	__m128d lo, hi;
+
+	Double4() {}
+	Double4(__m128d pLo, __m128d pHi) : lo(pLo), hi(pHi) {}
+	explicit Double4(double pS) : lo(_mm_set1_pd(pS)), hi(_mm_set1_pd(pS)) {}
+	Double4(double p0, double p1, double p2, double p3) : lo(_mm_setr_pd(p0, p1)), hi(_mm_setr_pd(p2, p3)) {}
+
+	static Double4 load(const double* pPtr) { return Double4(_mm_loadu_pd(pPtr), _mm_loadu_pd(pPtr + 2)); }
+	void store(double* pPtr) const { _mm_storeu_pd(pPtr, lo); _mm_storeu_pd(pPtr + 2, hi); }
+
+	friend Double4 operator+(Double4 a, Double4 b) { return Double4(_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)); }
+	friend Double4 operator-(Double4 a, Double4 b) { return Double4(_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)); }
+	friend Double4 operator*(Double4 a, Double4 b) { return Double4(_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)); }
+	friend Double4 operator/(Double4 a, Double4 b) { return Double4(_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)); }
+	friend Double4 operator&(Double4 a, Double4 b) { return Double4(_mm_and_pd(a.lo, b.lo), _mm_and_pd(a.hi, b.hi)); }
+	friend Double4 operator|(Double4 a, Double4 b) { return Double4(_mm_or_pd(a.lo, b.lo), _mm_or_pd(a.hi, b.hi)); }
+	friend Double4 operator<(Double4 a, Double4 b) { return Double4(_mm_cmplt_pd(a.lo, b.lo), _mm_cmplt_pd(a.hi, b.hi)); }
+	friend Double4 operator<=(Double4 a, Double4 b) { return Double4(_mm_cmple_pd(a.lo, b.lo), _mm_cmple_pd(a.hi, b.hi)); }
+	friend Double4 operator>=(Double4 a, Double4 b) { return Double4(_mm_cmpge_pd(a.lo, b.lo), _mm_cmpge_pd(a.hi, b.hi)); }
+
+	friend Double4 sqrt(Double4 a) { return Double4(_mm_sqrt_pd(a.lo), _mm_sqrt_pd(a.hi)); }
+	friend Double4 min(Double4 a, Double4 b) { return Double4(_mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi)); }
+	friend Double4 max(Double4 a, Double4 b) { return Double4(_mm_max_pd(a.lo, b.lo), _mm_max_pd(a.hi, b.hi)); }
+
+	friend Double4 select(Double4 pMask, Double4 pA, Double4 pB)
+	{
+		return Double4(_mm_or_pd(_mm_and_pd(pMask.lo, pA.lo), _mm_andnot_pd(pMask.lo, pB.lo)),
+			_mm_or_pd(_mm_and_pd(pMask.hi, pA.hi), _mm_andnot_pd(pMask.hi, pB.hi)));
+	}
+	friend int moveMask(Double4 pMask) { return _mm_movemask_pd(pMask.lo) | (_mm_movemask_pd(pMask.hi) << 2); }
+#else
+	double v[4];
+
+	Double4() {}
+	explicit Double4(double pS) : v{ pS, pS, pS, pS } {}
+	Double4(double p0, double p1, double p2, double p3) : v{ p0, p1, p2, p3 } {}
+
+	static Double4 load(const double* pPtr) { return Double4(pPtr[0], pPtr[1], pPtr[2], pPtr[3]); }
+	void store(double* pPtr) const { for (int i = 0; i < 4; ++i) pPtr[i] = v[i]; }
+
+	// masks are kept as 1.0 / 0.0 here, only select and moveMask look at them
+	template<typename Op>
+	static Double4 apply(Double4 a, Double4 b, Op pOp)
+	{
+		return Double4(pOp(a.v[0], b.v[0]), pOp(a.v[1], b.v[1]), pOp(a.v[2], b.v[2]), pOp(a.v[3], b.v[3]));
+	}
+
+	friend Double4 operator+(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x + y; }); }
+	friend Double4 operator-(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x - y; }); }
+	friend Double4 operator*(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x * y; }); }
+	friend Double4 operator/(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x / y; }); }
+	friend Double4 operator&(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return (x != 0.0 && y != 0.0) ? 1.0 : 0.0; }); }
+	friend Double4 operator|(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return (x != 0.0 || y != 0.0) ? 1.0 : 0.0; }); }
+	friend Double4 operator<(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x < y ? 1.0 : 0.0; }); }
+	friend Double4 operator<=(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x <= y ? 1.0 : 0.0; }); }
+	friend Double4 operator>=(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x >= y ? 1.0 : 0.0; }); }
+
+	friend Double4 sqrt(Double4 a) { return Double4(std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])); }
+	friend Double4 min(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x < y ? x : y; }); }
+	friend Double4 max(Double4 a, Double4 b) { return apply(a, b, [](double x, double y) { return x > y ? x : y; }); }
+
+	friend Double4 select(Double4 pMask, Double4 pA, Double4 pB)
+	{
+		Double4 r;
+		for (int i = 0; i < 4; ++i)
+			r.v[i] = pMask.v[i] != 0.0 ? pA.v[i] : pB.v[i];
+		return r;
+	}
+	friend int moveMask(Double4 pMask)
+	{
+		return (pMask.v[0] != 0.0) | ((pMask.v[1] != 0.0) << 1) | ((pMask.v[2] != 0.0) << 2) | ((pMask.v[3] != 0.0) << 3);
+	}
+#endif
+};
+
+// -----------------------------------------------------------------------------
+
+// eight floats, the single precision twin of Double4. twice the lanes in the
+// same register width
+struct Float8
+{
+	static const int kWidth = 8;
+
+#if RT_SIMD_AVX
+	__m256 v;
+
+	Float8() {}
+	Float8(__m256 pV) : v(pV) {}
+	explicit Float8(float pS) : v(_mm256_set1_ps(pS)) {}
+
+	static Float8 load(const float* pPtr) { return _mm256_loadu_ps(pPtr); }
+	void store(float* pPtr) const { _mm256_storeu_ps(pPtr, v); }
+
+	friend Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+	friend Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+	friend Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+	friend Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+	friend Float8 operator&(Float8 a, Float8 b) { return _mm256_and_ps(a.v, b.v); }
+	friend Float8 operator|(Float8 a, Float8 b) { return _mm256_or_ps(a.v, b.v); }
+	friend Float8 operator<(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	friend Float8 operator<=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+	friend Float8 operator>=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+
+	friend Float8 sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+	friend Float8 min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+	friend Float8 max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+
+	friend Float8 select(Float8 pMask, Float8 pA, Float8 pB) { return _mm256_blendv_ps(pB.v, pA.v, pMask.v); }
+	friend int moveMask(Float8 pMask) { return _mm256_movemask_ps(pMask.v); }
+#elif RT_SIMD_SSE2
+	__m128 lo, hi;
+
+	Float8() {}
+	Float8(__m128 pLo, __m128 pHi) : lo(pLo), hi(pHi) {}
+	explicit Float8(float pS) : lo(_mm_set1_ps(pS)), hi(_mm_set1_ps(pS)) {}
+
+	static Float8 load(const float* pPtr) { return Float8(_mm_loadu_ps(pPtr), _mm_loadu_ps(pPtr + 4)); }
+	void store(float* pPtr) const { _mm_storeu_ps(pPtr, lo); _mm_storeu_ps(pPtr + 4, hi); }
+
+	friend Float8 operator+(Float8 a, Float8 b) { return Float8(_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)); }
+	friend Float8 operator-(Float8 a, Float8 b) { return Float8(_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi)); }
+	friend Float8 operator*(Float8 a, Float8 b) { return Float8(_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)); }
+	friend Float8 operator/(Float8 a, Float8 b) { return Float8(_mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi)); }
+	friend Float8 operator&(Float8 a, Float8 b) { return Float8(_mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi)); }
+	friend Float8 operator|(Float8 a, Float8 b) { return Float8(_mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi)); }
+	friend Float8 operator<(Float8 a, Float8 b) { return Float8(_mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi)); }
+	friend Float8 operator<=(Float8 a, Float8 b) { return Float8(_mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi)); }
+	friend Float8 operator>=(Float8 a, Float8 b) { return Float8(_mm_cmpge_ps(a.lo, b.lo), _mm_cmpge_ps(a.hi, b.hi)); }
+
+	friend Float8 sqrt(Float8 a) { return Float8(_mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi)); }
+	friend Float8 min(Float8 a, Float8 b) { return Float8(_mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi)); }
+	friend Float8 max(Float8 a, Float8 b) { return Float8(_mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi)); }
+
+	friend Float8 select(Float8 pMask, Float8 pA, Float8 pB)
+	{
+		return Float8(_mm_or_ps(_mm_and_ps(pMask.lo, pA.lo), _mm_andnot_ps(pMask.lo, pB.lo)),
+			_mm_or_ps(_mm_and_ps(pMask.hi, pA.hi), _mm_andnot_ps(pMask.hi, pB.hi)));
+	}
+	friend int moveMask(Float8 pMask) { return _mm_movemask_ps(pMask.lo) | (_mm_movemask_ps(pMask.hi) << 4); }
+#else
+	float v[8];
+
+	Float8() {}
+	explicit Float8(float pS) { for (int i = 0; i < 8; ++i) v[i] = pS; }
+
+	static Float8 load(const float* pPtr) { Float8 r; for (int i = 0; i < 8; ++i) r.v[i] = pPtr[i]; return r; }
+	void store(float* pPtr) const { for (int i = 0; i < 8; ++i) pPtr[i] = v[i]; }
+
+	// masks are kept as 1.0 / 0.0 here, only select and moveMask look at them
+	template<typename Op>
+	static Float8 apply(Float8 a, Float8 b, Op pOp)
+	{
+		Float8 r;
+		for (int i = 0; i < 8; ++i)
+			r.v[i] = pOp(a.v[i], b.v[i]);
+		return r;
+	}
+
+	friend Float8 operator+(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+	friend Float8 operator-(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+	friend Float8 operator*(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+	friend Float8 operator/(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+	friend Float8 operator&(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return (x != 0.0f && y != 0.0f) ? 1.0f : 0.0f; }); }
+	friend Float8 operator|(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return (x != 0.0f || y != 0.0f) ? 1.0f : 0.0f; }); }
+	friend Float8 operator<(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x < y ? 1.0f : 0.0f; }); }
+	friend Float8 operator<=(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x <= y ? 1.0f : 0.0f; }); }
+	friend Float8 operator>=(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x >= y ? 1.0f : 0.0f; }); }
+
+	friend Float8 sqrt(Float8 a) { Float8 r; for (int i = 0; i < 8; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+	friend Float8 min(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+	friend Float8 max(Float8 a, Float8 b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+	friend Float8 select(Float8 pMask, Float8 pA, Float8 pB)
+	{
+		Float8 r;
+		for (int i = 0; i < 8; ++i)
+			r.v[i] = pMask.v[i] != 0.0f ? pA.v[i] : pB.v[i];
+		return r;
+	}
+	friend int moveMask(Float8 pMask)
+	{
+		int mask = 0;
+		for (int i = 0; i < 8; ++i)
+			mask |= (pMask.v[i] != 0.0f) << i;
+		return mask;
+	}
+#endif
+};
+
+// -----------------------------------------------------------------------------
+
+inline const char* simdName()
+{
+#if RT_SIMD_AVX
+	return "avx";
+#elif RT_SIMD_SSE2
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+// the lane type the kernels are written against and the width to pad arrays to.
+// it follows Real in rtweekend.h
+#ifdef RT_SINGLE_PRECISION
+using SimdReal = Float8;
+#else
+using SimdReal = Double4;
+#endif
+const int kSimdWidth = SimdReal::kWidth;
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !SIMD_H_
\ No newline at end of file
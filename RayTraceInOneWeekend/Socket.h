@@ -0,0 +1,245 @@
+// -----------------------------------------------------------------------------
+#ifndef SOCKET_H_
+#define SOCKET_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+typedef SOCKET NativeSocket;
+const NativeSocket kInvalidSocket = INVALID_SOCKET;
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NativeSocket;
+const NativeSocket kInvalidSocket = -1;
+#endif
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a blocking tcp socket, just what the distributed renderer needs. every call
+// either does all of what it was asked or returns false, and a socket that has
+// failed once is best closed
+class Socket
+{
+public:
+	// ---- constructors
+	Socket() {}
+	explicit Socket(NativeSocket pHandle) : mHandle(pHandle) {}
+	~Socket() { close(); }
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	Socket(Socket&& pOther) : mHandle(pOther.mHandle) { pOther.mHandle = kInvalidSocket; }
+	Socket& operator=(Socket&& pOther)
+	{
+		if (this != &pOther)
+		{
+			close();
+			mHandle = pOther.mHandle;
+			pOther.mHandle = kInvalidSocket;
+		}
+		return *this;
+	}
+
+	// ---- methods
+	// winsock has to be started before anything else, everywhere else this does nothing
+	static bool startup()
+	{
+#if defined(_WIN32)
+		static const bool started = []()
+		{
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		return started;
+#else
+		return true;
+#endif
+	}
+
+	// listens on every interface. a port of 0 lets the os pick, port() says which
+	bool listen(uint16_t pPort)
+	{
+		close();
+		if (!startup())
+			return false;
+
+		mHandle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (mHandle == kInvalidSocket)
+			return false;
+
+		int reuse = 1;
+		setsockopt(mHandle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(pPort);
+
+		if (::bind(mHandle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| ::listen(mHandle, SOMAXCONN) != 0)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	bool connect(const string& pHost, uint16_t pPort)
+	{
+		close();
+		if (!startup())
+			return false;
+
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* found = nullptr;
+		if (getaddrinfo(pHost.c_str(), to_string(pPort).c_str(), &hints, &found) != 0)
+			return false;
+
+		for (addrinfo* candidate = found; candidate; candidate = candidate->ai_next)
+		{
+			mHandle = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+			if (mHandle == kInvalidSocket)
+				continue;
+			if (::connect(mHandle, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0)
+				break;
+			close();
+		}
+		freeaddrinfo(found);
+
+		if (!isOpen())
+			return false;
+		noDelay();
+		return true;
+	}
+
+	// waits up to pSeconds for a connection, false if none came
+	bool accept(Socket& pClient, double pSeconds)
+	{
+		if (!waitReadable(pSeconds))
+			return false;
+
+		const NativeSocket client = ::accept(mHandle, nullptr, nullptr);
+		if (client == kInvalidSocket)
+			return false;
+
+		pClient = Socket(client);
+		pClient.noDelay();
+		return true;
+	}
+
+	// true once there's something to read (or the other end has gone)
+	bool waitReadable(double pSeconds)
+	{
+		const int milliseconds = pSeconds < 0.0 ? -1 : static_cast<int>(pSeconds * 1000.0);
+#if defined(_WIN32)
+		WSAPOLLFD entry = { mHandle, POLLRDNORM, 0 };
+		return WSAPoll(&entry, 1, milliseconds) > 0;
+#else
+		pollfd entry = { mHandle, POLLIN, 0 };
+		return poll(&entry, 1, milliseconds) > 0;
+#endif
+	}
+
+	bool sendAll(const void* pData, size_t pSize)
+	{
+		const char* data = static_cast<const char*>(pData);
+		while (pSize > 0)
+		{
+			const int chunk = static_cast<int>(pSize < (1u << 30) ? pSize : (1u << 30));
+#if defined(MSG_NOSIGNAL)
+			const auto sent = ::send(mHandle, data, chunk, MSG_NOSIGNAL);
+#else
+			const auto sent = ::send(mHandle, data, chunk, 0);
+#endif
+			if (sent <= 0)
+				return false;
+			data += sent;
+			pSize -= static_cast<size_t>(sent);
+		}
+		return true;
+	}
+
+	// with pSeconds set, gives up if the other end stalls that long mid message
+	bool receiveAll(void* pData, size_t pSize, double pSeconds = -1.0)
+	{
+		char* data = static_cast<char*>(pData);
+		while (pSize > 0)
+		{
+			if (pSeconds >= 0.0 && !waitReadable(pSeconds))
+				return false;
+			const int chunk = static_cast<int>(pSize < (1u << 30) ? pSize : (1u << 30));
+			const auto received = ::recv(mHandle, data, chunk, 0);
+			if (received <= 0)
+				return false;
+			data += received;
+			pSize -= static_cast<size_t>(received);
+		}
+		return true;
+	}
+
+	// the port a listening socket ended up on
+	uint16_t port() const
+	{
+		sockaddr_in address;
+		socklen_t length = sizeof(address);
+		if (getsockname(mHandle, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+			return 0;
+		return ntohs(address.sin_port);
+	}
+
+	void close()
+	{
+		if (mHandle == kInvalidSocket)
+			return;
+#if defined(_WIN32)
+		closesocket(mHandle);
+#else
+		::close(mHandle);
+#endif
+		mHandle = kInvalidSocket;
+	}
+
+	bool isOpen() const { return mHandle != kInvalidSocket; }
+
+private:
+	// jobs and tiles are small messages that want to go now, not be batched up
+	void noDelay()
+	{
+		int on = 1;
+		setsockopt(mHandle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+	}
+
+	// ---- members
+	NativeSocket mHandle = kInvalidSocket;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !SOCKET_H_
\ No newline at end of file
@@ -0,0 +1,39 @@
+// -----------------------------------------------------------------------------
+#ifndef SPAN_H_
+#define SPAN_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <cstddef>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a view of mSize Ts that live somewhere else, std::span without needing c++20.
+// it never owns or frees anything, whoever made it has to keep the data alive
+template<typename T>
+class Span
+{
+public:
+	// ---- constructors
+	Span() {}
+	Span(T* pData, size_t pSize) : mData(pData), mSize(pSize) {}
+
+	// ---- methods
+	T& operator[](size_t pIndex) const { return mData[pIndex]; }
+	T* data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+	T* begin() const { return mData; }
+	T* end() const { return mData + mSize; }
+
+	// ---- members
+	T* mData = nullptr;
+	size_t mSize = 0;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !SPAN_H_
\ No newline at end of file
@@ -5,62 +5,125 @@
 
 //--INCLUDES--//
 #include "Hittable.h"
+#include "RenderStats.h"
 #include "vec3.h"
 
 // -----------------------------------------------------------------------------
 
+// the nearest distance along pRay in [pMinT, pMaxT] where it meets the sphere
+inline bool intersectSphere(const Ray& pRay, const point3& pCenter, Real pRadius, Real pMinT, Real pMaxT,
+	Real& pTrace)
+{
+	vec3 oc = pRay.origin() - pCenter;
+	auto a = pRay.direction().lengthSquared();
+	auto halfB = dot(oc, pRay.direction());
+	auto c = oc.lengthSquared() - pRadius * pRadius;
+
+	auto discriminant = halfB * halfB - a * c;
+	if (discriminant < 0)
+		return false;
+	auto sqrtd = sqrt(discriminant);
+
+	// find the nearest root that lies in the acceptable range
+	auto root = (-halfB - sqrtd) / a;
+	if (root < pMinT || pMaxT < root)
+	{
+		root = (-halfB + sqrtd) / a;
+		if (root < pMinT || pMaxT < root)
+			return false;
+	}
+
+	pTrace = root;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// fills in the record for a ray that hits a sphere at pTrace. shared by
+// everything that stores spheres, so they all agree on the surface they report
+inline void setSphereHitRecord(const Ray& pRay, Real pTrace, const point3& pCenter, Real pRadius,
+	MaterialId pMaterialId, HitRecord& pRecord)
+{
+	pRecord.mTrace = pTrace;
+	pRecord.mPoint = pRay.at(pRecord.mTrace);
+	vec3 outwardNormal = (pRecord.mPoint - pCenter) / pRadius;
+	pRecord.setFaceNormal(pRay, outwardNormal);
+	pRecord.mMaterialId = pMaterialId;
+}
+
+// -----------------------------------------------------------------------------
+
 class Sphere : public Hittable
 {
 public:
 	// ---- constructors
-	Sphere() {}
-	Sphere(point3 pCenter, double pRadius, shared_ptr<Material> pMat)
-		: mCenter(pCenter), mRadius(pRadius), mMatPtr(pMat)
+	Sphere() : Hittable(HittableType::Sphere) {}
+	Sphere(point3 pCenter, Real pRadius, MaterialId pMaterialId)
+		: Hittable(HittableType::Sphere), mCenter(pCenter), mRadius(pRadius), mMaterialId(pMaterialId)
 	{}
 
 	// ---- overrides
 
 	// ---- methods
-	virtual bool hit(const Ray& pRay, double pMinT, double pMaxT, HitRecord& pRecord) const override;
+	virtual bool hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const override;
+	virtual bool boundingBox(AABB& pOutputBox) const override;
+	virtual int hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+		HitRecord* pRecords) const override;
+	virtual bool occluded(const Ray& pRay, Real pMinT, Real pMaxT) const override;
 
 	// ---- members
 	point3 mCenter;
-	double mRadius;
-	shared_ptr<Material> mMatPtr;
+	Real mRadius;
+	MaterialId mMaterialId;
 };
 
 // -----------------------------------------------------------------------------
 
-bool Sphere::hit(const Ray& pRay, double pMinT, double pMaxT, HitRecord& pRecord) const
+bool Sphere::hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const
 {
-	vec3 oc = pRay.origin() - mCenter;
-	auto a = pRay.direction().lengthSquared();
-	auto halfB = dot(oc, pRay.direction());
-	auto c = oc.lengthSquared() - mRadius * mRadius;
-
-	auto discriminant = halfB * halfB - a * c;
-	if (discriminant < 0)
+	RT_STAT(threadStats().mSphereTests++);
+	Real root;
+	if (!intersectSphere(pRay, mCenter, mRadius, pMinT, pMaxT, root))
 		return false;
-	auto sqrtd = sqrt(discriminant);
 
-	// find the nearest root that lies in the acceptable range
-	auto root = (-halfB - sqrtd) / a;
-	if (root < pMinT || pMaxT < root)
+	RT_STAT(threadStats().mSphereHits++);
+	setSphereHitRecord(pRay, root, mCenter, mRadius, mMaterialId, pRecord);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+int Sphere::hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+	HitRecord* pRecords) const
+{
+	const int result = hitSpherePacket(mCenter, mRadius * mRadius, pPacket, pActiveMask, pMinT, pMaxT);
+	RT_STAT(threadStats().mSphereTests += countLanes(pActiveMask));
+	RT_STAT(threadStats().mSphereHits += countLanes(result));
+	for (int lane = 0; lane < RayPacket::kSize; ++lane)
 	{
-		root = (-halfB + sqrtd) / a;
-		if (root < pMinT || pMaxT < root)
-			return false;
+		if (result & (1 << lane))
+			setSphereHitRecord(pPacket.ray(lane), pMaxT[lane], mCenter, mRadius, mMaterialId, pRecords[lane]);
 	}
+	return result;
+}
 
-	pRecord.mTrace = root;
-	pRecord.mPoint = pRay.at(pRecord.mTrace);
-	vec3 outwardNormal = (pRecord.mPoint - mCenter) / mRadius;
-	pRecord.setFaceNormal(pRay, outwardNormal);
-	pRecord.mMatPtr = mMatPtr;
+// -----------------------------------------------------------------------------
 
-	return true;
+bool Sphere::occluded(const Ray& pRay, Real pMinT, Real pMaxT) const
+{
+	RT_STAT(threadStats().mSphereTests++);
+	Real root;
+	return intersectSphere(pRay, mCenter, mRadius, pMinT, pMaxT, root);
 }
 
+// -----------------------------------------------------------------------------
+
+bool Sphere::boundingBox(AABB& pOutputBox) const
+{
+	const Real r = fabs(mRadius);
+	pOutputBox = AABB(mCenter - vec3(r, r, r), mCenter + vec3(r, r, r));
+	return true;
+}
 
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
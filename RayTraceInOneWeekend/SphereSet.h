@@ -0,0 +1,299 @@
+// -----------------------------------------------------------------------------
+#ifndef SPHERE_SET_H_
+#define SPHERE_SET_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "AABB.h"
+#include "Bvh.h"
+#include "Hittable.h"
+#include "HittableList.h"
+#include "RenderStats.h"
+#include "Simd.h"
+#include "Sphere.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a bag of spheres kept as structure of arrays, so one ray is tested against
+// kSimdWidth spheres at a time. only the closest sphere gets a full HitRecord
+// built for it at the end. anything added that isn't a sphere is kept in a
+// plain HittableList and tested after the spheres
+class SphereSet : public Hittable
+{
+public:
+	// ---- constructors
+	SphereSet() {}
+	SphereSet(const HittableList& pList)
+	{
+		for (const auto& object : pList.mvObjects)
+			add(object);
+	}
+
+	// ---- overrides
+	virtual bool hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const override;
+	virtual bool boundingBox(AABB& pOutputBox) const override;
+	virtual int hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+		HitRecord* pRecords) const override;
+
+	// ---- methods
+	void add(const point3& pCenter, Real pRadius, MaterialId pMaterialId);
+	void add(shared_ptr<Hittable> pObject);
+	size_t size() const { return mCount; }
+
+	// groups nearby spheres into sets of at most pMaxSetSize using the bvh
+	// builder, so a Bvh over the result has SphereSets as its leaves
+	static HittableList clusters(const HittableList& pList, uint32_t pMaxSetSize = 2 * kSimdWidth);
+
+	// ---- members
+	vector<Real> mvCenterX;
+	vector<Real> mvCenterY;
+	vector<Real> mvCenterZ;
+	vector<Real> mvRadius;
+	vector<Real> mvRadiusSquared;
+	vector<MaterialId> mvMaterialIds;
+	HittableList mOthers;
+	size_t mCount = 0;
+	AABB mBox;
+};
+
+// -----------------------------------------------------------------------------
+
+void SphereSet::add(const point3& pCenter, Real pRadius, MaterialId pMaterialId)
+{
+	// the arrays are always a whole number of lanes long. the padding has a
+	// radius squared of -infinity, so its discriminant is never positive
+	if (mCount == mvCenterX.size())
+	{
+		const size_t padded = mCount + kSimdWidth;
+		mvCenterX.resize(padded, 0.0);
+		mvCenterY.resize(padded, 0.0);
+		mvCenterZ.resize(padded, 0.0);
+		mvRadius.resize(padded, 1.0);
+		mvRadiusSquared.resize(padded, -gInfinity);
+		mvMaterialIds.resize(padded, 0);
+	}
+
+	mvCenterX[mCount] = pCenter.x();
+	mvCenterY[mCount] = pCenter.y();
+	mvCenterZ[mCount] = pCenter.z();
+	mvRadius[mCount] = pRadius;
+	mvRadiusSquared[mCount] = pRadius * pRadius;
+	mvMaterialIds[mCount] = pMaterialId;
+	++mCount;
+
+	const Real r = fabs(pRadius);
+	mBox.grow(AABB(pCenter - vec3(r, r, r), pCenter + vec3(r, r, r)));
+}
+
+// -----------------------------------------------------------------------------
+
+void SphereSet::add(shared_ptr<Hittable> pObject)
+{
+	if (pObject->mType == HittableType::Sphere)
+	{
+		const Sphere& sphere = static_cast<const Sphere&>(*pObject);
+		add(sphere.mCenter, sphere.mRadius, sphere.mMaterialId);
+		return;
+	}
+
+	mOthers.add(pObject);
+	AABB box;
+	if (pObject->boundingBox(box))
+		mBox.grow(box);
+}
+
+// -----------------------------------------------------------------------------
+
+bool SphereSet::hit(const Ray& pRay, Real pMinT, Real pMaxT, HitRecord& pRecord) const
+{
+	const SimdReal ox(pRay.mOrig.x()), oy(pRay.mOrig.y()), oz(pRay.mOrig.z());
+	const SimdReal dx(pRay.mDir.x()), dy(pRay.mDir.y()), dz(pRay.mDir.z());
+	const SimdReal a(pRay.mDir.lengthSquared());
+	const SimdReal minT(pMinT);
+	const SimdReal zero(0.0);
+	const SimdReal step(static_cast<Real>(kSimdWidth));
+
+	// each lane keeps its own closest hit, they're reduced after the loop
+	SimdReal closest(pMaxT);
+	SimdReal closestIndex(-1.0);
+	Real firstIndices[kSimdWidth];
+	for (int lane = 0; lane < kSimdWidth; ++lane)
+		firstIndices[lane] = lane;
+	SimdReal index = SimdReal::load(firstIndices);
+
+	const size_t paddedCount = mvCenterX.size();
+	for (size_t i = 0; i < paddedCount; i += kSimdWidth, index = index + step)
+	{
+		// the same maths as Sphere::hit, one lane per sphere
+		const SimdReal ocx = ox - SimdReal::load(&mvCenterX[i]);
+		const SimdReal ocy = oy - SimdReal::load(&mvCenterY[i]);
+		const SimdReal ocz = oz - SimdReal::load(&mvCenterZ[i]);
+
+		const SimdReal halfB = ocx * dx + ocy * dy + ocz * dz;
+		const SimdReal c = ocx * ocx + ocy * ocy + ocz * ocz - SimdReal::load(&mvRadiusSquared[i]);
+		const SimdReal discriminant = halfB * halfB - a * c;
+
+		const SimdReal hitMask = discriminant >= zero;
+		if (moveMask(hitMask) == 0)
+			continue;
+
+		const SimdReal sqrtd = sqrt(max(discriminant, zero));
+		const SimdReal nearRoot = (zero - halfB - sqrtd) / a;
+		const SimdReal farRoot = (zero - halfB + sqrtd) / a;
+
+		// find the nearest root that lies in the acceptable range
+		const SimdReal nearOk = (minT <= nearRoot) & (nearRoot <= closest);
+		const SimdReal farOk = (minT <= farRoot) & (farRoot <= closest);
+		const SimdReal root = select(nearOk, nearRoot, farRoot);
+		const SimdReal accept = hitMask & (nearOk | farOk);
+
+		closest = select(accept, root, closest);
+		closestIndex = select(accept, index, closestIndex);
+	}
+
+	Real laneT[kSimdWidth], laneIndex[kSimdWidth];
+	closest.store(laneT);
+	closestIndex.store(laneIndex);
+
+	int best = -1;
+	Real bestT = pMaxT;
+	for (int lane = 0; lane < kSimdWidth; ++lane)
+	{
+		if (laneIndex[lane] >= 0.0 && laneT[lane] <= bestT)
+		{
+			bestT = laneT[lane];
+			best = static_cast<int>(laneIndex[lane]);
+		}
+	}
+
+	// the lanes don't say how many spheres they accepted along the way, so only
+	// the closest one counts as a hit here
+	RT_STAT(threadStats().mSphereTests += mCount);
+	RT_STAT(best >= 0 ? threadStats().mSphereHits++ : 0);
+
+	bool hitAnything = false;
+	if (best >= 0)
+	{
+		const point3 center(mvCenterX[best], mvCenterY[best], mvCenterZ[best]);
+		setSphereHitRecord(pRay, bestT, center, mvRadius[best], mvMaterialIds[best], pRecord);
+		hitAnything = true;
+	}
+
+	if (!mOthers.mvObjects.empty() && mOthers.hit(pRay, pMinT, hitAnything ? bestT : pMaxT, pRecord))
+		hitAnything = true;
+
+	return hitAnything;
+}
+
+// -----------------------------------------------------------------------------
+
+// the packet version turns the loops around, each sphere is tested against
+// all the rays at once
+int SphereSet::hitPacket(const RayPacket& pPacket, int pActiveMask, Real pMinT, Real* pMaxT,
+	HitRecord* pRecords) const
+{
+	int closestIndex[RayPacket::kSize];
+	int result = 0;
+	RT_STAT(threadStats().mSphereTests += mCount * countLanes(pActiveMask));
+
+	for (size_t i = 0; i < mCount; ++i)
+	{
+		const point3 center(mvCenterX[i], mvCenterY[i], mvCenterZ[i]);
+		const int lanes = hitSpherePacket(center, mvRadiusSquared[i], pPacket, pActiveMask, pMinT, pMaxT);
+		RT_STAT(threadStats().mSphereHits += countLanes(lanes));
+		if (lanes == 0)
+			continue;
+
+		for (int lane = 0; lane < RayPacket::kSize; ++lane)
+		{
+			if (lanes & (1 << lane))
+				closestIndex[lane] = static_cast<int>(i);
+		}
+		result |= lanes;
+	}
+
+	for (int lane = 0; lane < RayPacket::kSize; ++lane)
+	{
+		if (result & (1 << lane))
+		{
+			const int best = closestIndex[lane];
+			const point3 center(mvCenterX[best], mvCenterY[best], mvCenterZ[best]);
+			setSphereHitRecord(pPacket.ray(lane), pMaxT[lane], center, mvRadius[best],
+				mvMaterialIds[best], pRecords[lane]);
+		}
+	}
+
+	if (!mOthers.mvObjects.empty())
+		result |= mOthers.hitPacket(pPacket, pActiveMask, pMinT, pMaxT, pRecords);
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+
+bool SphereSet::boundingBox(AABB& pOutputBox) const
+{
+	if (mBox.isEmpty())
+		return false;
+
+	pOutputBox = mBox;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+HittableList SphereSet::clusters(const HittableList& pList, uint32_t pMaxSetSize)
+{
+	HittableList result;
+	vector<shared_ptr<Sphere>> spheres;
+	vector<AABB> boxes;
+
+	for (const auto& object : pList.mvObjects)
+	{
+		if (object->mType == HittableType::Sphere)
+		{
+			const shared_ptr<Sphere> sphere = static_pointer_cast<Sphere>(object);
+			spheres.push_back(sphere);
+			boxes.push_back(AABB());
+			sphere->boundingBox(boxes.back());
+		}
+		else
+		{
+			result.add(object);
+		}
+	}
+
+	// a lane test costs well under a full scalar intersection, so leaves are
+	// allowed to grow up to the set size before splitting pays off
+	vector<BvhNode> nodes;
+	vector<uint32_t> indices;
+	BvhBuilder(boxes, pMaxSetSize, 1.0 / kSimdWidth).build(nodes, indices);
+
+	for (const BvhNode& node : nodes)
+	{
+		if (!node.isLeaf())
+			continue;
+
+		auto set = make_shared<SphereSet>();
+		for (uint32_t i = node.mLeftOrFirst; i < node.mLeftOrFirst + node.mCount; ++i)
+		{
+			const Sphere& sphere = *spheres[indices[i]];
+			set->add(sphere.mCenter, sphere.mRadius, sphere.mMaterialId);
+		}
+		result.add(set);
+	}
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !SPHERE_SET_H_
\ No newline at end of file
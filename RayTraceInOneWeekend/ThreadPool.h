@@ -0,0 +1,142 @@
+// -----------------------------------------------------------------------------
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a handful of threads that stay alive between jobs, for work that's split up
+// many times per frame (wavefront stages, post passes) where starting fresh
+// threads every time would cost more than the work. the calling thread joins
+// in on every job too
+class ThreadPool
+{
+public:
+	// ---- constructors
+	ThreadPool(unsigned int pNumThreads = 0)
+	{
+		unsigned int numThreads = pNumThreads;
+		if (numThreads == 0)
+			numThreads = thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 4;
+
+		for (unsigned int i = 1; i < numThreads; ++i)
+			mvWorkers.emplace_back([this]() { workerLoop(); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			lock_guard<mutex> lock(mLock);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		for (thread& t : mvWorkers)
+			t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// ---- methods
+	unsigned int numThreads() const { return static_cast<unsigned int>(mvWorkers.size()) + 1; }
+
+	// calls pFunc(begin, end) over [0, pCount) in chunks of pGrain and returns
+	// once every chunk is done
+	void parallelFor(size_t pCount, size_t pGrain, const function<void(size_t, size_t)>& pFunc)
+	{
+		if (pCount == 0)
+			return;
+
+		const size_t grain = max<size_t>(pGrain, 1);
+		if (mvWorkers.empty() || pCount <= grain)
+		{
+			pFunc(0, pCount);
+			return;
+		}
+
+		{
+			lock_guard<mutex> lock(mLock);
+			mJob = &pFunc;
+			mCount = pCount;
+			mGrain = grain;
+			mNext = 0;
+			mBusy = static_cast<unsigned int>(mvWorkers.size());
+			++mGeneration;
+		}
+		mWake.notify_all();
+
+		runChunks(pFunc);
+
+		unique_lock<mutex> lock(mLock);
+		mDone.wait(lock, [this]() { return mBusy == 0; });
+		mJob = nullptr;
+	}
+
+private:
+	void runChunks(const function<void(size_t, size_t)>& pFunc)
+	{
+		while (true)
+		{
+			const size_t begin = mNext.fetch_add(mGrain);
+			if (begin >= mCount)
+				break;
+			pFunc(begin, min(begin + mGrain, mCount));
+		}
+	}
+
+	void workerLoop()
+	{
+		size_t seenGeneration = 0;
+		while (true)
+		{
+			const function<void(size_t, size_t)>* job;
+			{
+				unique_lock<mutex> lock(mLock);
+				mWake.wait(lock, [&]() { return mQuit || mGeneration != seenGeneration; });
+				if (mQuit)
+					return;
+				seenGeneration = mGeneration;
+				job = mJob;
+			}
+
+			runChunks(*job);
+
+			{
+				lock_guard<mutex> lock(mLock);
+				--mBusy;
+			}
+			mDone.notify_one();
+		}
+	}
+
+	// ---- members
+	vector<thread> mvWorkers;
+	mutex mLock;
+	condition_variable mWake;
+	condition_variable mDone;
+
+	const function<void(size_t, size_t)>* mJob = nullptr;
+	size_t mCount = 0;
+	size_t mGrain = 1;
+	atomic<size_t> mNext{ 0 };
+	unsigned int mBusy = 0;
+	size_t mGeneration = 0;
+	bool mQuit = false;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !THREAD_POOL_H_
\ No newline at end of file
@@ -0,0 +1,307 @@
+// -----------------------------------------------------------------------------
+#ifndef TILE_SCHEDULER_H_
+#define TILE_SCHEDULER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// a rectangle of pixels covering [mX0, mX1) x [mY0, mY1)
+struct Tile
+{
+	// ---- methods
+	int width() const { return mX1 - mX0; }
+	int height() const { return mY1 - mY0; }
+
+	// ---- members
+	int mX0, mY0;
+	int mX1, mY1;
+};
+
+// -----------------------------------------------------------------------------
+
+enum class TileOrder
+{
+	Scanline,
+	Hilbert,
+	Spiral
+};
+
+inline const char* tileOrderName(TileOrder pOrder)
+{
+	switch (pOrder)
+	{
+	case TileOrder::Scanline: return "scanline";
+	case TileOrder::Spiral: return "spiral";
+	default: return "hilbert";
+	}
+}
+
+inline bool tileOrderFromName(const string& pName, TileOrder& pOrder)
+{
+	for (TileOrder order : { TileOrder::Scanline, TileOrder::Hilbert, TileOrder::Spiral })
+	{
+		if (pName == tileOrderName(order))
+		{
+			pOrder = order;
+			return true;
+		}
+	}
+	return false;
+}
+
+// -----------------------------------------------------------------------------
+
+// distance of (pX, pY) along a hilbert curve filling a pSize x pSize grid,
+// pSize must be a power of two
+inline uint32_t hilbertIndex(uint32_t pSize, uint32_t pX, uint32_t pY)
+{
+	uint32_t d = 0;
+	for (uint32_t s = pSize / 2; s > 0; s /= 2)
+	{
+		const uint32_t rx = (pX & s) > 0;
+		const uint32_t ry = (pY & s) > 0;
+		d += s * s * ((3 * rx) ^ ry);
+
+		// rotate the quadrant so the curve stays continuous
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				pX = s - 1 - pX;
+				pY = s - 1 - pY;
+			}
+			swap(pX, pY);
+		}
+	}
+	return d;
+}
+
+// -----------------------------------------------------------------------------
+
+// splits the image into tiles of at most pTileSize x pTileSize. the tiles on the
+// right and top edges are clipped so every pixel is covered exactly once for
+// any resolution
+vector<Tile> makeTiles(int pImageWidth, int pImageHeight, int pTileSize, TileOrder pOrder)
+{
+	const int tileSize = pTileSize > 0 ? pTileSize : 1;
+	const int tilesX = (pImageWidth + tileSize - 1) / tileSize;
+	const int tilesY = (pImageHeight + tileSize - 1) / tileSize;
+
+	// keys are only used for sorting, scanline order is the order we build them in
+	vector<pair<double, Tile>> keyed;
+	keyed.reserve(tilesX * tilesY);
+
+	uint32_t hilbertSize = 1;
+	while (hilbertSize < static_cast<uint32_t>(max(tilesX, tilesY)))
+		hilbertSize *= 2;
+
+	const double centerX = 0.5 * (tilesX - 1);
+	const double centerY = 0.5 * (tilesY - 1);
+
+	// rows are built from the top of the image down, matching the output file
+	for (int ty = tilesY - 1; ty >= 0; --ty)
+	{
+		for (int tx = 0; tx < tilesX; ++tx)
+		{
+			Tile tile;
+			tile.mX0 = tx * tileSize;
+			tile.mY0 = ty * tileSize;
+			tile.mX1 = min(tile.mX0 + tileSize, pImageWidth);
+			tile.mY1 = min(tile.mY0 + tileSize, pImageHeight);
+
+			double key = static_cast<double>(keyed.size());
+			if (pOrder == TileOrder::Hilbert)
+			{
+				key = hilbertIndex(hilbertSize, tx, tilesY - 1 - ty);
+			}
+			else if (pOrder == TileOrder::Spiral)
+			{
+				// outwards ring by ring from the centre, walking each ring by angle.
+				// the angle term stays within [0, 2pi] so it never reaches the next ring
+				const double dx = tx - centerX;
+				const double dy = ty - centerY;
+				const double ring = floor(max(fabs(dx), fabs(dy)));
+				key = ring * 8.0 + atan2(dy, dx) + 3.14159265358979;
+			}
+
+			keyed.push_back(make_pair(key, tile));
+		}
+	}
+
+	stable_sort(keyed.begin(), keyed.end(),
+		[](const pair<double, Tile>& pA, const pair<double, Tile>& pB) { return pA.first < pB.first; });
+
+	vector<Tile> tiles;
+	tiles.reserve(keyed.size());
+	for (const auto& k : keyed)
+		tiles.push_back(k.second);
+
+	return tiles;
+}
+
+// -----------------------------------------------------------------------------
+
+// hands tiles out to render threads. each thread owns a deque seeded with a
+// contiguous run of the visit order and pops from its front. once it runs dry
+// it steals from the back of another thread's deque, so the work that moves is
+// the work its owner would have reached last
+class TileScheduler
+{
+public:
+	// ---- constructors
+	TileScheduler(const vector<Tile>& pTiles, unsigned int pNumThreads)
+		: mTiles(pTiles)
+		, mStart(chrono::steady_clock::now())
+	{
+		const unsigned int numThreads = pNumThreads > 0 ? pNumThreads : 1;
+		const size_t numTiles = mTiles.size();
+
+		for (unsigned int t = 0; t < numThreads; ++t)
+		{
+			mvQueues.emplace_back(new WorkQueue());
+			const size_t first = numTiles * t / numThreads;
+			const size_t last = numTiles * (t + 1) / numThreads;
+			for (size_t i = first; i < last; ++i)
+				mvQueues[t]->mTiles.push_back(static_cast<uint32_t>(i));
+		}
+
+		mvThreadStats.resize(numThreads);
+		mvTileSeconds.assign(numTiles, 0.0);
+	}
+
+	// ---- methods
+	unsigned int numThreads() const { return static_cast<unsigned int>(mvQueues.size()); }
+	size_t numTiles() const { return mTiles.size(); }
+	const vector<Tile>& tiles() const { return mTiles; }
+
+	// how long each tile in tiles() took to render, once work() is done
+	const vector<double>& tileSeconds() const { return mvTileSeconds; }
+
+	// gets the next tile for pThread, returns false once every queue is empty
+	bool next(unsigned int pThread, Tile& pTile)
+	{
+		uint32_t index;
+		if (!nextIndex(pThread, index))
+			return false;
+		pTile = mTiles[index];
+		return true;
+	}
+
+	// runs pWork(tile) for every tile this thread can get, timing the work
+	template<typename WorkFunc>
+	void work(unsigned int pThread, WorkFunc pWork)
+	{
+		ThreadStats& stats = mvThreadStats[pThread];
+		uint32_t index;
+
+		while (nextIndex(pThread, index))
+		{
+			const auto begin = chrono::steady_clock::now();
+			pWork(mTiles[index]);
+			const double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+			mvTileSeconds[index] = seconds;
+			stats.mBusy += seconds;
+			stats.mTiles++;
+		}
+
+		stats.mFinished = chrono::duration<double>(chrono::steady_clock::now() - mStart).count();
+	}
+
+	// busy is time spent rendering tiles, idle is everything else between the
+	// scheduler starting and the last thread finishing. it's formatted on the
+	// side so pOut's precision and flags are left as they were
+	void printReport(ostream& pOut) const
+	{
+		double wall = 0.0;
+		for (const ThreadStats& stats : mvThreadStats)
+			wall = max(wall, stats.mFinished);
+
+		ostringstream report;
+		report << "thread   tiles  stolen   busy(s)   idle(s)\n";
+		for (size_t t = 0; t < mvThreadStats.size(); ++t)
+		{
+			const ThreadStats& stats = mvThreadStats[t];
+			report << setw(6) << t
+				<< setw(8) << stats.mTiles
+				<< setw(8) << stats.mStolen
+				<< setw(10) << fixed << setprecision(3) << stats.mBusy
+				<< setw(10) << wall - stats.mBusy << '\n';
+		}
+		pOut << report.str();
+	}
+
+	// ---- members
+	struct ThreadStats
+	{
+		double mBusy = 0.0;
+		double mFinished = 0.0;
+		int mTiles = 0;
+		int mStolen = 0;
+	};
+
+	vector<ThreadStats> mvThreadStats;
+
+private:
+	bool nextIndex(unsigned int pThread, uint32_t& pIndex)
+	{
+		WorkQueue& own = *mvQueues[pThread];
+		{
+			lock_guard<mutex> lock(own.mLock);
+			if (!own.mTiles.empty())
+			{
+				pIndex = own.mTiles.front();
+				own.mTiles.pop_front();
+				return true;
+			}
+		}
+
+		// no tiles are ever added, so one empty sweep means we're done
+		const unsigned int n = numThreads();
+		for (unsigned int i = 1; i < n; ++i)
+		{
+			WorkQueue& victim = *mvQueues[(pThread + i) % n];
+			lock_guard<mutex> lock(victim.mLock);
+			if (!victim.mTiles.empty())
+			{
+				pIndex = victim.mTiles.back();
+				victim.mTiles.pop_back();
+				mvThreadStats[pThread].mStolen++;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	struct WorkQueue
+	{
+		mutex mLock;
+		deque<uint32_t> mTiles;
+	};
+
+	vector<Tile> mTiles;
+	vector<double> mvTileSeconds;
+	vector<unique_ptr<WorkQueue>> mvQueues;
+	chrono::steady_clock::time_point mStart;
+};
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !TILE_SCHEDULER_H_
\ No newline at end of file
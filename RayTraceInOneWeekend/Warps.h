@@ -0,0 +1,203 @@
+// -----------------------------------------------------------------------------
+#ifndef WARPS_H_
+#define WARPS_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// closed form maps from uniform numbers in [0, 1) to points in a disk, on a
+// sphere and in a ball. there's no rejection: each warp takes a fixed count of
+// numbers and every one of them lands somewhere. they're written once for any
+// lane type, a Real or a SimdReal, out of + - * /, sqrt and selects, so a lane
+// of a batch comes out with the same bits as the same numbers one at a time
+
+// a Real's select. SimdReal has its own, this passes masks through to it
+inline Real laneSelect(bool pMask, Real pA, Real pB)
+{
+	return pMask ? pA : pB;
+}
+
+template<typename T>
+inline T laneSelect(T pMask, T pA, T pB)
+{
+	return select(pMask, pA, pB);
+}
+
+template<typename T>
+inline T laneAbs(T pX)
+{
+	return max(pX, T(0) - pX);
+}
+
+// -----------------------------------------------------------------------------
+
+// taylor series of sin(x)/x and cos(x) in x^2, to the x^19 and x^20 terms.
+// that's within an ulp of double over [-pi/2, pi/2], which is all they're for
+const double kSinSeries[] = { 1.0, -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800,
+	1.0 / 6227020800.0, -1.0 / 1307674368000.0, 1.0 / 355687428096000.0, -1.0 / 121645100408832000.0 };
+const double kCosSeries[] = { 1.0, -1.0 / 2, 1.0 / 24, -1.0 / 720, 1.0 / 40320, -1.0 / 3628800,
+	1.0 / 479001600.0, -1.0 / 87178291200.0, 1.0 / 20922789888000.0, -1.0 / 6402373705728000.0,
+	1.0 / 2432902008176640000.0 };
+
+template<typename T, size_t N>
+inline T series(const double (&pCoefficients)[N], T pX)
+{
+	T sum = T(pCoefficients[N - 1]);
+	for (size_t i = N - 1; i-- > 0;)
+		sum = sum * pX + T(pCoefficients[i]);
+	return sum;
+}
+
+// sin and cos of pAngle, which has to be within [-pi/2, pi/2]
+template<typename T>
+inline void sinCos(T pAngle, T& pSin, T& pCos)
+{
+	const T x2 = pAngle * pAngle;
+	pSin = pAngle * series(kSinSeries, x2);
+	pCos = series(kCosSeries, x2);
+}
+
+// sin and cos of pTurns whole turns, for pTurns in [0, 1). half a turn back
+// puts it in [-1/2, 1/2), which negates both, and the ends of that fold over
+// into [-1/4, 1/4] where the series works, which negates the cos back
+template<typename T>
+inline void sinCosTurns(T pTurns, T& pSin, T& pCos)
+{
+	const T x = pTurns - T(0.5);
+	const auto above = T(0.25) < x;
+	const auto below = x < T(-0.25);
+	const T folded = laneSelect(above, T(0.5) - x, laneSelect(below, T(-0.5) - x, x));
+
+	T s, c;
+	sinCos(T(2 * kPi) * folded, s, c);
+	pSin = T(0) - s;
+	pCos = laneSelect(above | below, c, T(0) - c);
+}
+
+// cube root of pX in [0, 1]. pX^(5/16) from four square roots starts within a
+// third of it for pX over a millionth, and three of halley's steps take that
+// to the last bit or so. the one draw in a million below that is still good
+// to 1e-7, which no radius is ever going to show
+template<typename T>
+inline T cubeRoot(T pX)
+{
+	const T quarter = sqrt(sqrt(pX));
+	T y = quarter * sqrt(sqrt(quarter));
+	for (int i = 0; i < 3; ++i)
+	{
+		const T y3 = y * y * y;
+		y = y * (y3 + T(2) * pX) / (T(2) * y3 + pX);
+	}
+	return laneSelect(T(0) < pX, y, T(0));
+}
+
+// -----------------------------------------------------------------------------
+
+// concentric map (shirley and chiu 1997), squares to rings without squashing.
+// whichever of a and b is further out is the radius, and the other over it
+// is the angle from that axis, up to an eighth of a turn either way
+template<typename T>
+inline void warpUnitDisk(T pU, T pV, T& pX, T& pY)
+{
+	const T a = T(2) * pU - T(1);
+	const T b = T(2) * pV - T(1);
+	const auto aOuter = laneAbs(b) < laneAbs(a);
+	const T r = laneSelect(aOuter, a, b);
+	const T t = laneSelect(aOuter, b, a) / laneSelect(T(0) < r * r, r, T(1));
+
+	T s, c;
+	sinCos(T(kPi / 4) * t, s, c);
+	pX = r * laneSelect(aOuter, c, s);
+	pY = r * laneSelect(aOuter, s, c);
+}
+
+// archimedes: z is uniform over a sphere, so the height and the turn around it
+// are each one number
+template<typename T>
+inline void warpUnitSphere(T pU, T pV, T& pX, T& pY, T& pZ)
+{
+	const T z = T(1) - T(2) * pU;
+	const T r = sqrt(max(T(0), T(1) - z * z));
+
+	T s, c;
+	sinCosTurns(pV, s, c);
+	pX = r * c;
+	pY = r * s;
+	pZ = z;
+}
+
+// a direction and a radius that puts as many points in every shell as its volume
+template<typename T>
+inline void warpUnitBall(T pU, T pV, T pW, T& pX, T& pY, T& pZ)
+{
+	const T r = cubeRoot(pW);
+	T x, y, z;
+	warpUnitSphere(pU, pV, x, y, z);
+	pX = r * x;
+	pY = r * y;
+	pZ = r * z;
+}
+
+// -----------------------------------------------------------------------------
+
+// the warps over whole arrays of uniform numbers, kSimdWidth at a time and the
+// last few one by one. outputs are separate arrays per axis
+
+inline void warpUnitDisks(const Real* pU, const Real* pV, Real* pX, Real* pY, size_t pCount)
+{
+	const size_t whole = pCount - pCount % kSimdWidth;
+	for (size_t i = 0; i < whole; i += kSimdWidth)
+	{
+		SimdReal x, y;
+		warpUnitDisk(SimdReal::load(pU + i), SimdReal::load(pV + i), x, y);
+		x.store(pX + i);
+		y.store(pY + i);
+	}
+	for (size_t i = whole; i < pCount; ++i)
+		warpUnitDisk(pU[i], pV[i], pX[i], pY[i]);
+}
+
+inline void warpUnitSpheres(const Real* pU, const Real* pV, Real* pX, Real* pY, Real* pZ, size_t pCount)
+{
+	const size_t whole = pCount - pCount % kSimdWidth;
+	for (size_t i = 0; i < whole; i += kSimdWidth)
+	{
+		SimdReal x, y, z;
+		warpUnitSphere(SimdReal::load(pU + i), SimdReal::load(pV + i), x, y, z);
+		x.store(pX + i);
+		y.store(pY + i);
+		z.store(pZ + i);
+	}
+	for (size_t i = whole; i < pCount; ++i)
+		warpUnitSphere(pU[i], pV[i], pX[i], pY[i], pZ[i]);
+}
+
+inline void warpUnitBalls(const Real* pU, const Real* pV, const Real* pW, Real* pX, Real* pY, Real* pZ,
+	size_t pCount)
+{
+	const size_t whole = pCount - pCount % kSimdWidth;
+	for (size_t i = 0; i < whole; i += kSimdWidth)
+	{
+		SimdReal x, y, z;
+		warpUnitBall(SimdReal::load(pU + i), SimdReal::load(pV + i), SimdReal::load(pW + i), x, y, z);
+		x.store(pX + i);
+		y.store(pY + i);
+		z.store(pZ + i);
+	}
+	for (size_t i = whole; i < pCount; ++i)
+		warpUnitBall(pU[i], pV[i], pW[i], pX[i], pY[i], pZ[i]);
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !WARPS_H_
\ No newline at end of file
@@ -0,0 +1,436 @@
+// -----------------------------------------------------------------------------
+#ifndef WAVEFRONT_RENDERER_H_
+#define WAVEFRONT_RENDERER_H_
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "rtweekend.h"
+#include "Camera.h"
+#include "Framebuffer.h"
+#include "Hittable.h"
+#include "Integrator.h"
+#include "Material.h"
+#include "RenderSettings.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// -----------------------------------------------------------------------------
+
+// per stage timings for one wavefront frame. items are rays generated for
+// generate, rays intersected for extend, paths sorted for sort, scatter calls
+// for shade and paths looked at for compact
+struct WavefrontStats
+{
+	// ---- methods
+	void printReport(ostream& pOut) const
+	{
+		pOut << "stage          items    time(s)     Mitems/s\n";
+		for (int i = 0; i < kNumStages; ++i)
+		{
+			pOut << left << setw(10) << kStageNames[i] << right
+				<< setw(12) << mItems[i]
+				<< setw(11) << fixed << setprecision(3) << mSeconds[i]
+				<< setw(13) << setprecision(2) << (mSeconds[i] > 0.0 ? mItems[i] / mSeconds[i] / 1e6 : 0.0)
+				<< '\n';
+		}
+		pOut << "iterations " << mIterations << '\n';
+	}
+
+	// ---- members
+	enum Stage { Generate, Extend, Sort, Shade, Compact, kNumStages };
+	static const char* const kStageNames[kNumStages];
+
+	double mSeconds[kNumStages] = {};
+	long long mItems[kNumStages] = {};
+	int mIterations = 0;
+};
+
+const char* const WavefrontStats::kStageNames[WavefrontStats::kNumStages] =
+	{ "generate", "extend", "sort", "shade", "compact" };
+
+// -----------------------------------------------------------------------------
+
+// the state of every path in flight, one flat array per field and indexed by
+// path slot. a slot is reused as soon as its path has finished
+struct PathStates
+{
+	// ---- methods
+	void resize(size_t pCount)
+	{
+		mRay.resize(pCount);
+		mThroughput.resize(pCount);
+		mRadiance.resize(pCount);
+		mSampler.resize(pCount);
+		mRecord.resize(pCount);
+		mPixel.resize(pCount);
+		mDepth.resize(pCount);
+		mAlive.resize(pCount);
+		mScatterPdf.resize(pCount);
+		mScatterOrigin.resize(pCount);
+	}
+
+	// ---- members
+	vector<Ray> mRay;
+	vector<colour> mThroughput;
+	vector<colour> mRadiance;
+	vector<Sampler> mSampler;
+	vector<HitRecord> mRecord;
+	vector<uint32_t> mPixel;
+	vector<int> mDepth;
+	vector<uint8_t> mAlive;
+
+	// the last bounce's pdf and where it was, for weighting a light it runs
+	// into (see emittedAlongPath)
+	vector<Real> mScatterPdf;
+	vector<point3> mScatterOrigin;
+};
+
+// -----------------------------------------------------------------------------
+
+// what's left of a bounce once its material has scattered the path or not:
+// the throughput and ray move on and roulette gets its go, or the path ends.
+// pScatterPdf is the bounce's pdf if a light could have been sampled instead
+inline void finishShade(PathStates& pPaths, uint32_t pSlot, bool pScattered, const colour& pAttenuation,
+	const Ray& pScatteredRay, Real pScatterPdf, const RenderSettings& pSettings)
+{
+	if (pScattered)
+	{
+		pPaths.mScatterPdf[pSlot] = pScatterPdf;
+		pPaths.mScatterOrigin[pSlot] = pPaths.mRecord[pSlot].mPoint;
+		pPaths.mThroughput[pSlot] = pPaths.mThroughput[pSlot] * pAttenuation;
+		pPaths.mRay[pSlot] = pScatteredRay;
+		pPaths.mDepth[pSlot]--;
+
+		const int bounce = pSettings.mMaxDepth - pPaths.mDepth[pSlot];
+		if (!survivesRoulette(pPaths.mThroughput[pSlot], bounce, pSettings, pPaths.mSampler[pSlot]))
+		{
+			RT_STAT(threadStats().mRouletteKilled++);
+			RT_STAT(threadStats().countPath(bounce));
+			pPaths.mAlive[pSlot] = 0;
+		}
+	}
+	else
+	{
+		RT_STAT(threadStats().mAbsorbed++);
+		RT_STAT(threadStats().countPath(pSettings.mMaxDepth - pPaths.mDepth[pSlot] + 1));
+		pPaths.mAlive[pSlot] = 0;
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// scatters every path in pSlots whose material is a TMaterial. everything in
+// the batch runs the same scatter, called directly rather than through the
+// switch in Material. survivors then go through the same roulette as tracePath
+template<typename TMaterial>
+void shadeKernel(PathStates& pPaths, const uint32_t* pSlots, size_t pCount, const Hittable& pWorld,
+	Span<const Material> pMaterials, const RenderSettings& pSettings)
+{
+	for (size_t n = 0; n < pCount; ++n)
+	{
+		const uint32_t slot = pSlots[n];
+		const HitRecord& rec = pPaths.mRecord[slot];
+
+		Ray scattered;
+		colour attenuation;
+		const Material& material = pMaterials[rec.mMaterialId];
+		RT_STAT(threadStats().mScatters[static_cast<int>(material.mType)]++);
+		pPaths.mSampler[slot].setDimension(bounceDimension(pSettings.mMaxDepth - pPaths.mDepth[slot]));
+		const bool scatters = TMaterial::scatter(material, pPaths.mRay[slot], rec, attenuation, scattered,
+			pPaths.mSampler[slot]);
+		finishShade(pPaths, slot, scatters, attenuation, scattered, 0, pSettings);
+	}
+}
+
+// lights end their paths with what they give off, weighted the way tracePath
+// weighs it
+template<>
+void shadeKernel<DiffuseLight>(PathStates& pPaths, const uint32_t* pSlots, size_t pCount, const Hittable& pWorld,
+	Span<const Material> pMaterials, const RenderSettings& pSettings)
+{
+	const LightList* lights = sampledLights(pWorld, pSettings);
+	for (size_t n = 0; n < pCount; ++n)
+	{
+		const uint32_t slot = pSlots[n];
+		const HitRecord& rec = pPaths.mRecord[slot];
+		const Material& material = pMaterials[rec.mMaterialId];
+		pPaths.mRadiance[slot] += pPaths.mThroughput[slot]
+			* emittedAlongPath(material, rec, lights, pPaths.mScatterPdf[slot], pPaths.mScatterOrigin[slot]);
+
+		RT_STAT(threadStats().mScatters[static_cast<int>(material.mType)]++);
+		finishShade(pPaths, slot, false, colour(), Ray(), 0, pSettings);
+	}
+}
+
+// lambertian paths are most of any wave, so their kernel draws every path's
+// two numbers first, warps them all to unit vectors with warpUnitSpheres() and
+// then scatters each path along its own. the same numbers through the same
+// warp as Lambertian::scatter, a lane at a time instead of one at a time.
+// each path's shadow ray goes before its numbers are drawn, like in tracePath
+template<>
+void shadeKernel<Lambertian>(PathStates& pPaths, const uint32_t* pSlots, size_t pCount, const Hittable& pWorld,
+	Span<const Material> pMaterials, const RenderSettings& pSettings)
+{
+	const LightList* lights = sampledLights(pWorld, pSettings);
+	const size_t kBatch = 256;
+	Real u[kBatch], v[kBatch], x[kBatch], y[kBatch], z[kBatch];
+	for (size_t first = 0; first < pCount; first += kBatch)
+	{
+		const size_t count = min(kBatch, pCount - first);
+		for (size_t n = 0; n < count; ++n)
+		{
+			const uint32_t slot = pSlots[first + n];
+			const int bounce = pSettings.mMaxDepth - pPaths.mDepth[slot];
+			if (lights)
+			{
+				const HitRecord& rec = pPaths.mRecord[slot];
+				pPaths.mRadiance[slot] += pPaths.mThroughput[slot]
+					* sampleLight(rec, pMaterials[rec.mMaterialId], pWorld, *lights, pMaterials, pPaths.mSampler[slot], bounce);
+			}
+			pPaths.mSampler[slot].setDimension(bounceDimension(bounce));
+			pPaths.mSampler[slot].get2D(u[n], v[n]);
+		}
+		warpUnitSpheres(u, v, x, y, z, count);
+
+		for (size_t n = 0; n < count; ++n)
+		{
+			const uint32_t slot = pSlots[first + n];
+			const HitRecord& rec = pPaths.mRecord[slot];
+
+			Ray scattered;
+			colour attenuation;
+			const Material& material = pMaterials[rec.mMaterialId];
+			RT_STAT(threadStats().mScatters[static_cast<int>(material.mType)]++);
+			Lambertian::scatterAlong(material, rec, vec3(x[n], y[n], z[n]), attenuation, scattered);
+			const Real scatterPdf = lights ? lambertianPdf(rec.mNormal, scattered.direction()) : 0;
+			finishShade(pPaths, slot, true, attenuation, scattered, scatterPdf, pSettings);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+
+// path tracing a wave at a time instead of one recursive path at a time. a
+// pool of paths is advanced one bounce per iteration through separate stages:
+//  generate - camera rays for free slots, until every sample has been started
+//  extend   - find the closest hit of every live path, paths that miss pick up the sky
+//  sort     - bucket the hit paths by material type
+//  shade    - one kernel per material type scatters its bucket, lights add
+//             what they give off and diffuse paths send their shadow rays
+//  compact  - add finished paths into their pixel and free their slots
+// every sample uses the same seed as in render(), so the random numbers match
+// the recursive path and only the order of the multiplies differs
+Framebuffer renderWavefront(
+	const RenderSettings& pSettings,
+	const Camera& pCamera,
+	const Hittable& pWorld,
+	Span<const Material> pMaterials,
+	WavefrontStats* pStats = nullptr,
+	PathStats* pPathStats = nullptr)
+{
+	typedef chrono::steady_clock Clock;
+
+	const int width = pSettings.mImageWidth;
+	const int height = pSettings.mImageHeight;
+	const int iw = width - 1;
+	const int ih = height - 1;
+	const uint64_t totalSamples = static_cast<uint64_t>(width) * height * pSettings.mSamplesPerPixel;
+	const size_t poolSize = static_cast<size_t>(min<uint64_t>(pSettings.mWavefrontPathCount, totalSamples));
+	const size_t grain = 1024;
+
+	ThreadPool pool(pSettings.mThreads);
+	WavefrontStats stats;
+	PathStates paths;
+	paths.resize(poolSize);
+
+	vector<colour> sums(static_cast<size_t>(width) * height);
+	vector<uint32_t> active, nextActive, freeSlots, sorted;
+	active.reserve(poolSize);
+	nextActive.reserve(poolSize);
+	sorted.resize(poolSize);
+
+	freeSlots.reserve(poolSize);
+	for (size_t i = poolSize; i > 0; --i)
+		freeSlots.push_back(static_cast<uint32_t>(i - 1));
+
+	uint64_t nextSample = 0;
+	atomic<uint64_t> segments{ 0 };
+
+	auto timeStage = [&](WavefrontStats::Stage pStage, size_t pItems, const function<void()>& pWork)
+	{
+		const auto begin = Clock::now();
+		pWork();
+		stats.mSeconds[pStage] += chrono::duration<double>(Clock::now() - begin).count();
+		stats.mItems[pStage] += pItems;
+	};
+
+	while (!active.empty() || nextSample < totalSamples)
+	{
+		stats.mIterations++;
+
+		// generate
+		const size_t numNew = static_cast<size_t>(min<uint64_t>(freeSlots.size(), totalSamples - nextSample));
+		const size_t firstNew = active.size();
+		for (size_t n = 0; n < numNew; ++n)
+		{
+			active.push_back(freeSlots.back());
+			freeSlots.pop_back();
+		}
+
+		timeStage(WavefrontStats::Generate, numNew, [&]()
+		{
+			pool.parallelFor(numNew, grain, [&](size_t pBegin, size_t pEnd)
+			{
+				for (size_t n = pBegin; n < pEnd; ++n)
+				{
+					const uint64_t sample = nextSample + n;
+					const uint64_t pixelIndex = sample / pSettings.mSamplesPerPixel;
+					const int s = pSettings.mFirstSample + static_cast<int>(sample % pSettings.mSamplesPerPixel);
+					const int i = static_cast<int>(pixelIndex % width);
+					const int j = static_cast<int>(pixelIndex / width);
+
+					const uint32_t slot = active[firstNew + n];
+					Sampler& sampler = paths.mSampler[slot];
+					sampler = Sampler(pSettings.mSampler, pSettings.mSamplesPerPixel, pSettings.mSeed);
+					sampler.startSample(pixelIndex, s);
+					Real du, dv;
+					sampler.get2D(du, dv);
+					auto u = (i + du) / iw;
+					auto v = (j + dv) / ih;
+					paths.mRay[slot] = pCamera.getRay(u, v, sampler);
+					paths.mThroughput[slot] = colour(1.0, 1.0, 1.0);
+					paths.mRadiance[slot] = colour(0, 0, 0);
+					paths.mScatterPdf[slot] = 0;
+					paths.mPixel[slot] = static_cast<uint32_t>(pixelIndex);
+					paths.mDepth[slot] = pSettings.mMaxDepth;
+				}
+			});
+		});
+		nextSample += numNew;
+
+		// extend
+		timeStage(WavefrontStats::Extend, active.size(), [&]()
+		{
+			pool.parallelFor(active.size(), grain, [&](size_t pBegin, size_t pEnd)
+			{
+				uint64_t traced = 0;
+				for (size_t n = pBegin; n < pEnd; ++n)
+				{
+					const uint32_t slot = active[n];
+
+					// if we've exceeded the ray bounce limit, no more light it gathered
+					if (paths.mDepth[slot] <= 0)
+					{
+						RT_STAT(threadStats().mDepthLimited++);
+						RT_STAT(threadStats().countPath(pSettings.mMaxDepth));
+						paths.mAlive[slot] = 0;
+						continue;
+					}
+
+					++traced;
+					RT_STAT(paths.mDepth[slot] == pSettings.mMaxDepth ? threadStats().mPrimaryRays++ : threadStats().mSecondaryRays++);
+					if (pWorld.hit(paths.mRay[slot], minHitT(paths.mRay[slot]), gInfinity, paths.mRecord[slot]))
+					{
+						paths.mAlive[slot] = 1;
+					}
+					else
+					{
+						RT_STAT(threadStats().mEscaped++);
+						RT_STAT(threadStats().countPath(pSettings.mMaxDepth - paths.mDepth[slot] + 1));
+						paths.mRadiance[slot] += paths.mThroughput[slot] * skyColour(paths.mRay[slot]);
+						paths.mAlive[slot] = 0;
+					}
+				}
+				segments += traced;
+			});
+		});
+
+		// sort, a counting sort of the live paths on material type
+		size_t offsets[kNumMaterialTypes + 1] = {};
+		timeStage(WavefrontStats::Sort, active.size(), [&]()
+		{
+			for (uint32_t slot : active)
+			{
+				if (paths.mAlive[slot])
+					offsets[static_cast<int>(pMaterials[paths.mRecord[slot].mMaterialId].mType) + 1]++;
+			}
+			for (int t = 0; t < kNumMaterialTypes; ++t)
+				offsets[t + 1] += offsets[t];
+
+			size_t cursor[kNumMaterialTypes];
+			for (int t = 0; t < kNumMaterialTypes; ++t)
+				cursor[t] = offsets[t];
+			for (uint32_t slot : active)
+			{
+				if (paths.mAlive[slot])
+					sorted[cursor[static_cast<int>(pMaterials[paths.mRecord[slot].mMaterialId].mType)]++] = slot;
+			}
+		});
+
+		// shade
+		timeStage(WavefrontStats::Shade, offsets[kNumMaterialTypes], [&]()
+		{
+			for (int t = 0; t < kNumMaterialTypes; ++t)
+			{
+				const uint32_t* slots = sorted.data() + offsets[t];
+				pool.parallelFor(offsets[t + 1] - offsets[t], grain, [&](size_t pBegin, size_t pEnd)
+				{
+					switch (static_cast<MaterialType>(t))
+					{
+					case MaterialType::Lambertian: shadeKernel<Lambertian>(paths, slots + pBegin, pEnd - pBegin, pWorld, pMaterials, pSettings); break;
+					case MaterialType::Metal: shadeKernel<Metal>(paths, slots + pBegin, pEnd - pBegin, pWorld, pMaterials, pSettings); break;
+					case MaterialType::Dielectric: shadeKernel<Dielectric>(paths, slots + pBegin, pEnd - pBegin, pWorld, pMaterials, pSettings); break;
+					case MaterialType::DiffuseLight: shadeKernel<DiffuseLight>(paths, slots + pBegin, pEnd - pBegin, pWorld, pMaterials, pSettings); break;
+					}
+				});
+			}
+		});
+
+		// compact, done in order on one thread so the pixel sums don't race
+		timeStage(WavefrontStats::Compact, active.size(), [&]()
+		{
+			nextActive.clear();
+			for (uint32_t slot : active)
+			{
+				if (paths.mAlive[slot])
+				{
+					nextActive.push_back(slot);
+				}
+				else
+				{
+					sums[paths.mPixel[slot]] += paths.mRadiance[slot];
+					freeSlots.push_back(slot);
+				}
+			}
+			active.swap(nextActive);
+		});
+	}
+
+	Framebuffer pixels(width, height, pSettings.mTileSize);
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+			pixels.set(i, j, sums[static_cast<size_t>(j) * width + i], pSettings.mSamplesPerPixel);
+	}
+	pixels.setAllTileSamples(pSettings.mSamplesPerPixel);
+
+	if (pStats)
+		*pStats = stats;
+	if (pPathStats)
+		pPathStats->add(totalSamples, segments);
+
+	return pixels;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+#endif // !WAVEFRONT_RENDERER_H_
\ No newline at end of file
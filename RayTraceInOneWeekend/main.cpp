@@ -9,47 +9,100 @@
 // -----------------------------------------------------------------------------
 
 //--INCLUDES--//
+#include "Animation.h"
+#include "Bvh.h"
 #include "Camera.h"
 #include "colour.h"
+#include "CompiledScene.h"
+#include "DistributedRender.h"
 #include "HittableList.h"
 #include "Material.h"
 #include "MultiThreadFunctions.h"
+#include "RenderSettings.h"
 #include "rtweekend.h"
+#include "SceneFile.h"
 #include "Sphere.h"
 
-#include <conio.h>
 #include <iostream>
+#include <memory>
+#include <string>
 
 using namespace std;
 
 // -----------------------------------------------------------------------------
 
-int main()
+int main(int argc, char* argv[])
 {
 	// image
 	const auto aspectRatio = 16.0 / 9.0;
-	const int image_width = 400;
-	const int image_height = static_cast<int>(image_width / aspectRatio);
-	const int samplesPerPixel = 100;
-	const int maxDepth = 50;
+	RenderSettings settings;
+	settings.mImageWidth = 400;
+	settings.mSamplesPerPixel = 100;
+	settings.mMaxDepth = 50;
+	if (!parseArguments(argc, argv, settings, cerr))
+		return 1;
+	settings.mImageHeight = static_cast<int>(settings.mImageWidth / aspectRatio);
 
-	// world
-	auto world = randomScene();
+	// world, frozen into one read-only block that every thread shares. it's
+	// either the book's random scene or whatever the scene file has in it
+	MaterialTable materials;
+	unique_ptr<CompiledScene> randomWorld;
+	LoadedScene loadedScene;
+	SceneCamera sceneCamera;
+
+	if (settings.mScenePath.empty())
+	{
+		const HittableList world = randomScene(materials);
+		randomWorld.reset(new CompiledScene(world, materials));
+	}
+	else
+	{
+		string error;
+		if (!loadedScene.load(settings.mScenePath, error))
+		{
+			cerr << error << '\n';
+			return 1;
+		}
+		cerr << "loaded " << settings.mScenePath << " in " << loadedScene.mTimes.mRead << "s"
+			<< (loadedScene.isMapped() ? " (mapped)" : "") << ", bvh built in " << loadedScene.mTimes.mBuild << "s\n";
+		sceneCamera = loadedScene.mCamera;
+	}
+	const CompiledScene& scene = randomWorld ? *randomWorld : loadedScene.scene();
 
 	// camera
-	point3 lookFrom(13, 2, 3);
-	point3 lookAt(0, 0, 0);
-	vec3 vup(0, 1, 0);
-	auto distToFocus = 10.0;
-	auto aperture = 0.1;
+	Camera camera = sceneCamera.makeCamera(aspectRatio);
+
+	// or a whole sequence of frames
+	if (!settings.mAnimationPath.empty())
+	{
+		Animation animation;
+		string error;
+		if (!loadAnimation(settings.mAnimationPath, sceneCamera, animation, error))
+		{
+			cerr << error << '\n';
+			return 1;
+		}
+		return renderAnimation(settings, animation, scene, aspectRatio) ? 0 : 1;
+	}
 
-	Camera camera(lookFrom, lookAt, vup, 20, aspectRatio, aperture, distToFocus);
+	// another process might be doing the rendering
+	if (settings.mCoordinatorPort >= 0)
+		return coordinateRender(settings, sceneFingerprint(scene, sceneCamera)) ? 0 : 1;
+	if (!settings.mWorkerAddress.empty())
+		return runWorker(settings, camera, scene, scene.materials(), sceneFingerprint(scene, sceneCamera)) ? 0 : 1;
 
 	// render
 	// cout << "P3\n" << pImageWidth << ' ' << pImageHeight << "\n255\n";
 	//orginalRender(image_height, image_width, samplesPerPixel, maxDepth, camera, world);
 
-	multithreadRender(image_height, image_width, samplesPerPixel, maxDepth, camera, world);
+	// or straight into the output file when the frame is too big to hold
+	if (settings.mOutOfCore)
+	{
+		if (!renderOutOfCore(settings, camera, scene, scene.materials()))
+			return 1;
+	}
+	else if (!multithreadRender(settings, camera, scene, scene.materials(), sceneFingerprint(scene, sceneCamera)))
+		return 1;
 
 	cerr << "\nDone. \n";
 
@@ -22,7 +22,7 @@ public:
 	point3 origin() const { return mOrig; }
 	vec3 direction() const { return mDir; }
 
-	point3 at(double t) const
+	point3 at(Real t) const
 	{
 		return mOrig + (t * mDir);
 	}
@@ -34,6 +34,18 @@ public:
 	vec3 mDir;
 };
 
+// -----------------------------------------------------------------------------
+
+// the smallest t a hit along pRay counts at, see kMinRayT
+inline Real minHitT(const Ray& pRay)
+{
+	const point3& o = pRay.mOrig;
+	const Real extent = fmax(fabs(o.x()), fmax(fabs(o.y()), fabs(o.z())));
+	if (kRelativeMinRayT * extent <= kMinRayT * pRay.mDir.length())
+		return kMinRayT;
+	return kRelativeMinRayT * extent / pRay.mDir.length();
+}
+
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
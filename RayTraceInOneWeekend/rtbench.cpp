@@ -0,0 +1,348 @@
+// -----------------------------------------------------------------------------
+// rtbench - the renderer's benchmark suite without a window or an image.
+//	microbenchmarks of the hot functions, then whole frames of randomScene()
+//	over a range of thread counts. prints a table and writes the lot as json
+//	so runs from different versions can be compared. --suite runs one of the
+//	side by side comparisons in Benchmarks.h instead, those only print tables
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "Benchmarks.h"
+#include "JsonWriter.h"
+#include "RenderSettings.h"
+#include "rtweekend.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// the build can stamp the binary with the commit it came from
+#ifndef RT_GIT_REVISION
+#define RT_GIT_REVISION "unknown"
+#endif
+
+// -----------------------------------------------------------------------------
+
+// the comparisons --suite can run, each prints its own table
+struct BenchSuite
+{
+	const char* mName;
+	void (*mRun)(ostream&);
+};
+
+const BenchSuite kBenchSuites[] =
+{
+	{ "bvh", benchmarkBvh },
+	{ "sphereset", benchmarkSphereSet },
+	{ "packets", benchmarkPackets },
+	{ "wavefront", benchmarkWavefront },
+	{ "roulette", benchmarkRoulette },
+	{ "imageoutput", benchmarkImageOutput },
+	{ "framebuffer", benchmarkFramebuffer },
+	{ "adaptive", benchmarkAdaptive },
+	{ "denoise", benchmarkDenoise },
+	{ "samplers", benchmarkSamplers },
+	{ "lights", benchmarkLights },
+	{ "warps", benchmarkWarps },
+	{ "precision", benchmarkPrecision },
+	{ "raythroughput", benchmarkRayThroughput },
+	{ "compiledscene", benchmarkCompiledScene }
+};
+
+const BenchSuite* findBenchSuite(const string& pName)
+{
+	for (const BenchSuite& suite : kBenchSuites)
+	{
+		if (pName == suite.mName)
+			return &suite;
+	}
+	return nullptr;
+}
+
+void printBenchSuites(ostream& pOut)
+{
+	pOut << "suites:";
+	for (const BenchSuite& suite : kBenchSuites)
+		pOut << ' ' << suite.mName;
+	pOut << " all\n";
+}
+
+// -----------------------------------------------------------------------------
+
+struct BenchOptions
+{
+	string mJsonPath = "rtbench.json";
+	double mMicroSeconds = 0.25;
+	unsigned int mMaxThreads = 0;
+	bool mMicro = true;
+	bool mFrame = true;
+	RenderSettings mFrameSettings;
+
+	// set by --suite, which runs these in place of the micro and frame runs
+	vector<const BenchSuite*> mvSuites;
+};
+
+// -----------------------------------------------------------------------------
+
+bool parseBenchArguments(int argc, char* argv[], BenchOptions& pOptions, ostream& pErr)
+{
+	RenderSettings& frame = pOptions.mFrameSettings;
+	frame.mImageWidth = 400;
+	frame.mImageHeight = 225;
+	frame.mSamplesPerPixel = 16;
+	frame.mMaxDepth = 50;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string option = argv[i];
+
+		if (option == "--quick")
+		{
+			pOptions.mMicroSeconds = 0.05;
+			frame.mImageWidth = 160;
+			frame.mImageHeight = 90;
+			frame.mSamplesPerPixel = 4;
+			continue;
+		}
+		if (option == "--micro-only")
+		{
+			pOptions.mFrame = false;
+			continue;
+		}
+		if (option == "--frame-only")
+		{
+			pOptions.mMicro = false;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			pErr << "missing value for " << option << '\n';
+			return false;
+		}
+		const string value = argv[++i];
+
+		if (option == "--json")
+			pOptions.mJsonPath = value;
+		else if (option == "--max-threads")
+			pOptions.mMaxThreads = static_cast<unsigned int>(atoi(value.c_str()));
+		else if (option == "--micro-time")
+			pOptions.mMicroSeconds = atof(value.c_str());
+		else if (option == "--width")
+		{
+			frame.mImageWidth = atoi(value.c_str());
+			frame.mImageHeight = frame.mImageWidth * 9 / 16;
+		}
+		else if (option == "--spp")
+			frame.mSamplesPerPixel = atoi(value.c_str());
+		else if (option == "--depth")
+			frame.mMaxDepth = atoi(value.c_str());
+		else if (option == "--suite")
+		{
+			if (value == "all")
+			{
+				for (const BenchSuite& suite : kBenchSuites)
+					pOptions.mvSuites.push_back(&suite);
+			}
+			else if (const BenchSuite* suite = findBenchSuite(value))
+			{
+				pOptions.mvSuites.push_back(suite);
+			}
+			else
+			{
+				pErr << "unknown suite " << value << '\n';
+				printBenchSuites(pErr);
+				return false;
+			}
+		}
+		else
+		{
+			pErr << "unknown option " << option << "\n"
+				<< "usage: rtbench [--quick] [--micro-only | --frame-only] [--json path|-]\n"
+				<< "               [--max-threads n] [--micro-time s] [--width w] [--spp n] [--depth n]\n"
+				<< "       rtbench --suite name [--suite name...]\n";
+			printBenchSuites(pErr);
+			return false;
+		}
+	}
+
+	if (frame.mImageWidth < 16 || frame.mSamplesPerPixel < 1 || pOptions.mMicroSeconds <= 0.0)
+	{
+		pErr << "the width must be at least 16, spp at least 1 and the micro time positive\n";
+		return false;
+	}
+
+	if (pOptions.mMaxThreads == 0)
+		pOptions.mMaxThreads = thread::hardware_concurrency() != 0 ? thread::hardware_concurrency() : 4;
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+string compilerName()
+{
+#if defined(__clang__)
+	return string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	return string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + to_string(_MSC_VER);
+#else
+	return "unknown";
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+void writeBenchJson(ostream& pOut, const BenchOptions& pOptions, const vector<MicroResult>& pMicro,
+	const vector<FrameResult>& pFrames)
+{
+	char date[32] = "";
+	const time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	JsonWriter json(pOut);
+	json.beginObject();
+	json.field("revision", RT_GIT_REVISION);
+	json.field("date", date);
+	json.field("compiler", compilerName());
+	json.field("precision", kPrecisionName);
+	json.field("simd", simdName());
+	json.field("hardware_threads", thread::hardware_concurrency());
+
+	json.key("micro").beginArray();
+	for (const MicroResult& result : pMicro)
+	{
+		json.beginObject();
+		json.field("name", result.mName);
+		json.field("ns_per_op", result.mNsPerOp);
+		json.field("ops", result.mOps);
+		json.endObject();
+	}
+	json.endArray();
+
+	if (!pFrames.empty())
+	{
+		const RenderSettings& settings = pOptions.mFrameSettings;
+		const double samples = static_cast<double>(pFrames.front().mSamples);
+
+		json.key("frame").beginObject();
+		json.field("scene", "randomScene");
+		json.field("width", settings.mImageWidth);
+		json.field("height", settings.mImageHeight);
+		json.field("spp", settings.mSamplesPerPixel);
+		json.field("max_depth", settings.mMaxDepth);
+		json.key("runs").beginArray();
+		for (const FrameResult& run : pFrames)
+		{
+			json.beginObject();
+			json.field("threads", run.mThreads);
+			json.field("seconds", run.mSeconds);
+			json.field("rays", run.mRays);
+			json.field("mrays_per_sec", run.mRays / run.mSeconds * 1e-6);
+			json.field("ns_per_sample", run.mSeconds * 1e9 / samples);
+			json.field("speedup", pFrames.front().mSeconds / run.mSeconds);
+			json.endObject();
+		}
+		json.endArray();
+		json.endObject();
+	}
+
+	json.endObject();
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options;
+	if (!parseBenchArguments(argc, argv, options, cerr))
+		return 1;
+
+	cout << "rtbench " << RT_GIT_REVISION << ", " << kPrecisionName << ", " << simdName()
+		<< ", " << compilerName() << "\n\n";
+
+	if (!options.mvSuites.empty())
+	{
+		for (const BenchSuite* suite : options.mvSuites)
+		{
+			cout << "suite " << suite->mName << '\n';
+			suite->mRun(cout);
+			cout << '\n';
+		}
+		return 0;
+	}
+
+	vector<MicroResult> micro;
+	if (options.mMicro)
+	{
+		micro = runMicroBenchmarks(options.mMicroSeconds);
+
+		cout << left << setw(34) << "micro" << right << setw(12) << "ns/op" << setw(14) << "Mops/s" << '\n';
+		for (const MicroResult& result : micro)
+		{
+			cout << left << setw(34) << result.mName << right << fixed
+				<< setw(12) << setprecision(2) << result.mNsPerOp
+				<< setw(14) << setprecision(2) << 1e3 / result.mNsPerOp << '\n';
+		}
+		cout << '\n';
+	}
+
+	vector<FrameResult> frames;
+	if (options.mFrame)
+	{
+		const RenderSettings& settings = options.mFrameSettings;
+		cout << "frame randomScene " << settings.mImageWidth << 'x' << settings.mImageHeight << ", "
+			<< settings.mSamplesPerPixel << " spp, depth " << settings.mMaxDepth << '\n'
+			<< "threads   seconds     Mrays/s   ns/sample   speedup  efficiency\n";
+
+		// the first run is always on one thread, the speedups are against it
+		double oneThreadSeconds = 0.0;
+		frames = runFrameBenchmark(settings, benchmarkThreadCounts(options.mMaxThreads), [&](const FrameResult& pRun)
+		{
+			if (oneThreadSeconds == 0.0)
+				oneThreadSeconds = pRun.mSeconds;
+
+			const double speedup = oneThreadSeconds / pRun.mSeconds;
+			cout << setw(7) << pRun.mThreads << fixed
+				<< setw(10) << setprecision(3) << pRun.mSeconds
+				<< setw(12) << setprecision(2) << pRun.mRays / pRun.mSeconds * 1e-6
+				<< setw(12) << setprecision(1) << pRun.mSeconds * 1e9 / pRun.mSamples
+				<< setw(10) << setprecision(2) << speedup
+				<< setw(11) << setprecision(0) << 100.0 * speedup / pRun.mThreads << "%\n";
+		});
+		cout << '\n';
+	}
+
+	if (options.mJsonPath == "-")
+	{
+		writeBenchJson(cout, options, micro, frames);
+	}
+	else
+	{
+		ofstream file(options.mJsonPath);
+		if (!file)
+		{
+			cerr << "couldn't write " << options.mJsonPath << '\n';
+			return 1;
+		}
+		writeBenchJson(file, options, micro, frames);
+		cout << "results written to " << options.mJsonPath << '\n';
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
\ No newline at end of file
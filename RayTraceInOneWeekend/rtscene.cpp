@@ -0,0 +1,262 @@
+// -----------------------------------------------------------------------------
+// rtscene - makes, converts and times scene files.
+//	rtscene generate <spheres> <out> [--seed n]	a randomScene() style field of any size
+//	rtscene convert <in> <out>					text and binary both ways, .rtsb is binary
+//	rtscene time <file> [--rays n]				how long loading and the first rays take
+// -----------------------------------------------------------------------------
+
+//--INCLUDES--//
+#include "CompiledScene.h"
+#include "Material.h"
+#include "Rng.h"
+#include "rtweekend.h"
+#include "SceneFile.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+
+double secondsSince(Clock::time_point pStart)
+{
+	return chrono::duration<double>(Clock::now() - pStart).count();
+}
+
+// -----------------------------------------------------------------------------
+
+// randomScene() grown to pCount spheres: the ground, the three big spheres and
+// a square grid of small ones each with their own material, picked with the
+// same odds as the book
+SceneDescription generateSphereField(size_t pCount, uint64_t pSeed)
+{
+	SceneDescription scene;
+	Rng rng(pSeed);
+
+	const size_t small = pCount > 4 ? pCount - 4 : 0;
+	const int side = static_cast<int>(ceil(sqrt(static_cast<double>(small))));
+	const Real groundRadius = max(1000.0, 10.0 * side);
+
+	scene.mSpheres.reserve(pCount);
+	scene.mMaterials.mvMaterials.reserve(pCount);
+
+	const MaterialId ground = scene.mMaterials.add(Lambertian(colour(0.5, 0.5, 0.5)));
+	scene.mSpheres.push_back({ point3(0, -groundRadius, 0), groundRadius, ground });
+
+	for (size_t n = 0; n < small; ++n)
+	{
+		const int a = static_cast<int>(n % side) - side / 2;
+		const int b = static_cast<int>(n / side) - side / 2;
+		const point3 center(a + 0.9 * randomDouble(rng), 0.2, b + 0.9 * randomDouble(rng));
+
+		const double chooseMat = randomDouble(rng);
+		MaterialId material;
+		if (chooseMat < 0.8)
+			material = scene.mMaterials.add(Lambertian(colour::random(rng) * colour::random(rng)));
+		else if (chooseMat < 0.95)
+			material = scene.mMaterials.add(Metal(colour::random(rng, 0.5, 1), randomDouble(rng, 0, 0.5)));
+		else
+			material = scene.mMaterials.add(Dielectric(1.5));
+
+		scene.mSpheres.push_back({ center, 0.2, material });
+	}
+
+	if (pCount >= 4)
+	{
+		scene.mSpheres.push_back({ point3(0, 1, 0), 1.0, scene.mMaterials.add(Dielectric(1.5)) });
+		scene.mSpheres.push_back({ point3(-4, 1, 0), 1.0, scene.mMaterials.add(Lambertian(colour(0.4, 0.2, 0.1))) });
+		scene.mSpheres.push_back({ point3(4, 1, 0), 1.0, scene.mMaterials.add(Metal(colour(0.7, 0.6, 0.5), 0.0)) });
+	}
+
+	return scene;
+}
+
+// -----------------------------------------------------------------------------
+
+bool saveScene(const string& pPath, const SceneCamera& pCamera, const CompiledScene& pScene)
+{
+	string error;
+	if (hasExtension(pPath, kSceneBinaryExtension))
+	{
+		if (!saveSceneBinary(pPath, pCamera, pScene, error))
+		{
+			cerr << error << '\n';
+			return false;
+		}
+		return true;
+	}
+
+	ofstream file(pPath);
+	writeSceneText(file, pCamera, pScene.mSpheres, pScene.materials());
+	if (!file)
+	{
+		cerr << "couldn't write " << pPath << '\n';
+		return false;
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+
+int generate(size_t pCount, const string& pPath, uint64_t pSeed)
+{
+	auto start = Clock::now();
+	SceneDescription description = generateSphereField(pCount, pSeed);
+	cout << "generated " << description.mSpheres.size() << " spheres and " << description.mMaterials.size()
+		<< " materials in " << secondsSince(start) << "s\n";
+
+	const Span<const CompiledSphere> spheres(description.mSpheres.data(), description.mSpheres.size());
+
+	// only the binary file needs the tree
+	if (!hasExtension(pPath, kSceneBinaryExtension))
+	{
+		start = Clock::now();
+		ofstream file(pPath);
+		writeSceneText(file, description.mCamera, spheres, description.mMaterials);
+		if (!file)
+		{
+			cerr << "couldn't write " << pPath << '\n';
+			return 1;
+		}
+		cout << "wrote " << pPath << " in " << secondsSince(start) << "s\n";
+		return 0;
+	}
+
+	start = Clock::now();
+	CompiledScene scene(spheres, description.mMaterials);
+	cout << "compiled in " << secondsSince(start) << "s\n";
+
+	start = Clock::now();
+	if (!saveScene(pPath, description.mCamera, scene))
+		return 1;
+	cout << "wrote " << pPath << " in " << secondsSince(start) << "s\n";
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+int convert(const string& pIn, const string& pOut)
+{
+	LoadedScene loaded;
+	string error;
+	if (!loaded.load(pIn, error))
+	{
+		cerr << error << '\n';
+		return 1;
+	}
+
+	const auto start = Clock::now();
+	if (!saveScene(pOut, loaded.mCamera, loaded.scene()))
+		return 1;
+	cout << pIn << " -> " << pOut << ": read " << loaded.mTimes.mRead << "s, built " << loaded.mTimes.mBuild
+		<< "s, wrote " << secondsSince(start) << "s\n";
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// load, then trace camera rays at random pixels. with a mapped scene the first
+// rays are also paying for the pages they touch, so they're timed on their own
+int timeLoad(const string& pPath, int pRays)
+{
+	const auto start = Clock::now();
+	LoadedScene loaded;
+	string error;
+	if (!loaded.load(pPath, error))
+	{
+		cerr << error << '\n';
+		return 1;
+	}
+	const double loadSeconds = secondsSince(start);
+
+	const CompiledScene& scene = loaded.scene();
+	cout << pPath << (loaded.isMapped() ? " (binary, mapped)" : " (text)") << '\n'
+		<< "  spheres     " << scene.mSpheres.size() << '\n'
+		<< "  materials   " << scene.materials().size() << '\n'
+		<< "  arena       " << scene.sizeInBytes() / (1024.0 * 1024.0) << " MB\n"
+		<< "  read        " << loaded.mTimes.mRead << "s\n"
+		<< "  build       " << loaded.mTimes.mBuild << "s\n"
+		<< "  load total  " << loadSeconds << "s\n";
+
+	const Camera camera = loaded.mCamera.makeCamera(16.0 / 9.0);
+	Sampler sampler;
+	Rng& rng = sampler.rng();
+	rng.seed(1);
+	int hits = 0;
+	double firstSeconds = 0.0;
+	const int firstRays = min(pRays, 1000);
+	const auto traceStart = Clock::now();
+	for (int n = 0; n < pRays; ++n)
+	{
+		if (n == firstRays)
+			firstSeconds = secondsSince(traceStart);
+
+		const Ray ray = camera.getRay(randomDouble(rng), randomDouble(rng), sampler);
+		HitRecord rec;
+		if (scene.hit(ray, kMinRayT, gInfinity, rec))
+			++hits;
+	}
+	const double traceSeconds = secondsSince(traceStart);
+	if (pRays <= firstRays)
+		firstSeconds = traceSeconds;
+
+	cout << "  first " << firstRays << " rays  " << firstSeconds << "s\n"
+		<< "  " << pRays << " rays    " << traceSeconds << "s (" << hits << " hits)\n"
+		<< "  load to first " << firstRays << " rays  " << loadSeconds + firstSeconds << "s\n";
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	const string usage =
+		"usage: rtscene generate <spheres> <out> [--seed n]\n"
+		"       rtscene convert <in> <out>\n"
+		"       rtscene time <file> [--rays n]\n"
+		"files ending in .rtsb are binary, anything else is text\n";
+
+	if (argc < 3)
+	{
+		cerr << usage;
+		return 1;
+	}
+
+	const string command = argv[1];
+	uint64_t seed = 1;
+	int rays = 100000;
+	for (int i = command == "time" ? 3 : 4; i + 1 < argc; i += 2)
+	{
+		const string option = argv[i];
+		if (option == "--seed")
+			seed = strtoull(argv[i + 1], nullptr, 10);
+		else if (option == "--rays")
+			rays = atoi(argv[i + 1]);
+		else
+		{
+			cerr << "unknown option " << option << '\n' << usage;
+			return 1;
+		}
+	}
+
+	if (command == "generate" && argc >= 4)
+		return generate(static_cast<size_t>(strtoull(argv[2], nullptr, 10)), argv[3], seed);
+	if (command == "convert" && argc >= 4)
+		return convert(argv[2], argv[3]);
+	if (command == "time")
+		return timeLoad(argv[2], max(rays, 1));
+
+	cerr << usage;
+	return 1;
+}
+
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// -----------------------------------------------------------------------------
\ No newline at end of file
@@ -5,10 +5,13 @@
 
 //--INCLUDES--//
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <memory>
 
+#include "Rng.h"
+
 // -----------------------------------------------------------------------------
 
 // usings
@@ -16,20 +19,38 @@ using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
 
+// the scalar everything geometric is built on. define RT_SINGLE_PRECISION to
+// build the float renderer, simd lanes follow it (see SimdReal)
+#ifdef RT_SINGLE_PRECISION
+using Real = float;
+const char* const kPrecisionName = "float";
+#else
+using Real = double;
+const char* const kPrecisionName = "double";
+#endif
+
 // constants
-const double gInfinity = std::numeric_limits<double>::infinity();
+const Real gInfinity = std::numeric_limits<Real>::infinity();
+
+// hits closer than this along a ray are the surface the ray just left. the
+// rounding error in a hit point grows with its distance from the origin, so
+// the relative term takes over far out. for double it never does in practice,
+// for float it kicks in about two units out
+const Real kMinRayT = Real(0.001);
+const Real kRelativeMinRayT = 4096 * std::numeric_limits<Real>::epsilon();
+
+// blocks that threads read or write side by side start on their own cache
+// line (see CompiledScene and Framebuffer), so no two threads ever share one
+const size_t kCacheLineSize = 64;
+
 
+// utility functions. pi used to come from the x87 fldpi instruction, which
+// only 32 bit msvc can inline, so it's spelled out instead. same bits
+const double kPi = 3.14159265358979323846;
 
-// utility functions
-const double getPI()
+inline double getPI()
 {
-	double pi;
-	__asm
-	{
-		fldpi
-		fstp pi
-	}
-	return pi;
+	return kPi;
 }
 
 // -----------------------------------------------------------------------------
@@ -41,18 +62,40 @@ inline double deg2rad(double pDegrees)
 
 // -----------------------------------------------------------------------------
 
+inline uint64_t alignToCacheLine(uint64_t pOffset)
+{
+	return (pOffset + kCacheLineSize - 1) & ~static_cast<uint64_t>(kCacheLineSize - 1);
+}
+
+// -----------------------------------------------------------------------------
+
+inline double randomDouble(Rng& pRng)
+{
+	// returns a random real in [0,1)
+	return pRng.nextDouble();
+}
+
+// -----------------------------------------------------------------------------
+
+inline double randomDouble(Rng& pRng, double pMin, double pMax)
+{
+	// returns a random real in [min, max)
+	return pMin + (pMax - pMin) * randomDouble(pRng);
+}
+
+// -----------------------------------------------------------------------------
+
 inline double randomDouble()
 {
-	// returns a random real in [0,1]
-	return rand() / (RAND_MAX + 1.0);
+	// off the render path, draws from this thread's generator
+	return randomDouble(threadRng());
 }
 
 // -----------------------------------------------------------------------------
 
 inline double randomDouble(double pMin, double pMax)
 {
-	// returns a random real in [min, max]
-	return pMin + (pMax - pMin) * randomDouble();
+	return randomDouble(threadRng(), pMin, pMax);
 }
 
 // -----------------------------------------------------------------------------
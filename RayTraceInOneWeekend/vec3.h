@@ -4,6 +4,8 @@
 // -----------------------------------------------------------------------------
 
 //--INCLUDES--//
+#include "Warps.h"
+
 #include <cmath>
 #include <iostream>
 
@@ -16,25 +18,33 @@ class vec3
 public:
 	// ---- constructors
 	vec3() : e{ 0,0,0 } {}
-	vec3(double e0, double e1, double e2) : e{ e0, e1, e2 } {}
+	vec3(Real e0, Real e1, Real e2) : e{ e0, e1, e2 } {}
 
 	// ---- methods
-	double x() const { return e[0]; }
-	double y() const { return e[1]; }
-	double z() const { return e[2]; }
-	double length() const { return sqrt(lengthSquared()); }
-	double lengthSquared() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
+	Real x() const { return e[0]; }
+	Real y() const { return e[1]; }
+	Real z() const { return e[2]; }
+	Real length() const { return sqrt(lengthSquared()); }
+	Real lengthSquared() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
 
-	inline static vec3 random()
+	inline static vec3 random(Rng& pRng)
 	{
-		return vec3(randomDouble(), randomDouble(), randomDouble());
+		// separate statements so the draw order doesn't depend on the compiler
+		const Real x = randomDouble(pRng);
+		const Real y = randomDouble(pRng);
+		return vec3(x, y, randomDouble(pRng));
 	}
 
-	inline static vec3 random(double pMin, double pMax)
+	inline static vec3 random(Rng& pRng, Real pMin, Real pMax)
 	{
-		return vec3(randomDouble(pMin, pMax), randomDouble(pMin, pMax), randomDouble(pMin, pMax));
+		const Real x = randomDouble(pRng, pMin, pMax);
+		const Real y = randomDouble(pRng, pMin, pMax);
+		return vec3(x, y, randomDouble(pRng, pMin, pMax));
 	}
 
+	inline static vec3 random() { return random(threadRng()); }
+	inline static vec3 random(Real pMin, Real pMax) { return random(threadRng(), pMin, pMax); }
+
 	bool nearZero() const
 	{
 		// return true if the vector is close to zero in all dimensions
@@ -44,8 +54,8 @@ public:
 
 	// ---- overrides
 	vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-	double operator[](int i) const { return e[i]; }
-	double& operator[](int i) { return e[i]; }
+	Real operator[](int i) const { return e[i]; }
+	Real& operator[](int i) { return e[i]; }
 
 	vec3& operator+=(const vec3 &v)
 	{
@@ -55,7 +65,7 @@ public:
 		return *this;
 	}
 
-	vec3& operator*=(const double t)
+	vec3& operator*=(const Real t)
 	{
 		e[0] *= t;
 		e[1] *= t;
@@ -63,10 +73,10 @@ public:
 		return *this;
 	}
 
-	vec3& operator/=(const double t) { return *this *= 1 / t; }
+	vec3& operator/=(const Real t) { return *this *= 1 / t; }
 
 	// ---- members
-	double e[3];
+	Real e[3];
 };
 
 // ---- type aliases for vec3
@@ -104,28 +114,28 @@ inline vec3 operator*(const vec3& u, const vec3& v)
 
 // -----------------------------------------------------------------------------
 
-inline vec3 operator*(double t, const vec3& v)
+inline vec3 operator*(Real t, const vec3& v)
 {
 	return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
 
 // -----------------------------------------------------------------------------
 
-inline vec3 operator*(const vec3& v, double t)
+inline vec3 operator*(const vec3& v, Real t)
 {
 	return t * v;
 }
 
 // -----------------------------------------------------------------------------
 
-inline vec3 operator/(vec3 v, double t)
+inline vec3 operator/(vec3 v, Real t)
 {
 	return (1 / t) * v;
 }
 
 // -----------------------------------------------------------------------------
 
-inline double dot(const vec3& u, const vec3& v)
+inline Real dot(const vec3& u, const vec3& v)
 {
 	return u.e[0] * v.e[0]
 		 + u.e[1] * v.e[1]
@@ -150,29 +160,58 @@ inline vec3 unitVector(vec3 v)
 
 // -----------------------------------------------------------------------------
 
-vec3 randomInUnitSphere()
+// the warps in Warps.h as vec3s, for one point at a time
+inline vec3 squareToUnitDisk(Real pU, Real pV)
 {
-	while (true)
-	{
-		auto p = vec3::random(-1, 1);
-		if (p.lengthSquared() >= 1)
-			continue;
-		return p;
-	}
+	Real x, y;
+	warpUnitDisk(pU, pV, x, y);
+	return vec3(x, y, 0);
+}
+
+inline vec3 squareToUnitSphere(Real pU, Real pV)
+{
+	Real x, y, z;
+	warpUnitSphere(pU, pV, x, y, z);
+	return vec3(x, y, z);
+}
+
+inline vec3 cubeToUnitBall(Real pU, Real pV, Real pW)
+{
+	Real x, y, z;
+	warpUnitBall(pU, pV, pW, x, y, z);
+	return vec3(x, y, z);
+}
+
+// -----------------------------------------------------------------------------
+
+vec3 randomInUnitSphere(Rng& pRng)
+{
+	// separate statements so the draw order doesn't depend on the compiler
+	const Real u = randomDouble(pRng);
+	const Real v = randomDouble(pRng);
+	return cubeToUnitBall(u, v, randomDouble(pRng));
+}
+
+// -----------------------------------------------------------------------------
+
+vec3 randomUnitVector(Rng& pRng)
+{
+	const Real u = randomDouble(pRng);
+	return squareToUnitSphere(u, randomDouble(pRng));
 }
 
 // -----------------------------------------------------------------------------
 
 vec3 randomUnitVector()
 {
-	return unitVector(randomInUnitSphere());
+	return randomUnitVector(threadRng());
 }
 
 // -----------------------------------------------------------------------------
 
-vec3 randomInHemisphere(const vec3& pNormal)
+vec3 randomInHemisphere(const vec3& pNormal, Rng& pRng)
 {
-	vec3 inUnitSphere = randomInUnitSphere();
+	vec3 inUnitSphere = randomInUnitSphere(pRng);
 
 	// in the same hemisphere as the normal
 	if (dot(inUnitSphere, pNormal) > 0.0)
@@ -190,7 +229,7 @@ vec3 reflect(const vec3& pV, const vec3& pN)
 
 // -----------------------------------------------------------------------------
 
-vec3 refract(const vec3& pUV, const vec3& pN, double pEtaiOverEtat)
+vec3 refract(const vec3& pUV, const vec3& pN, Real pEtaiOverEtat)
 {
 	auto cosTheta = fmin(dot(-pUV, pN), 1.0);
 	vec3 rOutPerp = pEtaiOverEtat * (pUV + cosTheta * pN);
@@ -200,14 +239,10 @@ vec3 refract(const vec3& pUV, const vec3& pN, double pEtaiOverEtat)
 
 // -----------------------------------------------------------------------------
 
-vec3 randomInUnitDisk()
+vec3 randomInUnitDisk(Rng& pRng)
 {
-	while (true)
-	{
-		auto p = vec3(randomDouble(-1, 1), randomDouble(-1, 1), 0);
-		if (p.lengthSquared() >= 1) continue;
-		return p;
-	}
+	const Real u = randomDouble(pRng);
+	return squareToUnitDisk(u, randomDouble(pRng));
 }
 
 // -----------------------------------------------------------------------------